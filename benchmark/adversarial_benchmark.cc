@@ -0,0 +1,230 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs every tokenization entry point on inputs built to hit the slow
+// paths: unbroken words, words of the maximum length WordPiece takes,
+// runs of combining marks, control characters, malformed UTF-8, prefixes
+// of the added tokens, and a fuzz mix of them. Every input is timed at a
+// quarter of its size and at its full size. The program fails if a call
+// takes more than max_ns_per_byte, or if its ns/byte grows by more than
+// kMaxGrowth with the size, which a superlinear path would do.
+//
+// With corpus_dir, the inputs are also written there as <case>.txt, to be
+// used as a fuzz corpus.
+//
+// Usage: adversarial_benchmark <vocab_file> [bytes] [max_ns_per_byte]
+//                              [corpus_dir]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+#include "paddlenlp/utf8.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::function;
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+// ns/byte may grow this much from a quarter of the size to the full size.
+const double kMaxGrowth = 2.0;
+const size_t kMaxTokens = 512;
+
+// Appends the characters given by next until text has size bytes.
+string Fill(size_t size, function<void(string*)> next) {
+  string text;
+  while (text.size() < size) next(&text);
+  return text;
+}
+
+vector<pair<string, string>> MakeCases(size_t size) {
+  std::mt19937_64 rng(2021);
+  vector<pair<string, string>> cases;
+  cases.emplace_back("plain", Fill(size, [](string* t) {
+    *t += kSampleText;
+  }));
+  // One word: a single unknown token, after the length check.
+  cases.emplace_back("long_word", string(size, 'a'));
+  cases.emplace_back("long_word_of_pieces", Fill(size, [](string* t) {
+    *t += "unbelievable";
+  }));
+  // Words of the largest length WordPiece searches, with letters that
+  // mostly give single character pieces.
+  cases.emplace_back("max_length_words", Fill(size, [&](string* t) {
+    for (size_t i = 0; i < 100; ++i) t->push_back("qxzjkv"[rng() % 6]);
+    t->push_back(' ');
+  }));
+  // Combining marks in decreasing canonical order, which the canonical
+  // ordering of NFD has to reverse.
+  cases.emplace_back("combining_marks", Fill(size, [&](string* t) {
+    if (t->empty()) t->push_back('a');
+    AppendUtf8(t->size() < size / 2 ? 0x0301 : 0x0316, t);
+  }));
+  cases.emplace_back("combining_marks_only", Fill(size, [](string* t) {
+    AppendUtf8(0x0301, t);
+    AppendUtf8(0x0316, t);
+  }));
+  cases.emplace_back("control_chars", Fill(size, [&](string* t) {
+    const uint32_t kControls[] = {0x01, 0x7F, 0x85, 0x200B, 0xFEFF, 0x1D173};
+    AppendUtf8(kControls[rng() % 6], t);
+  }));
+  cases.emplace_back("malformed_utf8", Fill(size, [&](string* t) {
+    t->push_back(static_cast<char>(0x80 + rng() % 0x80));
+  }));
+  cases.emplace_back("punctuation", Fill(size, [&](string* t) {
+    t->push_back("!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"[rng() % 32]);
+  }));
+  cases.emplace_back("cjk", Fill(size, [&](string* t) {
+    AppendUtf8(0x4E00 + rng() % 0x5000, t);
+  }));
+  // Compatibility ideographs are normalized one by one.
+  cases.emplace_back("cjk_compatibility", Fill(size, [&](string* t) {
+    AppendUtf8(0xF900 + rng() % 0x100, t);
+  }));
+  cases.emplace_back("added_token_prefixes", Fill(size, [](string* t) {
+    *t += "[SE[SEP[CL[[CLS[MAS[UN[PAD";
+  }));
+  cases.emplace_back("whitespace", Fill(size, [](string* t) {
+    *t += " \t\n\r";
+    AppendUtf8(0x3000, t);
+  }));
+  // Slices of the other cases, cut at any byte.
+  vector<pair<string, string>> sources = cases;
+  cases.emplace_back("fuzz", Fill(size, [&](string* t) {
+    const string& source = sources[rng() % sources.size()].second;
+    // At most 256 bytes, and less than the source so that the slice has
+    // somewhere to start.
+    const size_t max_length = std::min<size_t>(256, source.size() - 1);
+    if (max_length == 0) {
+      *t += source;
+      return;
+    }
+    const size_t length = 1 + rng() % max_length;
+    *t += source.substr(rng() % (source.size() - length), length);
+  }));
+  return cases;
+}
+
+// The fastest of three runs, in ns per byte of text.
+double NsPerByte(const string& text, const function<void()>& call) {
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    const auto begin = std::chrono::steady_clock::now();
+    call();
+    const double ns = std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - begin).count();
+    if (run == 0 || ns < best) best = ns;
+  }
+  return best / text.size();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0]
+         << " <vocab_file> [bytes] [max_ns_per_byte] [corpus_dir]" << endl;
+    return -1;
+  }
+  const size_t size = argc > 2 ? std::atoll(argv[2]) : 1 << 20;
+  const double max_ns_per_byte = argc > 3 ? std::atof(argv[3]) : 2000;
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  if (size < 1024) {
+    cerr << "Use at least 1024 bytes" << endl;
+    return -1;
+  }
+
+  const vector<pair<string, string>> cases = MakeCases(size);
+  const vector<pair<string, string>> small_cases = MakeCases(size / 4);
+  if (argc > 4) {
+    for (auto& c : cases) {
+      const string path = string(argv[4]) + "/" + c.first + ".txt";
+      std::ofstream out(path, std::ios::binary);
+      out << c.second;
+      if (!out) {
+        cerr << "Can not write " << path << endl;
+        return -1;
+      }
+    }
+  }
+
+  const TokenizeLimits limits{static_cast<size_t>(-1), kMaxTokens};
+  const vector<pair<string, function<void(const string&)>>> calls = {
+    {"Tokenize", [&](const string& t) { tokenizer->Tokenize(t); }},
+    {"TokenizeToIds", [&](const string& t) { tokenizer->TokenizeToIds(t); }},
+    {"TokenizeToIds(limits)", [&](const string& t) {
+      tokenizer->TokenizeToIds(t, limits);
+    }},
+    {"TokenizeSpans", [&](const string& t) {
+      TokenSpans spans;
+      tokenizer->TokenizeSpans(t, &spans);
+    }},
+    {"CountTokens", [&](const string& t) { tokenizer->CountTokens(t); }},
+    {"Encode(max_seq_len)", [&](const string& t) {
+      tokenizer->Encode(t, t, kMaxTokens);
+    }},
+  };
+
+  printf("%-22s %-22s %10s %10s %8s\n", "input", "call", "ns/byte",
+         "1/4 size", "growth");
+  size_t failures = 0;
+  double worst = 0;
+  try {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      const string& text = cases[i].second;
+      const string& small_text = small_cases[i].second;
+      for (auto& call : calls) {
+        const double ns = NsPerByte(text, [&]() { call.second(text); });
+        const double small_ns = NsPerByte(small_text, [&]() {
+          call.second(small_text);
+        });
+        const double growth = ns / small_ns;
+        const bool ok = ns <= max_ns_per_byte && growth <= kMaxGrowth;
+        failures += ok ? 0 : 1;
+        worst = std::max(worst, ns);
+        printf("%-22s %-22s %10.1f %10.1f %7.2fx%s\n", cases[i].first.c_str(),
+               call.first.c_str(), ns, small_ns, growth, ok ? "" : "  FAIL");
+      }
+    }
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  printf("worst %.1f ns/byte, bound %.1f ns/byte, %zu failures\n", worst,
+         max_ns_per_byte, failures);
+  return failures == 0 ? 0 : 1;
+}
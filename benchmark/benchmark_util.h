@@ -0,0 +1,54 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK_BENCHMARK_UTIL_H_
+#define BENCHMARK_BENCHMARK_UTIL_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+// The inputs and helpers shared by the benchmark programs.
+
+// Mixed Chinese and English text, with punctuation, contractions and
+// accents, that the benchmarks repeat or cut into texts.
+const char* const kSampleText =
+  "泰晤士河水绿如蓝，两岸的建筑物涂染着生机勃发的色彩，"
+  "阳光也绿意葱笼，为一个季节围起了温情的栅栏。The quick brown fox jumps "
+  "over the lazy dog, and St. Paul's Cathedral is one of the most famous "
+  "Renaissance buildings in London. Unbelievably, tokenization isn't "
+  "always straightforward: naïve café owners résumé-writing. ";
+
+struct InputMix {
+  std::string name;
+  std::vector<std::string> texts;
+};
+
+// Cuts n bytes from the repeated sample text, without splitting a UTF-8
+// character.
+inline std::string MakeText(size_t offset, size_t n) {
+  const std::string sample(kSampleText);
+  std::string repeated;
+  while (repeated.size() < offset + n + 8) repeated += sample;
+  size_t begin = offset;
+  while (begin > 0 && (repeated[begin] & 0xC0) == 0x80) begin--;
+  size_t end = begin + n;
+  while (end < repeated.size() && (repeated[end] & 0xC0) == 0x80) end++;
+  return repeated.substr(begin, end - begin);
+}
+
+inline double Seconds(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - begin).count();
+}
+
+#endif  // BENCHMARK_BENCHMARK_UTIL_H_
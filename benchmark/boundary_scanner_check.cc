@@ -0,0 +1,164 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks that ClassifyBytes and ClassifyNormalizedBytes give the masks of
+// ClassifyBytesScalar and ClassifyNormalizedBytesScalar, mask for mask, on
+// random blocks, on every byte value in every lane of a block, on partial
+// blocks of every length, and on blocks of the bytes around the signed
+// compares of the vector code (0x7F, 0x80, 0xBF, 0xC0, 0xE3, 0xE4, 0xE9,
+// 0xEA). Build it with and without -DWITH_AVX2=ON to check both vector
+// paths (the check_boundary_scanner target).
+//
+// Usage: boundary_scanner_check [random_blocks]
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "paddlenlp/boundary_scanner.h"
+
+
+using std::string;
+
+
+const uint8_t kEdgeBytes[] = {0x7F, 0x80, 0xBF, 0xC0, 0xE3, 0xE4, 0xE9, 0xEA};
+
+class Checker {
+ public:
+  // Compares both classifications of data[0, n).
+  void Check(const uint8_t* data, size_t n, const char* input) {
+    const char* chars = reinterpret_cast<const char*>(data);
+    ByteClassMasks masks;
+    ByteClassMasks expected;
+    ClassifyBytes(chars, n, &masks);
+    ClassifyBytesScalar(chars, n, &expected);
+    compare("whitespace", masks.whitespace, expected.whitespace, data, n,
+            input);
+    compare("punctuation", masks.punctuation, expected.punctuation, data, n,
+            input);
+    compare("control", masks.control, expected.control, data, n, input);
+    compare("cjk_lead", masks.cjk_lead, expected.cjk_lead, data, n, input);
+    compare("non_ascii", masks.non_ascii, expected.non_ascii, data, n,
+            input);
+
+    NormalizedClassMasks normalized;
+    NormalizedClassMasks expected_normalized;
+    ClassifyNormalizedBytes(chars, n, &normalized);
+    ClassifyNormalizedBytesScalar(chars, n, &expected_normalized);
+    compare("normalized control", normalized.control,
+            expected_normalized.control, data, n, input);
+    compare("upper", normalized.upper, expected_normalized.upper, data, n,
+            input);
+    compare("normalized non_ascii", normalized.non_ascii,
+            expected_normalized.non_ascii, data, n, input);
+    compare("ideograph_lead", normalized.ideograph_lead,
+            expected_normalized.ideograph_lead, data, n, input);
+    compare("continuation", normalized.continuation,
+            expected_normalized.continuation, data, n, input);
+    num_blocks_++;
+  }
+
+  size_t NumBlocks() const { return num_blocks_; }
+  size_t NumFailures() const { return num_failures_; }
+
+ private:
+  void compare(const char* mask,
+               uint64_t got,
+               uint64_t expected,
+               const uint8_t* data,
+               size_t n,
+               const char* input) {
+    if (got == expected) return;
+    // Only the first few failures are printed.
+    if (num_failures_++ >= 10) return;
+    string hex;
+    char byte[4];
+    for (size_t i = 0; i < n; ++i) {
+      snprintf(byte, sizeof(byte), "%02X", data[i]);
+      hex += byte;
+    }
+    fprintf(stderr, "%s, %zu bytes: %s mask %016" PRIx64 ", expected %016"
+            PRIx64 "\n  %s\n", input, n, mask, got, expected, hex.c_str());
+  }
+
+  size_t num_blocks_{0};
+  size_t num_failures_{0};
+};
+
+int main(int argc, char* argv[]) {
+  const size_t num_random = argc > 1 ? std::atoi(argv[1]) : 100000;
+  Checker checker;
+  std::mt19937_64 rng(20211);
+  // The bytes past n are garbage, which a partial block must not read.
+  uint8_t block[2 * kScanBlockSize];
+
+  for (size_t b = 0; b < num_random; ++b) {
+    for (auto& byte : block) byte = static_cast<uint8_t>(rng());
+    checker.Check(block, kScanBlockSize, "random block");
+    checker.Check(block, rng() % (kScanBlockSize + 1), "random partial block");
+  }
+
+  // Every byte value in every lane, among ASCII letters and among the
+  // bytes which are in no class or in all of them.
+  const uint8_t fillers[] = {'a', ' ', 0x00, 0xE4, 0xFF};
+  for (auto filler : fillers) {
+    for (size_t lane = 0; lane < kScanBlockSize; ++lane) {
+      for (int value = 0; value < 256; ++value) {
+        memset(block, filler, sizeof(block));
+        block[lane] = static_cast<uint8_t>(value);
+        checker.Check(block, kScanBlockSize, "one byte in every lane");
+        checker.Check(block, lane + 1, "one byte at the end of a block");
+      }
+    }
+  }
+
+  // Partial blocks of every length, of every byte value.
+  for (size_t n = 0; n <= kScanBlockSize; ++n) {
+    for (int value = 0; value < 256; ++value) {
+      memset(block, value, n);
+      memset(block + n, 0xE4, sizeof(block) - n);
+      checker.Check(block, n, "partial block");
+    }
+  }
+
+  // Blocks of the edge bytes: each edge byte in every lane, then random
+  // mixes of them, whole and partial.
+  for (auto edge : kEdgeBytes) {
+    for (auto other : kEdgeBytes) {
+      for (size_t lane = 0; lane < kScanBlockSize; ++lane) {
+        memset(block, other, sizeof(block));
+        block[lane] = edge;
+        checker.Check(block, kScanBlockSize, "edge byte in every lane");
+      }
+    }
+  }
+  for (size_t b = 0; b < num_random; ++b) {
+    for (auto& byte : block) byte = kEdgeBytes[rng() % sizeof(kEdgeBytes)];
+    checker.Check(block, kScanBlockSize, "edge bytes block");
+    checker.Check(block, rng() % (kScanBlockSize + 1),
+                  "edge bytes partial block");
+  }
+
+#if defined(__AVX2__)
+  const char* path = "AVX2";
+#elif defined(__SSE2__)
+  const char* path = "SSE2";
+#else
+  const char* path = "scalar";
+#endif
+  printf("%s: %zu blocks, %zu failures\n", path, checker.NumBlocks(),
+         checker.NumFailures());
+  return checker.NumFailures() == 0 ? 0 : -1;
+}
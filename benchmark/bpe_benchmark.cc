@@ -0,0 +1,207 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks the byte-level BPETokenizer against the ids of a fixture, then
+// prints the texts per second with and without the piece cache, from one
+// thread and from several.
+//
+// The fixture directory holds a vocab.json, a merges.txt and an
+// expected.txt with one case per line: the name, add_prefix_space (0 or 1),
+// the text in hex ("-" if empty) and the ids given by the reference GPT-2
+// encoder (bpe() of openai/gpt-2 src/encoder.py, with the regex module).
+// The cases cover the contractions, \s+(?!\S), malformed UTF-8 and the
+// optional prefix space. Every case is checked with the cache disabled, with
+// a cache of 4 entries which keeps evicting, and with the default cache,
+// twice so that the second pass hits it. Decode must give back the text.
+// With seconds 0 only the checks run (the check_bpe target).
+//
+// Usage: bpe_benchmark <fixture_dir> [seconds] [threads]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/bpe_tokenizer.h"
+
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+
+struct Case {
+  string name;
+  bool add_prefix_space;
+  string text;
+  vector<size_t> ids;
+};
+
+string FromHex(const string& hex) {
+  if (hex == "-") return "";
+  string text;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    text.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr,
+                                               16)));
+  }
+  return text;
+}
+
+vector<Case> ReadCases(const string& file) {
+  std::ifstream ifs(file);
+  if (!ifs) throw std::runtime_error("Can not open " + file);
+  vector<Case> cases;
+  string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    Case c;
+    string hex;
+    fields >> c.name >> c.add_prefix_space >> hex;
+    c.text = FromHex(hex);
+    size_t id;
+    while (fields >> id) c.ids.push_back(id);
+    cases.push_back(c);
+  }
+  return cases;
+}
+
+string Join(const vector<size_t>& ids) {
+  string out;
+  for (auto& id : ids) out += (out.empty() ? "" : " ") + std::to_string(id);
+  return out;
+}
+
+// Returns the number of failed checks.
+size_t Check(const BPETokenizer& tokenizer,
+             const vector<Case>& cases,
+             bool add_prefix_space,
+             const char* config) {
+  size_t failures = 0;
+  for (auto& c : cases) {
+    if (c.add_prefix_space != add_prefix_space) continue;
+    const vector<size_t>& ids = tokenizer.TokenizeToIds(c.text);
+    if (ids != c.ids) {
+      cerr << c.name << " (add_prefix_space " << add_prefix_space << ", "
+           << config << "): got ids " << Join(ids) << ", expected "
+           << Join(c.ids) << endl;
+      failures++;
+    }
+    if (tokenizer.ConvertTokensToIds(tokenizer.Tokenize(c.text)) != ids) {
+      cerr << c.name << ": Tokenize differs from TokenizeToIds" << endl;
+      failures++;
+    }
+    const string prefixed = add_prefix_space && !c.text.empty() &&
+                            c.text[0] != ' ' ? " " + c.text : c.text;
+    if (tokenizer.Decode(ids) != prefixed) {
+      cerr << c.name << ": Decode does not give back the text" << endl;
+      failures++;
+    }
+  }
+  return failures;
+}
+
+double TextsPerSecond(const BPETokenizer& tokenizer,
+                      const vector<string>& texts,
+                      size_t num_threads,
+                      double seconds) {
+  atomic<bool> stop(false);
+  atomic<size_t> num_texts(0);
+  vector<thread> threads;
+  const auto begin = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&]() {
+      size_t local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (auto& text : texts) {
+          local += !tokenizer.TokenizeToIds(text).empty();
+        }
+      }
+      num_texts += local;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& t : threads) t.join();
+  return num_texts / Seconds(begin);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <fixture_dir> [seconds] [threads]"
+         << endl;
+    return -1;
+  }
+  const string dir = argv[1];
+  const double seconds = argc > 2 ? std::atof(argv[2]) : 1.0;
+  size_t num_threads = argc > 3 ? std::atoi(argv[3]) :
+                       std::thread::hardware_concurrency();
+  if (num_threads == 0) num_threads = 1;
+  vector<Case> cases;
+  // [add_prefix_space][cache]: disabled, 4 entries, default.
+  unique_ptr<BPETokenizer> tokenizers[2][3];
+  try {
+    cases = ReadCases(dir + "/expected.txt");
+    for (int prefix = 0; prefix < 2; ++prefix) {
+      const size_t capacities[3] = {0, 4, 10000};
+      for (int k = 0; k < 3; ++k) {
+        tokenizers[prefix][k].reset(new BPETokenizer(
+          dir + "/vocab.json", dir + "/merges.txt", true, prefix == 1, "",
+          capacities[k]));
+      }
+    }
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  size_t failures = 0;
+  const char* configs[3] = {"no cache", "cache of 4", "cache"};
+  for (int prefix = 0; prefix < 2; ++prefix) {
+    for (int k = 0; k < 3; ++k) {
+      for (int pass = 0; pass < 2; ++pass) {
+        failures += Check(*tokenizers[prefix][k], cases, prefix == 1,
+                          configs[k]);
+      }
+    }
+  }
+  printf("%zu cases, %zu failures\n", cases.size(), failures);
+  if (failures > 0) return -1;
+  if (seconds <= 0) return 0;
+
+  vector<string> texts;
+  for (size_t i = 0; i < 64; ++i) texts.push_back(MakeText(i * 37, 384));
+  printf("%-12s %16s %16s\n", "", "1 thread",
+         (std::to_string(num_threads) + " threads").c_str());
+  for (int k = 0; k < 3; ++k) {
+    const BPETokenizer& tokenizer = *tokenizers[0][k];
+    printf("%-12s %10.0f texts/s %10.0f texts/s\n", configs[k],
+           TextsPerSecond(tokenizer, texts, 1, seconds),
+           TextsPerSecond(tokenizer, texts, num_threads, seconds));
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares BertTokenizer::CountTokens with Tokenize(text).size(): the time
+// and the heap allocations per text, with and without a count limit. Also
+// checks that both give the same counts.
+//
+// Usage: count_tokens_benchmark <vocab_file> [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+// Every heap allocation of the program goes through these, except the
+// aligned ones (operator new with std::align_val_t, for over-aligned types),
+// which keep the library's operators and are not counted.
+atomic<size_t> g_num_allocations(0);
+
+void* operator new(size_t size) {
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size == 0 ? 1 : size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+// GCC sees the free() of a pointer that came from operator new once these
+// are inlined, and does not know that operator new above uses malloc().
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+
+vector<InputMix> MakeMixes() {
+  const size_t sizes[] = {48, 384, 3072, 32768};
+  const char* names[] = {"short", "medium", "long", "document"};
+  vector<InputMix> mixes(4);
+  for (size_t m = 0; m < mixes.size(); ++m) {
+    mixes[m].name = names[m];
+    for (size_t i = 0; i < 32; ++i) {
+      mixes[m].texts.push_back(MakeText(i * 37, sizes[m]));
+    }
+  }
+  return mixes;
+}
+
+struct RunResult {
+  double texts_per_sec;
+  double allocations_per_text;
+  size_t num_tokens;
+};
+
+// Loops over the texts until the time is up.
+template <typename CountFunc>
+RunResult Run(const InputMix& mix, double seconds, CountFunc count) {
+  size_t num_texts = 0;
+  size_t num_tokens = 0;
+  const size_t allocations_before = g_num_allocations.load();
+  auto begin = std::chrono::steady_clock::now();
+  auto deadline = begin + std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < deadline) {
+    for (auto& text : mix.texts) num_tokens += count(text);
+    num_texts += mix.texts.size();
+  }
+  auto end = std::chrono::steady_clock::now();
+  RunResult result;
+  result.texts_per_sec =
+    num_texts / std::chrono::duration<double>(end - begin).count();
+  result.allocations_per_text =
+    static_cast<double>(g_num_allocations.load() - allocations_before) /
+    num_texts;
+  result.num_tokens = num_tokens / (num_texts / mix.texts.size());
+  return result;
+}
+
+void PrintRow(const string& mix,
+              const string& path,
+              const RunResult& result,
+              double base_texts_per_sec) {
+  printf("%-9s %-22s %12.0f %9.2fx %14.1f %10zu\n",
+         mix.c_str(), path.c_str(), result.texts_per_sec,
+         result.texts_per_sec / base_texts_per_sec,
+         result.allocations_per_text, result.num_tokens);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [seconds]" << endl;
+    return -1;
+  }
+  double seconds = argc > 2 ? std::atof(argv[2]) : 1.0;
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  const vector<InputMix>& mixes = MakeMixes();
+  for (auto& mix : mixes) {
+    for (auto& text : mix.texts) {
+      if (tokenizer->CountTokens(text) != tokenizer->Tokenize(text).size()) {
+        cerr << "CountTokens differs from Tokenize on: " << text << endl;
+        return -1;
+      }
+    }
+  }
+
+  const size_t kMaxCount = 128;
+  printf("%-9s %-22s %12s %10s %14s %10s\n", "mix", "path", "texts/s",
+         "speedup", "allocs/text", "tokens");
+  for (auto& mix : mixes) {
+    auto&& tokenize = Run(mix, seconds, [&](const string& text) {
+      return tokenizer->Tokenize(text).size();
+    });
+    auto&& count = Run(mix, seconds, [&](const string& text) {
+      return tokenizer->CountTokens(text);
+    });
+    auto&& count_limited = Run(mix, seconds, [&](const string& text) {
+      return tokenizer->CountTokens(text, kMaxCount);
+    });
+    PrintRow(mix.name, "Tokenize().size()", tokenize, tokenize.texts_per_sec);
+    PrintRow(mix.name, "CountTokens", count, tokenize.texts_per_sec);
+    PrintRow(mix.name, "CountTokens(max=128)", count_limited,
+             tokenize.texts_per_sec);
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the tokenizer of the vocab compiled into kEmbeddedVocab with
+// the tokenizer loading the same vocab file: checks that every token has
+// the same id and that both give the same tokens and ids on the lines of
+// a corpus, then prints the construction times and the lines per second
+// of TokenizeToIds. Built when EMBEDDED_VOCAB is set; vocab_file is that
+// file.
+//
+// Usage: embedded_vocab_benchmark <vocab_file> <corpus_file>
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/embedded_vocab.h"
+#include "paddlenlp/static_vocab.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+// Evaluated by the compiler.
+constexpr size_t kUnkId = kEmbeddedVocab.Find(L"[UNK]");
+
+double LinesPerSecond(const BertTokenizer& tokenizer,
+                      const vector<string>& lines) {
+  const auto begin = std::chrono::steady_clock::now();
+  size_t num_ids = 0;
+  for (auto& line : lines) num_ids += tokenizer.TokenizeToIds(line).size();
+  return num_ids > 0 ? lines.size() / Seconds(begin) : 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <corpus_file>" << endl;
+    return -1;
+  }
+  unique_ptr<BertTokenizer> loaded;
+  unique_ptr<BertTokenizer> embedded;
+  double load_seconds = 0;
+  double bind_seconds = 0;
+  vector<string> lines;
+  try {
+    auto begin = std::chrono::steady_clock::now();
+    loaded.reset(new BertTokenizer(argv[1]));
+    load_seconds = Seconds(begin);
+    begin = std::chrono::steady_clock::now();
+    embedded.reset(new BertTokenizer(kEmbeddedVocab));
+    bind_seconds = Seconds(begin);
+
+    const shared_ptr<Vocab> vocab = LoadVocab(argv[1]);
+    if (vocab->size() != kEmbeddedVocab.size()) {
+      throw std::runtime_error("kEmbeddedVocab was not compiled from " +
+                               string(argv[1]));
+    }
+    for (auto& v : *vocab) {
+      if (kEmbeddedVocab.Find(v.first) != v.second) {
+        throw std::runtime_error("The id of a token differs.");
+      }
+    }
+    std::ifstream corpus(argv[2]);
+    if (!corpus) throw std::runtime_error("Can not open " + string(argv[2]));
+    string line;
+    while (std::getline(corpus, line)) lines.push_back(line);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  for (size_t l = 0; l < lines.size(); ++l) {
+    const vector<size_t> ids = embedded->TokenizeToIds(lines[l]);
+    if (ids != loaded->TokenizeToIds(lines[l]) ||
+        embedded->Tokenize(lines[l]) != loaded->Tokenize(lines[l]) ||
+        embedded->ConvertIdsToTokens(ids) != loaded->ConvertIdsToTokens(ids)) {
+      cerr << "The tokenizers differ on line " << l + 1 << endl;
+      return -1;
+    }
+  }
+
+  printf("%zu tokens, [UNK] id %zu, %zu lines\n", kEmbeddedVocab.size(),
+         kUnkId, lines.size());
+  printf("%-22s %12.3f ms %12.0f lines/s\n", "vocab file",
+         load_seconds * 1e3, LinesPerSecond(*loaded, lines));
+  printf("%-22s %12.3f ms %12.0f lines/s\n", "kEmbeddedVocab",
+         bind_seconds * 1e3, LinesPerSecond(*embedded, lines));
+  return 0;
+}
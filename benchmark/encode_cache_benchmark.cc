@@ -0,0 +1,150 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a skewed query stream (Zipf distributed repeats mixed with
+// one-off texts) through BertTokenizer::Encode and through an EncodeCache
+// of a few sizes, from several threads, and prints the throughput and the
+// cache stats. Also checks that the cached outputs equal the direct ones.
+//
+// Usage: encode_cache_benchmark <vocab_file> [threads] [unique_ratio]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/encode_cache.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+
+
+const size_t kNumQueries = 20000;
+const size_t kStreamLength = 400000;
+
+// A query of about 60 bytes, different for every id.
+string MakeQuery(size_t id) {
+  const string sample(kSampleText);
+  size_t begin = (id * 13) % (sample.size() - 64);
+  while ((sample[begin] & 0xC0) == 0x80) begin++;
+  size_t end = begin + 48;
+  while ((sample[end] & 0xC0) == 0x80) end++;
+  return sample.substr(begin, end - begin) + " #" + std::to_string(id);
+}
+
+// The popular queries follow a Zipf distribution with exponent 1; a
+// unique_ratio share of the stream are queries seen only once.
+vector<string> MakeStream(double unique_ratio) {
+  vector<double> weights(kNumQueries);
+  for (size_t i = 0; i < kNumQueries; ++i) weights[i] = 1.0 / (i + 1);
+  std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::mt19937_64 rng(20211);
+  vector<string> stream;
+  stream.reserve(kStreamLength);
+  for (size_t i = 0; i < kStreamLength; ++i) {
+    if (coin(rng) < unique_ratio) {
+      stream.push_back(MakeQuery(kNumQueries + i));
+    } else {
+      stream.push_back(MakeQuery(zipf(rng)));
+    }
+  }
+  return stream;
+}
+
+// Every thread replays its own interleaved part of the stream. Returns the
+// encodes per second.
+template <typename EncodeFunc>
+double Replay(const vector<string>& stream, size_t num_threads,
+              EncodeFunc encode) {
+  auto begin = std::chrono::steady_clock::now();
+  vector<thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < stream.size(); i += num_threads) {
+        encode(stream[i]);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  auto end = std::chrono::steady_clock::now();
+  return stream.size() / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [threads] [unique_ratio]"
+         << endl;
+    return -1;
+  }
+  const size_t num_threads = argc > 2 ? std::atoi(argv[2]) : 4;
+  const double unique_ratio = argc > 3 ? std::atof(argv[3]) : 0.2;
+  shared_ptr<const BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  const vector<string>& stream = MakeStream(unique_ratio);
+
+  {
+    EncodeCache cache(tokenizer);
+    for (size_t i = 0; i < 20000; ++i) {
+      if (cache.Encode(stream[i], "", 128, true) !=
+          tokenizer->Encode(stream[i], "", 128, true)) {
+        cerr << "The cached output differs on: " << stream[i] << endl;
+        return -1;
+      }
+    }
+  }
+
+  printf("%zu threads, %zu queries, %.0f%% one-off\n", num_threads,
+         stream.size(), unique_ratio * 100);
+  printf("%-16s %12s %9s %9s %11s %11s %10s\n", "path", "encodes/s",
+         "speedup", "hit ratio", "admissions", "rejections", "evictions");
+  const double base = Replay(stream, num_threads, [&](const string& text) {
+    tokenizer->Encode(text, "", 128, true);
+  });
+  printf("%-16s %12.0f %8.2fx\n", "Encode", base, 1.0);
+  for (size_t max_entries : {1000, 5000, 20000}) {
+    EncodeCache::Options options;
+    options.max_entries = max_entries;
+    EncodeCache cache(tokenizer, options);
+    const double rate = Replay(stream, num_threads, [&](const string& text) {
+      cache.Encode(text, "", 128, true);
+    });
+    const EncodeCache::Stats& stats = cache.GetStats();
+    const string path = "cache " + std::to_string(max_entries);
+    printf("%-16s %12.0f %8.2fx %9.3f %11llu %11llu %10llu\n", path.c_str(),
+           rate, rate / base, stats.HitRatio(),
+           static_cast<unsigned long long>(stats.admissions),
+           static_cast<unsigned long long>(stats.rejections),
+           static_cast<unsigned long long>(stats.evictions));
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encodes one query against many passages, as a cross-encoder reranker
+// does, with a loop over Encode and with EncodePairs on a few thread
+// counts, and prints the pairs per second. Also checks that EncodePairs
+// gives the rows of Encode.
+//
+// Usage: encode_pairs_benchmark <vocab_file> [passages] [max_seq_len]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+
+// Passages of 200 to 800 bytes, cut at character boundaries.
+vector<string> MakePassages(size_t num_passages) {
+  string sample;
+  while (sample.size() < 4096) sample += kSampleText;
+  vector<string> passages;
+  for (size_t i = 0; i < num_passages; ++i) {
+    size_t begin = (i * 131) % 2048;
+    while ((sample[begin] & 0xC0) == 0x80) begin++;
+    size_t end = begin + 200 + (i * 61) % 600;
+    while ((sample[end] & 0xC0) == 0x80) end++;
+    passages.push_back(sample.substr(begin, end - begin));
+  }
+  return passages;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [passages] [max_seq_len]"
+         << endl;
+    return -1;
+  }
+  const size_t num_passages = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const int max_seq_len = argc > 3 ? std::atoi(argv[3]) : 256;
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  const string query =
+    "which cathedral in London is one of the most famous renaissance "
+    "buildings, and why is tokenization not always straightforward?";
+  const vector<string>& passages = MakePassages(num_passages);
+  const size_t width = max_seq_len;
+
+  auto begin = std::chrono::steady_clock::now();
+  vector<unordered_map<string, vector<size_t>>> expected;
+  for (auto& passage : passages) {
+    expected.push_back(tokenizer->Encode(query, passage, max_seq_len, true));
+  }
+  const double loop_seconds = Seconds(begin);
+
+  vector<int64_t> input_ids(passages.size() * width);
+  vector<int64_t> token_type_ids(passages.size() * width);
+  EncodeBuffers<int64_t> buffers;
+  buffers.input_ids = input_ids.data();
+  buffers.token_type_ids = token_type_ids.data();
+  tokenizer->EncodePairs(query, passages, max_seq_len, buffers);
+  for (size_t i = 0; i < passages.size(); ++i) {
+    for (size_t k = 0; k < width; ++k) {
+      if (input_ids[i * width + k] !=
+            static_cast<int64_t>(expected[i]["input_ids"][k]) ||
+          token_type_ids[i * width + k] !=
+            static_cast<int64_t>(expected[i]["token_type_ids"][k])) {
+        cerr << "EncodePairs differs from Encode on passage " << i << endl;
+        return -1;
+      }
+    }
+  }
+
+  printf("1 query x %zu passages, max_seq_len %d\n", passages.size(),
+         max_seq_len);
+  printf("%-24s %12s %9s\n", "path", "pairs/s", "speedup");
+  printf("%-24s %12.0f %8.2fx\n", "Encode loop",
+         passages.size() / loop_seconds, 1.0);
+  const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t num_threads : {size_t(1), size_t(2), cores}) {
+    begin = std::chrono::steady_clock::now();
+    tokenizer->EncodePairs(query, passages, max_seq_len, buffers, nullptr,
+                           "longest_first", num_threads);
+    const double seconds = Seconds(begin);
+    const string path =
+      "EncodePairs " + std::to_string(num_threads) + " threads";
+    printf("%-24s %12.0f %8.2fx\n", path.c_str(), passages.size() / seconds,
+           loop_seconds / seconds);
+  }
+  RaggedEncoding<int32_t> ragged;
+  begin = std::chrono::steady_clock::now();
+  tokenizer->EncodePairs(query, passages, max_seq_len, &ragged);
+  const double ragged_seconds = Seconds(begin);
+  printf("%-24s %12.0f %8.2fx\n", "EncodePairs ragged",
+         passages.size() / ragged_seconds, loop_seconds / ragged_seconds);
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encodes the lines of a corpus (a tab separates a text from its pair)
+// into padded int32 rows, once with data parallelism, every thread calling
+// BertTokenizer::EncodeInto on batches it takes in turn, and once with
+// EncodePipeline, using as many threads in total. Checks that both give
+// the rows of a single EncodeInto and prints the lines per second and the
+// work and waits of every pipeline stage.
+//
+// Usage: encode_pipeline_benchmark <vocab_file> <corpus_file>
+//          [max_seq_len] [normalize,lookup,encode threads] [batch_size]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/encode_pipeline.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+// The rows of EncodeInto: input ids, token type ids and attention mask.
+struct Rows {
+  vector<int32_t> input_ids;
+  vector<int32_t> token_type_ids;
+  vector<int32_t> attention_mask;
+  vector<size_t> seq_lens;
+
+  Rows(size_t num_rows, size_t max_seq_len) :
+    input_ids(num_rows * max_seq_len),
+    token_type_ids(num_rows * max_seq_len),
+    attention_mask(num_rows * max_seq_len) {}
+
+  // The buffers starting at row i.
+  EncodeBuffers<int32_t> Buffers(size_t i, size_t max_seq_len) {
+    EncodeBuffers<int32_t> buffers;
+    buffers.input_ids = input_ids.data() + i * max_seq_len;
+    buffers.token_type_ids = token_type_ids.data() + i * max_seq_len;
+    buffers.attention_mask = attention_mask.data() + i * max_seq_len;
+    return buffers;
+  }
+
+  bool operator==(const Rows& other) const {
+    return input_ids == other.input_ids &&
+           token_type_ids == other.token_type_ids &&
+           attention_mask == other.attention_mask &&
+           seq_lens == other.seq_lens;
+  }
+};
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <corpus_file> "
+         << "[max_seq_len] [normalize,lookup,encode threads] [batch_size]"
+         << endl;
+    return -1;
+  }
+  const int max_seq_len = argc > 3 ? std::atoi(argv[3]) : 128;
+  EncodePipeline::Options options;
+  if (argc > 4 &&
+      sscanf(argv[4], "%zu,%zu,%zu", &options.num_threads[0],
+             &options.num_threads[1], &options.num_threads[2]) != 3) {
+    cerr << "Give the threads as normalize,lookup,encode" << endl;
+    return -1;
+  }
+  if (argc > 5) options.batch_size = std::atoll(argv[5]);
+  const size_t num_threads = options.num_threads[0] +
+                             options.num_threads[1] + options.num_threads[2];
+
+  shared_ptr<const BertTokenizer> tokenizer;
+  vector<string> texts;
+  vector<string> text_pairs;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+    std::ifstream corpus(argv[2]);
+    if (!corpus) throw std::runtime_error("Can not open " + string(argv[2]));
+    string line;
+    while (std::getline(corpus, line)) {
+      const size_t tab = line.find('\t');
+      texts.push_back(line.substr(0, tab));
+      text_pairs.push_back(tab != string::npos ? line.substr(tab + 1) : "");
+    }
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  const size_t n = texts.size();
+  const size_t batch_size = options.batch_size;
+  // The batches of the data parallel threads, cut beforehand.
+  vector<vector<string>> batch_texts;
+  vector<vector<string>> batch_pairs;
+  for (size_t begin = 0; begin < n; begin += batch_size) {
+    const size_t end = std::min(n, begin + batch_size);
+    batch_texts.emplace_back(texts.begin() + begin, texts.begin() + end);
+    batch_pairs.emplace_back(text_pairs.begin() + begin,
+                             text_pairs.begin() + end);
+  }
+
+  Rows expected(n, max_seq_len);
+  Rows parallel(n, max_seq_len);
+  Rows pipelined(n, max_seq_len);
+  double parallel_seconds = 0;
+  double pipelined_seconds = 0;
+  EncodePipeline pipeline(tokenizer, options);
+  try {
+    tokenizer->EncodeInto(texts, text_pairs, max_seq_len,
+                          expected.Buffers(0, max_seq_len),
+                          &expected.seq_lens);
+
+    parallel.seq_lens.resize(n);
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+      vector<size_t> seq_lens;
+      for (size_t b = next++; b < batch_texts.size(); b = next++) {
+        tokenizer->EncodeInto(batch_texts[b], batch_pairs[b], max_seq_len,
+                              parallel.Buffers(b * batch_size, max_seq_len),
+                              &seq_lens);
+        std::copy(seq_lens.begin(), seq_lens.end(),
+                  parallel.seq_lens.begin() + b * batch_size);
+      }
+    };
+    vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; ++t) threads.emplace_back(work);
+    work();
+    for (auto& t : threads) t.join();
+    parallel_seconds = Seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    pipeline.EncodeInto(texts, text_pairs, max_seq_len,
+                        pipelined.Buffers(0, max_seq_len),
+                        &pipelined.seq_lens);
+    pipelined_seconds = Seconds(begin);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  if (!(parallel == expected) || !(pipelined == expected)) {
+    cerr << "The rows differ from EncodeInto" << endl;
+    return -1;
+  }
+
+  printf("%zu lines, max_seq_len %d, batches of %zu, %zu threads "
+         "(%zu,%zu,%zu)\n", n, max_seq_len, batch_size, num_threads,
+         options.num_threads[0], options.num_threads[1],
+         options.num_threads[2]);
+  printf("%-16s %12.0f lines/s\n", "data parallel", n / parallel_seconds);
+  printf("%-16s %12.0f lines/s %.2fx\n", "pipeline", n / pipelined_seconds,
+         parallel_seconds / pipelined_seconds);
+  const EncodePipeline::Stats stats = pipeline.GetStats();
+  printf("%-10s %10s %10s %20s %20s\n", "stage", "batches", "busy s",
+         "input waits/blocks", "output waits/blocks");
+  for (size_t s = 0; s < EncodePipeline::kNumStages; ++s) {
+    const EncodePipeline::StageStats& stage = stats.stages[s];
+    printf("%-10s %10llu %10.3f %12llu/%-7llu %12llu/%-7llu\n",
+           EncodePipeline::StageName(static_cast<EncodePipeline::Stage>(s)),
+           static_cast<unsigned long long>(stage.batches), stage.busy_seconds,
+           static_cast<unsigned long long>(stage.input_waits),
+           static_cast<unsigned long long>(stage.input_blocks),
+           static_cast<unsigned long long>(stage.output_waits),
+           static_cast<unsigned long long>(stage.output_blocks));
+  }
+  return 0;
+}
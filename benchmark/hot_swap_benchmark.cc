@@ -0,0 +1,190 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encodes texts from several threads through a TokenizerHandle while another
+// thread keeps reloading the vocab, alternating between two vocab files, and
+// compares the encode latency of the calls that overlapped a swap with the
+// steady state ones. Fails if the p99 or the max latency of the calls that
+// overlapped a swap is more than max_ratio (10 by default) times the one of
+// the steady state calls, or if a reload did not parse its vocab file.
+//
+// Usage: hot_swap_benchmark <vocab_file> <new_vocab_file> [threads] [seconds]
+//                           [max_ratio]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "paddlenlp/tokenizer_handle.h"
+#include "paddlenlp/vocab_registry.h"
+
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::vector;
+
+
+const char* kText =
+  "泰晤士河水绿如蓝，两岸的建筑物涂染着生机勃发的色彩，"
+  "阳光也绿意葱笼，为一个季节围起了温情的栅栏。";
+const char* kTextPair = "梁思成问林徽因：“你上看这座教堂，有什么感觉？”";
+
+struct Latencies {
+  vector<double> steady;
+  vector<double> swapping;
+};
+
+double Percentile(vector<double>* values, double p) {
+  if (values->empty()) return 0;
+  size_t k = static_cast<size_t>(p * (values->size() - 1));
+  std::nth_element(values->begin(), values->begin() + k, values->end());
+  return (*values)[k];
+}
+
+struct Summary {
+  double p99;
+  double max;
+};
+
+Summary Print(const char* name, vector<double>* values) {
+  Summary summary;
+  summary.max = values->empty() ? 0 :
+                *std::max_element(values->begin(), values->end());
+  summary.p99 = Percentile(values, 0.99);
+  printf("%-10s %10zu %10.1f %10.1f %10.1f %10.1f\n", name, values->size(),
+         Percentile(values, 0.5), summary.p99, Percentile(values, 0.999),
+         summary.max);
+  return summary;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <new_vocab_file> "
+         << "[threads] [seconds] [max_ratio]" << endl;
+    return -1;
+  }
+  // The VocabRegistry would serve a reload of the current file without
+  // parsing it.
+  const string vocab_files[2] = {argv[1], argv[2]};
+  if (vocab_files[0] == vocab_files[1]) {
+    cerr << "The two vocab files must differ" << endl;
+    return -1;
+  }
+  size_t num_threads = std::thread::hardware_concurrency();
+  // Leave one core to the background build.
+  if (num_threads > 1) num_threads--;
+  if (argc > 3) num_threads = std::strtoul(argv[3], nullptr, 10);
+  if (num_threads == 0) num_threads = 1;
+  double seconds = argc > 4 ? std::atof(argv[4]) : 5.0;
+  double max_ratio = argc > 5 ? std::atof(argv[5]) : 10.0;
+
+  std::unique_ptr<TokenizerHandle> handle;
+  try {
+    handle.reset(new TokenizerHandle(
+      std::make_shared<const BertTokenizer>(vocab_files[0])));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  atomic<bool> stop(false);
+  // Odd while a reload is in flight.
+  atomic<uint64_t> swap_epoch(0);
+  vector<Latencies> latencies(num_threads);
+  vector<thread> readers;
+  for (size_t t = 0; t < num_threads; ++t) {
+    readers.emplace_back([&, t]() {
+      Latencies& local = latencies[t];
+      local.steady.reserve(1 << 20);
+      local.swapping.reserve(1 << 16);
+      while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t epoch_before = swap_epoch.load();
+        auto begin = std::chrono::steady_clock::now();
+        auto&& encoded = handle->Encode(kText, kTextPair);
+        auto end = std::chrono::steady_clock::now();
+        uint64_t epoch_after = swap_epoch.load();
+        if (encoded["input_ids"].empty()) break;
+        double us = std::chrono::duration<double, std::micro>(
+          end - begin).count();
+        if ((epoch_before & 1) || epoch_before != epoch_after) {
+          local.swapping.push_back(us);
+        } else {
+          local.steady.push_back(us);
+        }
+      }
+    });
+  }
+
+  const size_t loads_before = VocabRegistry::Instance().GetStats().num_loads;
+  size_t num_swaps = 0;
+  size_t num_failed_swaps = 0;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    swap_epoch++;
+    try {
+      handle->ReloadAsync(vocab_files[(num_swaps + 1) % 2]).get();
+    }
+    catch (exception& e) {
+      cerr << e.what() << endl;
+      num_failed_swaps++;
+    }
+    swap_epoch++;
+    num_swaps++;
+  }
+  stop.store(true);
+  for (auto& th : readers) th.join();
+  const size_t num_loads =
+    VocabRegistry::Instance().GetStats().num_loads - loads_before;
+
+  Latencies all;
+  for (auto& local : latencies) {
+    all.steady.insert(all.steady.end(), local.steady.begin(),
+                      local.steady.end());
+    all.swapping.insert(all.swapping.end(), local.swapping.begin(),
+                        local.swapping.end());
+  }
+  printf("threads=%zu swaps=%zu loads=%zu version=%llu\n", num_threads,
+         num_swaps, num_loads,
+         static_cast<unsigned long long>(handle->Version()));
+  printf("%-10s %10s %10s %10s %10s %10s\n",
+         "encodes", "count", "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+  const Summary steady = Print("steady", &all.steady);
+  const Summary swapping = Print("swapping", &all.swapping);
+
+  bool ok = true;
+  if (num_failed_swaps > 0 || num_loads < num_swaps) {
+    cerr << num_swaps - num_loads << " of " << num_swaps
+         << " reloads did not parse their vocab file" << endl;
+    ok = false;
+  }
+  if (swapping.p99 > max_ratio * steady.p99 ||
+      swapping.max > max_ratio * steady.max) {
+    printf("The encodes overlapping a swap are more than %.1fx slower\n",
+           max_ratio);
+    ok = false;
+  }
+  return ok ? 0 : -1;
+}
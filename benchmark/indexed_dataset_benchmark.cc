@@ -0,0 +1,288 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes the lines of a corpus, tokenized with TokenizeToIds, to an
+// indexed dataset and checks the round trip:
+//   - one dataset written by several threads at once, each line a
+//     document of one sequence;
+//   - one shard per thread, every 4 lines a document of 4 sequences, plus
+//     an int32 shard, merged into one dataset with widened ids.
+// Then times random document reads from the merged dataset.
+//
+// Usage: indexed_dataset_benchmark <vocab_file> <corpus_file> [threads]
+//                                  [prefix]
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/indexed_dataset.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+
+const size_t kSequencesPerDocument = 4;
+
+void RemoveDataset(const string& prefix) {
+  unlink((prefix + ".bin").c_str());
+  unlink((prefix + ".idx").c_str());
+}
+
+template <typename T>
+bool SameIds(const IdSpan<T>& span, const vector<size_t>& ids) {
+  if (span.size() != ids.size()) return false;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (static_cast<size_t>(span[i]) != ids[i]) return false;
+  }
+  return true;
+}
+
+// Checks that the documents of dataset hold the sequences of lines
+// [first_line, first_line + documents * sequences_per_document).
+template <typename T>
+bool CheckDocuments(const IndexedDataset& dataset, size_t first_document,
+                    size_t documents, size_t sequences_per_document,
+                    const vector<vector<size_t>>& lines, size_t first_line) {
+  for (size_t d = 0; d < documents; ++d) {
+    const size_t document = first_document + d;
+    const size_t begin = dataset.DocumentBegin(document);
+    if (dataset.DocumentEnd(document) - begin != sequences_per_document) {
+      return false;
+    }
+    vector<size_t> document_ids;
+    for (size_t s = 0; s < sequences_per_document; ++s) {
+      const vector<size_t>& ids =
+        lines[first_line + d * sequences_per_document + s];
+      if (!SameIds(dataset.Sequence<T>(begin + s), ids) ||
+          dataset.SequenceIds(begin + s) != ids) {
+        return false;
+      }
+      document_ids.insert(document_ids.end(), ids.begin(), ids.end());
+    }
+    if (!SameIds(dataset.Document<T>(document), document_ids)) return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0]
+         << " <vocab_file> <corpus_file> [threads] [prefix]" << endl;
+    return -1;
+  }
+  const size_t num_threads = argc > 3 ? std::atoi(argv[3]) : 4;
+  const string prefix = argc > 4 ? argv[4] : "indexed_dataset_benchmark";
+  unique_ptr<BertTokenizer> tokenizer;
+  vector<string> lines;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+    std::ifstream corpus(argv[2]);
+    if (!corpus) throw std::runtime_error("Can not open " + string(argv[2]));
+    string line;
+    while (std::getline(corpus, line)) lines.push_back(line);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  // Whole documents of kSequencesPerDocument lines for every thread.
+  const size_t lines_per_thread = lines.size() / num_threads /
+                                  kSequencesPerDocument *
+                                  kSequencesPerDocument;
+  if (num_threads == 0 || lines_per_thread == 0) {
+    cerr << "Need at least " << kSequencesPerDocument
+         << " lines per thread" << endl;
+    return -1;
+  }
+  lines.resize(lines_per_thread * num_threads);
+  vector<vector<size_t>> ids(lines.size());
+  size_t num_ids = 0;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    ids[i] = tokenizer->TokenizeToIds(lines[i]);
+    num_ids += ids[i].size();
+  }
+  const IdType id_type = IdTypeForVocabSize(tokenizer->GetVocabSize());
+  printf("%zu lines, %zu ids, %s ids, %zu threads\n", lines.size(), num_ids,
+         id_type == IdType::kUInt16 ? "uint16" : "int32", num_threads);
+
+  try {
+    // Threads sharing one writer: the returned indices tell where every
+    // line went.
+    vector<size_t> document_of_line(lines.size());
+    auto begin = std::chrono::steady_clock::now();
+    {
+      IndexedDatasetWriter writer(prefix, id_type);
+      vector<thread> threads;
+      for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+          for (size_t i = t; i < ids.size(); i += num_threads) {
+            document_of_line[i] = writer.AddDocument(ids[i]);
+          }
+        });
+      }
+      for (auto& th : threads) th.join();
+      writer.Close();
+    }
+    const double shared_seconds = Seconds(begin);
+    {
+      IndexedDataset dataset(prefix);
+      bool ok = dataset.NumDocuments() == lines.size() &&
+                dataset.NumSequences() == lines.size();
+      for (size_t i = 0; ok && i < lines.size(); ++i) {
+        ok = dataset.SequenceIds(document_of_line[i]) == ids[i];
+      }
+      if (!ok) {
+        cerr << "The dataset written by " << num_threads
+             << " threads differs from the corpus" << endl;
+        return -1;
+      }
+    }
+
+    // One shard per thread, and the lines of the first shard again as
+    // int32 ids.
+    vector<string> shards;
+    for (size_t t = 0; t < num_threads; ++t) {
+      shards.push_back(prefix + "_shard" + std::to_string(t));
+    }
+    const string wide_shard = prefix + "_int32";
+    begin = std::chrono::steady_clock::now();
+    vector<thread> threads;
+    vector<std::exception_ptr> errors(num_threads);
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t]() {
+        try {
+          IndexedDatasetWriter writer(shards[t], id_type);
+          const size_t first = t * lines_per_thread;
+          for (size_t i = first; i < first + lines_per_thread;
+               i += kSequencesPerDocument) {
+            writer.AddDocument(vector<vector<size_t>>(
+              ids.begin() + i, ids.begin() + i + kSequencesPerDocument));
+          }
+          writer.Close();
+        }
+        catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+    for (auto& th : threads) th.join();
+    const double shards_seconds = Seconds(begin);
+    for (auto& error : errors) {
+      if (error) std::rethrow_exception(error);
+    }
+    {
+      IndexedDatasetWriter writer(wide_shard, IdType::kInt32);
+      for (size_t i = 0; i < lines_per_thread; ++i) writer.AddDocument(ids[i]);
+    }
+
+    const string merged = prefix + "_merged";
+    begin = std::chrono::steady_clock::now();
+    MergeIndexedDatasets(shards, merged);
+    const double merge_seconds = Seconds(begin);
+    vector<string> mixed = shards;
+    mixed.push_back(wide_shard);
+    begin = std::chrono::steady_clock::now();
+    MergeIndexedDatasets(mixed, merged + "_int32");
+    const double widen_seconds = Seconds(begin);
+
+    const size_t documents_per_shard = lines_per_thread /
+                                       kSequencesPerDocument;
+    bool ok;
+    {
+      IndexedDataset dataset(merged);
+      ok = dataset.GetIdType() == id_type &&
+           dataset.NumDocuments() == documents_per_shard * num_threads &&
+           dataset.NumSequences() == lines.size();
+      ok = ok && (id_type == IdType::kUInt16 ?
+        CheckDocuments<uint16_t>(dataset, 0, dataset.NumDocuments(),
+                                 kSequencesPerDocument, ids, 0) :
+        CheckDocuments<int32_t>(dataset, 0, dataset.NumDocuments(),
+                                kSequencesPerDocument, ids, 0));
+    }
+    if (!ok) {
+      cerr << "The merged dataset differs from the corpus" << endl;
+      return -1;
+    }
+    {
+      IndexedDataset dataset(merged + "_int32");
+      const size_t shard_documents = documents_per_shard * num_threads;
+      ok = dataset.GetIdType() == IdType::kInt32 &&
+           dataset.NumDocuments() == shard_documents + lines_per_thread &&
+           CheckDocuments<int32_t>(dataset, 0, shard_documents,
+                                   kSequencesPerDocument, ids, 0) &&
+           CheckDocuments<int32_t>(dataset, shard_documents,
+                                   lines_per_thread, 1, ids, 0);
+    }
+    if (!ok) {
+      cerr << "The widened merged dataset differs from the corpus" << endl;
+      return -1;
+    }
+
+    // Random documents, as a data loader reads them.
+    const IndexedDataset dataset(merged);
+    const size_t reads = 1000000;
+    std::mt19937_64 rng(42);
+    size_t checksum = 0;
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < reads; ++i) {
+      const size_t document = rng() % dataset.NumDocuments();
+      if (id_type == IdType::kUInt16) {
+        const IdSpan<uint16_t>& span = dataset.Document<uint16_t>(document);
+        checksum += span.size() + (span.empty() ? 0 : span[0]);
+      } else {
+        const IdSpan<int32_t>& span = dataset.Document<int32_t>(document);
+        checksum += span.size() + (span.empty() ? 0 : span[0]);
+      }
+    }
+    const double read_seconds = Seconds(begin);
+
+    const double mb = num_ids * IdTypeSize(id_type) / 1e6;
+    printf("%-28s %10.2f MB/s\n", "shared writer", mb / shared_seconds);
+    printf("%-28s %10.2f MB/s\n", "one writer per thread",
+           mb / shards_seconds);
+    printf("%-28s %10.2f MB/s\n", "merge", mb / merge_seconds);
+    printf("%-28s %10.2f MB/s\n", "merge, widened to int32",
+           mb / widen_seconds);
+    printf("%-28s %10.2f ns/doc (checksum %zu)\n", "random document reads",
+           read_seconds * 1e9 / reads, checksum);
+    printf("round trip ok\n");
+
+    RemoveDataset(prefix);
+    for (auto& shard : mixed) RemoveDataset(shard);
+    RemoveDataset(merged);
+    RemoveDataset(merged + "_int32");
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encodes texts with a share of corrupted bytes (as left by broken clients
+// and truncated logs) and prints the throughput next to the clean texts,
+// the share of texts with malformed UTF-8 and the malformed sequences
+// counted by the tokenizer. None of the encodes may throw.
+//
+// Usage: malformed_utf8_benchmark <vocab_file> [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+// 256 texts of about 384 bytes in which every byte is replaced by a random
+// byte with the given probability.
+vector<string> MakeTexts(double corruption_rate) {
+  string sample;
+  while (sample.size() < 4096) sample += kSampleText;
+  std::mt19937_64 rng(20211);
+  std::uniform_real_distribution<double> coin(0, 1);
+  vector<string> texts;
+  for (size_t i = 0; i < 256; ++i) {
+    size_t begin = (i * 37) % 2048;
+    while ((sample[begin] & 0xC0) == 0x80) begin++;
+    size_t end = begin + 384;
+    while ((sample[end] & 0xC0) == 0x80) end++;
+    string text = sample.substr(begin, end - begin);
+    for (auto& c : text) {
+      if (coin(rng) < corruption_rate) c = static_cast<char>(rng() & 0xFF);
+    }
+    texts.push_back(text);
+  }
+  return texts;
+}
+
+bool IsValidUtf8(const string& text) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const unsigned char c = static_cast<unsigned char>(text[pos]);
+    size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    if (c >= 0x80 && (c < 0xC2 || c > 0xF4)) return false;
+    if (pos + len > text.size()) return false;
+    for (size_t k = 1; k < len; ++k) {
+      if ((static_cast<unsigned char>(text[pos + k]) & 0xC0) != 0x80) {
+        return false;
+      }
+    }
+    pos += len;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [seconds]" << endl;
+    return -1;
+  }
+  const double seconds = argc > 2 ? std::atof(argv[2]) : 1.0;
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  printf("%-12s %12s %10s %14s %16s\n", "corruption", "texts/s", "vs clean",
+         "malformed", "sequences/text");
+  double clean_texts_per_sec = 0;
+  for (double rate : {0.0, 0.0001, 0.001, 0.01}) {
+    const vector<string>& texts = MakeTexts(rate);
+    size_t num_malformed_texts = 0;
+    for (auto& text : texts) num_malformed_texts += !IsValidUtf8(text);
+
+    const uint64_t before =
+      tokenizer->GetDiagnostics().malformed_utf8_sequences;
+    size_t num_texts = 0;
+    auto begin = std::chrono::steady_clock::now();
+    auto deadline = begin + std::chrono::duration<double>(seconds);
+    try {
+      while (std::chrono::steady_clock::now() < deadline) {
+        for (auto& text : texts) tokenizer->Encode(text, "", 128, true);
+        num_texts += texts.size();
+      }
+    }
+    catch (exception& e) {
+      cerr << "Encode threw: " << e.what() << endl;
+      return -1;
+    }
+    auto end = std::chrono::steady_clock::now();
+    const uint64_t malformed =
+      tokenizer->GetDiagnostics().malformed_utf8_sequences - before;
+
+    const double texts_per_sec =
+      num_texts / std::chrono::duration<double>(end - begin).count();
+    if (rate == 0) clean_texts_per_sec = texts_per_sec;
+    printf("%-12g %12.0f %9.2fx %13.1f%% %16.3f\n", rate, texts_per_sec,
+           texts_per_sec / clean_texts_per_sec,
+           100.0 * num_malformed_texts / texts.size(),
+           static_cast<double>(malformed) / num_texts);
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Generates whole-word masked LM examples from a corpus on several
+// threads, once with Encode followed by a separate masking pass that finds
+// the words again from the "##" prefixes of the tokens, and once with
+// EncodeMasked. Prints the examples per second and checks that the
+// masks do not depend on the number of threads.
+//
+// Usage: masked_lm_benchmark <vocab_file> <corpus_file> [threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+
+const int kMaxSeqLen = 128;
+
+// The masking pass over the output of Encode: the words are found again
+// from the tokens, then masked like EncodeMasked does.
+void MaskAfterEncode(const BertTokenizer& tokenizer,
+                     const string& text,
+                     const MaskingOptions& options,
+                     size_t mask_id,
+                     uint64_t seed,
+                     MaskedEncoding* output) {
+  unordered_map<string, vector<size_t>> encoded =
+    tokenizer.Encode(text, "", kMaxSeqLen);
+  output->input_ids = encoded["input_ids"];
+  output->token_type_ids = encoded["token_type_ids"];
+  const vector<wstring>& tokens =
+    tokenizer.ConvertIdsToTokens(output->input_ids);
+  vector<std::pair<size_t, size_t>> words;
+  for (size_t pos = 1; pos + 1 < tokens.size(); ++pos) {
+    if (tokens[pos].compare(0, 2, L"##") == 0 && !words.empty()) {
+      words.back().second = pos + 1;
+    } else {
+      words.emplace_back(pos, pos + 1);
+    }
+  }
+  std::mt19937_64 rng(seed);
+  for (size_t k = words.size(); k > 1; --k) {
+    std::swap(words[k - 1], words[rng() % k]);
+  }
+  const size_t num_to_predict = std::min(
+    options.max_predictions,
+    std::max<size_t>(1, (tokens.size() - 2) * options.masking_rate + 0.5));
+  output->masked_positions.clear();
+  for (auto& word : words) {
+    if (output->masked_positions.size() + word.second - word.first >
+        num_to_predict) {
+      continue;
+    }
+    for (size_t pos = word.first; pos < word.second; ++pos) {
+      output->masked_positions.push_back(pos);
+    }
+  }
+  std::sort(output->masked_positions.begin(),
+            output->masked_positions.end());
+  output->labels.clear();
+  for (auto& pos : output->masked_positions) {
+    output->labels.push_back(output->input_ids[pos]);
+    const double r = (rng() >> 11) * (1.0 / 9007199254740992.0);
+    if (r < options.mask_prob) output->input_ids[pos] = mask_id;
+  }
+}
+
+// Runs generate(line, seed, &output) over the lines on num_threads
+// threads and returns the examples per second.
+template <typename GenerateFunc>
+double Run(const vector<string>& lines, size_t num_threads,
+           vector<MaskedEncoding>* outputs, GenerateFunc generate) {
+  outputs->assign(lines.size(), MaskedEncoding());
+  auto begin = std::chrono::steady_clock::now();
+  vector<thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < lines.size(); i += num_threads) {
+        generate(lines[i], i, &(*outputs)[i]);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  auto end = std::chrono::steady_clock::now();
+  return lines.size() / std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <corpus_file> [threads]"
+         << endl;
+    return -1;
+  }
+  const size_t max_threads = argc > 3 ? std::atoi(argv[3]) :
+    std::max(1u, thread::hardware_concurrency());
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  std::ifstream corpus(argv[2]);
+  vector<string> lines;
+  string line;
+  while (std::getline(corpus, line)) {
+    if (!line.empty()) lines.push_back(line);
+  }
+  if (lines.empty()) {
+    cerr << "No lines in " << argv[2] << endl;
+    return -1;
+  }
+
+  MaskingOptions options;
+  const size_t mask_id = tokenizer->ConvertTokensToIds({L"[MASK]"})[0];
+  vector<MaskedEncoding> expected;
+  vector<MaskedEncoding> outputs;
+  printf("%zu lines, max_seq_len %d\n", lines.size(), kMaxSeqLen);
+  printf("%-20s %8s %14s %9s\n", "path", "threads", "examples/s", "speedup");
+  for (size_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    const double base = Run(lines, num_threads, &outputs,
+      [&](const string& text, uint64_t seed, MaskedEncoding* output) {
+        MaskAfterEncode(*tokenizer, text, options, mask_id, seed, output);
+      });
+    printf("%-20s %8zu %14.0f %8.2fx\n", "Encode + masking", num_threads,
+           base, 1.0);
+    const double fused = Run(lines, num_threads, &outputs,
+      [&](const string& text, uint64_t seed, MaskedEncoding* output) {
+        tokenizer->EncodeMasked(text, "", kMaxSeqLen, options, seed, output);
+      });
+    printf("%-20s %8zu %14.0f %8.2fx\n", "EncodeMasked", num_threads, fused,
+           fused / base);
+    if (expected.empty()) expected = outputs;
+    for (size_t i = 0; i < lines.size(); ++i) {
+      if (outputs[i].input_ids != expected[i].input_ids ||
+          outputs[i].masked_positions != expected[i].masked_positions) {
+        cerr << "The masks of line " << i << " depend on the threads" << endl;
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
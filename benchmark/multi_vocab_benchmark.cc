@@ -0,0 +1,128 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tokenizes the lines of a corpus for an ensemble of tokenizers, once with
+// TokenizeToIds of every tokenizer and once with MultiVocabEncoder, checks
+// that both give the same ids and prints the lines per second. A vocab
+// file followed by ":cased" gets a tokenizer without do_lower_case, which
+// falls in a group of its own.
+//
+// Also prints the VocabRegistry stats: the tokenizers of the same vocab file
+// share one vocab.
+//
+// Usage: multi_vocab_benchmark <corpus_file> <vocab_file>[:cased]...
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/multi_vocab_encoder.h"
+#include "paddlenlp/tokenizer.h"
+#include "paddlenlp/vocab_registry.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0]
+         << " <corpus_file> <vocab_file>[:cased]..." << endl;
+    return -1;
+  }
+  vector<shared_ptr<const BertTokenizer>> tokenizers;
+  vector<string> lines;
+  try {
+    for (int i = 2; i < argc; ++i) {
+      string vocab_file = argv[i];
+      const string kCased = ":cased";
+      bool do_lower_case = true;
+      if (vocab_file.size() > kCased.size() &&
+          vocab_file.compare(vocab_file.size() - kCased.size(), kCased.size(),
+                             kCased) == 0) {
+        vocab_file.resize(vocab_file.size() - kCased.size());
+        do_lower_case = false;
+      }
+      tokenizers.emplace_back(new BertTokenizer(vocab_file, do_lower_case));
+    }
+    std::ifstream corpus(argv[1]);
+    if (!corpus) throw std::runtime_error("Can not open " + string(argv[1]));
+    string line;
+    while (std::getline(corpus, line)) lines.push_back(line);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  const MultiVocabEncoder encoder(tokenizers);
+  printf("%zu lines, %zu tokenizers, %zu normalization groups\n",
+         lines.size(), encoder.NumTokenizers(), encoder.NumGroups());
+  const VocabRegistry::Stats stats = VocabRegistry::Instance().GetStats();
+  printf("%zu vocabs (%zu loads, %zu hits): %zu tokens, vocab %zu KB, "
+         "inv vocab %zu KB, char ids %zu KB\n", stats.num_vocabs,
+         stats.num_loads, stats.num_hits, stats.num_tokens,
+         stats.vocab_bytes >> 10, stats.inv_vocab_bytes >> 10,
+         stats.char_ids_bytes >> 10);
+  if (stats.num_loads + stats.num_hits != tokenizers.size() ||
+      stats.num_vocabs > tokenizers.size() ||
+      (stats.num_vocabs > 0 && stats.char_ids_bytes == 0)) {
+    cerr << "Unexpected VocabRegistry stats" << endl;
+    return -1;
+  }
+
+  vector<vector<size_t>> ids;
+  for (size_t l = 0; l < lines.size(); ++l) {
+    encoder.TokenizeToIds(lines[l], &ids);
+    for (size_t i = 0; i < tokenizers.size(); ++i) {
+      if (ids[i] != tokenizers[i]->TokenizeToIds(lines[l])) {
+        cerr << "Tokenizer " << i << " differs on line " << l + 1 << endl;
+        return -1;
+      }
+    }
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  size_t separate_ids = 0;
+  for (auto& line : lines) {
+    for (auto& tokenizer : tokenizers) {
+      separate_ids += tokenizer->TokenizeToIds(line).size();
+    }
+  }
+  const double separate_seconds = Seconds(begin);
+
+  begin = std::chrono::steady_clock::now();
+  size_t shared_ids = 0;
+  vector<PreTokenizedText> words;
+  for (auto& line : lines) {
+    encoder.PreTokenize(line, &words);
+    encoder.ConvertToIds(words, &ids);
+    for (auto& tokenizer_ids : ids) shared_ids += tokenizer_ids.size();
+  }
+  const double shared_seconds = Seconds(begin);
+
+  printf("%-28s %12.0f lines/s (%zu ids)\n", "TokenizeToIds per tokenizer",
+         lines.size() / separate_seconds, separate_ids);
+  printf("%-28s %12.0f lines/s (%zu ids) %.2fx\n", "MultiVocabEncoder",
+         lines.size() / shared_seconds, shared_ids,
+         separate_seconds / shared_seconds);
+  return 0;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tokenizes the lines of a corpus, and a normalized copy of them (the words
+// of BasicTokenizer joined by spaces, as an upstream normalization would
+// give), with and without BertTokenizer::SetNormalizedFastPath. Checks that
+// both modes give the same tokens and ids, and prints the lines per second
+// and how many texts took the fast path.
+//
+// Usage: normalized_fast_path_benchmark <vocab_file> <corpus_file>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+#include "paddlenlp/utf8.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+const int kRuns = 5;
+
+double TokenizeSeconds(const BertTokenizer& tokenizer,
+                       const vector<string>& lines) {
+  const auto begin = std::chrono::steady_clock::now();
+  size_t num_ids = 0;
+  for (auto& line : lines) num_ids += tokenizer.TokenizeToIds(line).size();
+  return num_ids > 0 ? Seconds(begin) : 0;
+}
+
+// Returns false if the modes differ on a line.
+bool Run(const char* name,
+         const BertTokenizer& full,
+         const BertTokenizer& fast,
+         const vector<string>& lines) {
+  uint64_t checks = 0;
+  uint64_t fast_paths = 0;
+  for (size_t l = 0; l < lines.size(); ++l) {
+    BertTokenizer::NormalizedStats stats;
+    if (fast.TokenizeToIds(lines[l], &stats) !=
+        full.TokenizeToIds(lines[l]) ||
+        fast.Tokenize(lines[l]) != full.Tokenize(lines[l])) {
+      cerr << "The fast path differs on line " << l + 1 << " of the "
+           << name << " lines" << endl;
+      return false;
+    }
+    checks += stats.checks;
+    fast_paths += stats.fast_paths;
+  }
+  // The best of kRuns runs of each mode, in turns.
+  double full_seconds = TokenizeSeconds(full, lines);
+  double fast_seconds = TokenizeSeconds(fast, lines);
+  for (int r = 1; r < kRuns; ++r) {
+    full_seconds = std::min(full_seconds, TokenizeSeconds(full, lines));
+    fast_seconds = std::min(fast_seconds, TokenizeSeconds(fast, lines));
+  }
+  const double full_rate = lines.size() / full_seconds;
+  const double fast_rate = lines.size() / fast_seconds;
+  printf("%-12s %12.0f lines/s %12.0f lines/s %6.2fx %9.1f%%\n", name,
+         full_rate, fast_rate, fast_rate / full_rate,
+         checks > 0 ? 100.0 * fast_paths / checks : 0.0);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <corpus_file>" << endl;
+    return -1;
+  }
+  unique_ptr<BertTokenizer> full;
+  unique_ptr<BertTokenizer> fast;
+  vector<string> lines;
+  vector<string> normalized_lines;
+  try {
+    full.reset(new BertTokenizer(argv[1]));
+    fast.reset(new BertTokenizer(argv[1]));
+    fast->SetNormalizedFastPath(true);
+    std::ifstream corpus(argv[2]);
+    if (!corpus) throw std::runtime_error("Can not open " + string(argv[2]));
+    string line;
+    while (std::getline(corpus, line)) lines.push_back(line);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  BasicTokenizer basic_tokenizer;
+  for (auto& line : lines) {
+    string normalized;
+    for (auto& word : basic_tokenizer.Tokenize(line)) {
+      if (!normalized.empty()) normalized.push_back(' ');
+      for (auto& ch : word) AppendUtf8(static_cast<uint32_t>(ch), &normalized);
+    }
+    normalized_lines.push_back(normalized);
+  }
+
+  printf("%zu lines\n", lines.size());
+  printf("%-12s %20s %20s %7s %10s\n", "lines", "full path", "fast path",
+         "", "fast texts");
+  if (!Run("raw", *full, *fast, lines) ||
+      !Run("normalized", *full, *fast, normalized_lines)) {
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK_PERF_COUNTERS_H_
+#define BENCHMARK_PERF_COUNTERS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// A thin wrapper of the linux perf_event interface. The counters are opened
+// with inherit set, so they also count the threads created after Start().
+// When perf events are not available (other platforms, containers without
+// CAP_PERFMON, perf_event_paranoid too high), Has() returns false and the
+// benchmarks print "n/a".
+class PerfCounters {
+ public:
+  enum Event {
+    kCacheReferences = 0,
+    kCacheMisses,
+    kContextSwitches,
+    kCpuMigrations,
+    kNumEvents
+  };
+
+  PerfCounters() {
+    for (int i = 0; i < kNumEvents; ++i) fds_[i] = -1;
+#if defined(__linux__)
+    fds_[kCacheReferences] = open_counter(
+      PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    fds_[kCacheMisses] = open_counter(
+      PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds_[kContextSwitches] = open_counter(
+      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    fds_[kCpuMigrations] = open_counter(
+      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS);
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < kNumEvents; ++i) {
+      if (fds_[i] >= 0) close(fds_[i]);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool Has(Event event) const { return fds_[event] >= 0; }
+
+  void Start() {
+#if defined(__linux__)
+    for (int i = 0; i < kNumEvents; ++i) {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void Stop() {
+#if defined(__linux__)
+    for (int i = 0; i < kNumEvents; ++i) {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t Value(Event event) const {
+    uint64_t value = 0;
+#if defined(__linux__)
+    if (fds_[event] >= 0 &&
+        read(fds_[event], &value, sizeof(value)) != sizeof(value)) {
+      value = 0;
+    }
+#endif
+    return value;
+  }
+
+ private:
+#if defined(__linux__)
+  static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    // The software events (e.g. context switches) happen in the kernel.
+    attr.exclude_kernel = type == PERF_TYPE_HARDWARE ? 1 : 0;
+    attr.exclude_hv = 1;
+    return static_cast<int>(
+      syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+  int fds_[kNumEvents];
+};
+
+#endif  // BENCHMARK_PERF_COUNTERS_H_
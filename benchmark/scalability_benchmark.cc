@@ -0,0 +1,233 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how the throughput of Encode and Tokenize scales with the number
+// of threads, for one BertTokenizer shared by all threads and for one
+// instance per thread.
+//
+// Usage: scalability_benchmark <vocab_file> [max_threads] [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "benchmark/perf_counters.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+
+// The number of bytes of every text in the mixes.
+const size_t kShortBytes = 48;
+const size_t kMediumBytes = 384;
+const size_t kLongBytes = 3072;
+
+vector<InputMix> MakeMixes() {
+  vector<InputMix> mixes(4);
+  mixes[0].name = "short";
+  mixes[1].name = "medium";
+  mixes[2].name = "long";
+  mixes[3].name = "mixed";
+  for (size_t i = 0; i < 64; ++i) {
+    mixes[0].texts.push_back(MakeText(i * 37, kShortBytes));
+    mixes[1].texts.push_back(MakeText(i * 37, kMediumBytes));
+    mixes[2].texts.push_back(MakeText(i * 37, kLongBytes));
+    // 70% short, 25% medium and 5% long texts.
+    size_t bucket = i % 20;
+    size_t n = bucket < 14 ? kShortBytes :
+               (bucket < 19 ? kMediumBytes : kLongBytes);
+    mixes[3].texts.push_back(MakeText(i * 37, n));
+  }
+  return mixes;
+}
+
+enum class Op { kEncode, kTokenize };
+
+struct RunResult {
+  double tokens_per_sec;
+  uint64_t cache_references;
+  uint64_t cache_misses;
+  uint64_t context_switches;
+  uint64_t cpu_migrations;
+};
+
+// Every thread loops over the texts of the mix until the time is up. The
+// i-th thread uses tokenizers[i % tokenizers.size()].
+RunResult Run(const vector<unique_ptr<BertTokenizer>>& tokenizers,
+              const InputMix& mix,
+              Op op,
+              size_t num_threads,
+              double seconds,
+              PerfCounters* counters) {
+  atomic<bool> start(false);
+  atomic<bool> stop(false);
+  atomic<size_t> ready(0);
+  // Each counter lives on its own cache line to keep the benchmark itself
+  // free of false sharing.
+  struct alignas(64) Counter {
+    size_t tokens{0};
+  };
+  vector<Counter> tokens(num_threads);
+  vector<thread> threads;
+
+  counters->Start();
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      const BertTokenizer& tokenizer = *tokenizers[t % tokenizers.size()];
+      size_t local_tokens = 0;
+      size_t i = t;
+      ready++;
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      while (!stop.load(std::memory_order_relaxed)) {
+        const string& text = mix.texts[i % mix.texts.size()];
+        if (op == Op::kEncode) {
+          auto&& encoded = tokenizer.Encode(text);
+          local_tokens += encoded["input_ids"].size();
+        } else {
+          local_tokens += tokenizer.Tokenize(text).size();
+        }
+        i++;
+      }
+      tokens[t].tokens = local_tokens;
+    });
+  }
+  while (ready.load() < num_threads) std::this_thread::yield();
+
+  auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop.store(true);
+  for (auto& th : threads) th.join();
+  auto end = std::chrono::steady_clock::now();
+  counters->Stop();
+
+  size_t total_tokens = 0;
+  for (auto& counter : tokens) total_tokens += counter.tokens;
+  double elapsed = std::chrono::duration<double>(end - begin).count();
+  RunResult result;
+  result.tokens_per_sec = total_tokens / elapsed;
+  result.cache_references = counters->Value(PerfCounters::kCacheReferences);
+  result.cache_misses = counters->Value(PerfCounters::kCacheMisses);
+  result.context_switches = counters->Value(PerfCounters::kContextSwitches);
+  result.cpu_migrations = counters->Value(PerfCounters::kCpuMigrations);
+  return result;
+}
+
+void PrintHeader(const string& mix, const string& op, const string& mode) {
+  printf("\nmix=%s op=%s mode=%s\n", mix.c_str(), op.c_str(), mode.c_str());
+  printf("%8s %14s %9s %11s %12s %12s %11s\n",
+         "threads", "tokens/s", "speedup", "efficiency",
+         "cache-miss%", "ctx-switch", "migrations");
+}
+
+void PrintRow(size_t num_threads,
+              const RunResult& result,
+              double base_tokens_per_sec,
+              const PerfCounters& counters) {
+  double speedup = result.tokens_per_sec / base_tokens_per_sec;
+  char miss_rate[32] = "n/a";
+  char switches[32] = "n/a";
+  char migrations[32] = "n/a";
+  if (counters.Has(PerfCounters::kCacheMisses) &&
+      counters.Has(PerfCounters::kCacheReferences) &&
+      result.cache_references > 0) {
+    snprintf(miss_rate, sizeof(miss_rate), "%.2f",
+             100.0 * result.cache_misses / result.cache_references);
+  }
+  if (counters.Has(PerfCounters::kContextSwitches)) {
+    snprintf(switches, sizeof(switches), "%llu",
+             static_cast<unsigned long long>(result.context_switches));
+  }
+  if (counters.Has(PerfCounters::kCpuMigrations)) {
+    snprintf(migrations, sizeof(migrations), "%llu",
+             static_cast<unsigned long long>(result.cpu_migrations));
+  }
+  printf("%8zu %14.0f %9.2f %10.1f%% %12s %12s %11s\n",
+         num_threads, result.tokens_per_sec, speedup,
+         100.0 * speedup / num_threads, miss_rate, switches, migrations);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0]
+         << " <vocab_file> [max_threads] [seconds]" << endl;
+    return -1;
+  }
+  string vocab_file = argv[1];
+  size_t max_threads = std::thread::hardware_concurrency();
+  if (argc > 2) max_threads = std::strtoul(argv[2], nullptr, 10);
+  if (max_threads == 0) max_threads = 1;
+  double seconds = argc > 3 ? std::atof(argv[3]) : 1.0;
+
+  vector<size_t> thread_counts;
+  for (size_t n = 1; n < max_threads; n *= 2) thread_counts.push_back(n);
+  thread_counts.push_back(max_threads);
+
+  vector<unique_ptr<BertTokenizer>> shared;
+  vector<unique_ptr<BertTokenizer>> per_thread;
+  try {
+    shared.emplace_back(new BertTokenizer(vocab_file));
+    for (size_t t = 0; t < max_threads; ++t) {
+      per_thread.emplace_back(new BertTokenizer(vocab_file));
+    }
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  PerfCounters counters;
+  if (!counters.Has(PerfCounters::kCacheMisses)) {
+    cerr << "perf events are not available, the hardware counters are "
+            "reported as n/a." << endl;
+  }
+
+  const vector<InputMix>& mixes = MakeMixes();
+  const Op ops[] = {Op::kEncode, Op::kTokenize};
+  for (auto& mix : mixes) {
+    for (Op op : ops) {
+      const string op_name = op == Op::kEncode ? "Encode" : "Tokenize";
+      double base_shared = 0;
+      double base_per_thread = 0;
+      PrintHeader(mix.name, op_name, "shared");
+      for (size_t n : thread_counts) {
+        auto&& result = Run(shared, mix, op, n, seconds, &counters);
+        if (n == 1) base_shared = result.tokens_per_sec;
+        PrintRow(n, result, base_shared, counters);
+      }
+      PrintHeader(mix.name, op_name, "per-thread");
+      for (size_t n : thread_counts) {
+        auto&& result = Run(per_thread, mix, op, n, seconds, &counters);
+        if (n == 1) base_per_thread = result.tokens_per_sec;
+        PrintRow(n, result, base_per_thread, counters);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Types a text in small chunks and compares tokenizing the whole text
+// again after every chunk with a TokenizerSession. Also checks that both
+// give the same tokens after every chunk.
+//
+// Usage: session_benchmark <vocab_file> [text_bytes] [chunk_bytes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer_session.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+vector<string> MakeChunks(size_t text_bytes, size_t chunk_bytes) {
+  string text;
+  while (text.size() < text_bytes) text += kSampleText;
+  text.resize(text_bytes);
+  vector<string> chunks;
+  for (size_t pos = 0; pos < text.size(); pos += chunk_bytes) {
+    chunks.push_back(text.substr(pos, chunk_bytes));
+  }
+  return chunks;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [text_bytes] [chunk_bytes]"
+         << endl;
+    return -1;
+  }
+  const size_t text_bytes = argc > 2 ? std::atoi(argv[2]) : 16384;
+  const size_t chunk_bytes = argc > 3 ? std::atoi(argv[3]) : 4;
+  shared_ptr<const BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  const vector<string>& chunks = MakeChunks(text_bytes, chunk_bytes);
+
+  // The chunks can end inside a UTF-8 character; Tokenize drops an
+  // incomplete trailing character.
+  auto begin = std::chrono::steady_clock::now();
+  string text;
+  vector<vector<wstring>> expected;
+  for (auto& chunk : chunks) {
+    text += chunk;
+    expected.push_back(tokenizer->Tokenize(text));
+  }
+  const double full_seconds = Seconds(begin);
+
+  begin = std::chrono::steady_clock::now();
+  TokenizerSession session(tokenizer);
+  TokenizerSession::Delta delta;
+  size_t num_changed = 0;
+  for (auto& chunk : chunks) {
+    session.Append(chunk, &delta);
+    num_changed += delta.num_removed + delta.tokens.size();
+  }
+  const double session_seconds = Seconds(begin);
+
+  TokenizerSession check(tokenizer);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    check.Append(chunks[i]);
+    if (check.Tokens() != expected[i]) {
+      cerr << "The session differs from Tokenize after chunk " << i << endl;
+      return -1;
+    }
+  }
+
+  printf("%zu bytes in %zu chunks, %zu tokens\n", text.size(), chunks.size(),
+         session.Tokens().size());
+  printf("%-22s %12s %10s\n", "path", "us/append", "speedup");
+  printf("%-22s %12.2f %9.2fx\n", "Tokenize(whole text)",
+         full_seconds * 1e6 / chunks.size(), 1.0);
+  printf("%-22s %12.2f %9.2fx\n", "TokenizerSession",
+         session_seconds * 1e6 / chunks.size(),
+         full_seconds / session_seconds);
+  printf("tokens changed per append: %.2f\n",
+         static_cast<double>(num_changed) / chunks.size());
+  return 0;
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Shares one FullTokenizer and one BertTokenizer between threads which call
+// FullTokenizer::Tokenize, FullTokenizer::ConvertTokensToIds,
+// BertTokenizer::Tokenize, BertTokenizer::TokenizeToIds and
+// BertTokenizer::ConvertIdsToTokens, with unknown tokens and unknown ids
+// among the inputs. Every result is compared with the one of a single
+// thread; exits with -1 on a difference. Build with -DWITH_TSAN=ON to also
+// check for data races.
+//
+// Usage: thread_safety_stress <vocab_file> [num_threads] [iterations]
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark_util.h"
+#include "paddlenlp/tokenizer.h"
+
+
+using std::atomic;
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+using std::wstring;
+
+
+struct Case {
+  string text;
+  vector<wstring> tokens;
+  vector<size_t> ids;
+};
+
+struct Expected {
+  vector<wstring> full_tokens;
+  vector<size_t> full_ids;
+  vector<size_t> token_ids;
+  vector<wstring> bert_tokens;
+  vector<size_t> bert_ids;
+  vector<wstring> id_tokens;
+};
+
+vector<Case> MakeCases(size_t vocab_size) {
+  // Words which are not in a BERT vocab, or only as [UNK].
+  const char* unknown_texts[] = {
+    "𠀋𠂉𠃌 \xF0\x9F\x98\x80\xF0\x9F\x98\x83 ⅧⅨ",
+    "qzxqzxqzxqzxqzx zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz"
+    "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz",
+    "\xE2\x80\x8B\xC2\xA0\t\r\n \xEF\xBB\xBF",
+    "",
+  };
+  vector<Case> cases;
+  for (size_t i = 0; i < 24; ++i) {
+    Case c;
+    c.text = MakeText(i * 53, 16 + i * 24);
+    if (i % 3 == 0) c.text += unknown_texts[i / 3 % 4];
+    c.tokens = {L"the", L"[UNK]", L"qzxqzx", L"##ing", L"泰", L"\U0002000B",
+                L"", L"[CLS]", L"not-a-token-" + std::to_wstring(i)};
+    for (size_t j = 0; j < 16; ++j) {
+      c.ids.push_back((i * 131 + j * 977) % vocab_size);
+    }
+    c.ids.push_back(vocab_size + i);
+    c.ids.push_back(static_cast<size_t>(-1) - i);
+    cases.push_back(c);
+  }
+  return cases;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [num_threads] [iterations]"
+         << endl;
+    return -1;
+  }
+  size_t num_threads = argc > 2 ? std::atoi(argv[2]) : 8;
+  size_t iterations = argc > 3 ? std::atoi(argv[3]) : 200;
+  unique_ptr<FullTokenizer> full_tokenizer;
+  unique_ptr<BertTokenizer> bert_tokenizer;
+  try {
+    full_tokenizer.reset(new FullTokenizer(argv[1]));
+    bert_tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  const vector<Case>& cases = MakeCases(bert_tokenizer->GetVocabSize());
+  vector<Expected> expected(cases.size());
+  for (size_t i = 0; i < cases.size(); ++i) {
+    expected[i].full_tokens = full_tokenizer->Tokenize(cases[i].text);
+    expected[i].full_ids = full_tokenizer->ConvertTokensToIds(
+      expected[i].full_tokens);
+    expected[i].token_ids = full_tokenizer->ConvertTokensToIds(
+      cases[i].tokens);
+    expected[i].bert_tokens = bert_tokenizer->Tokenize(cases[i].text);
+    expected[i].bert_ids = bert_tokenizer->TokenizeToIds(cases[i].text);
+    expected[i].id_tokens = bert_tokenizer->ConvertIdsToTokens(cases[i].ids);
+  }
+
+  atomic<bool> start(false);
+  atomic<size_t> num_calls(0);
+  atomic<size_t> num_mismatches(0);
+  vector<thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      while (!start.load()) std::this_thread::yield();
+      size_t calls = 0;
+      size_t mismatches = 0;
+      for (size_t it = 0; it < iterations; ++it) {
+        // Each thread walks the cases in its own order.
+        size_t i = (it * 7 + t * 5) % cases.size();
+        const Case& c = cases[i];
+        const Expected& e = expected[i];
+        vector<wstring> tokens = full_tokenizer->Tokenize(c.text);
+        mismatches += tokens != e.full_tokens;
+        mismatches += full_tokenizer->ConvertTokensToIds(tokens) != e.full_ids;
+        mismatches +=
+          full_tokenizer->ConvertTokensToIds(c.tokens) != e.token_ids;
+        mismatches += bert_tokenizer->Tokenize(c.text) != e.bert_tokens;
+        mismatches += bert_tokenizer->TokenizeToIds(c.text) != e.bert_ids;
+        mismatches += bert_tokenizer->ConvertIdsToTokens(c.ids) != e.id_tokens;
+        calls += 6;
+      }
+      num_calls += calls;
+      num_mismatches += mismatches;
+    });
+  }
+  start = true;
+  for (auto& t : threads) t.join();
+
+  printf("%zu threads, %zu calls, %zu mismatches\n", num_threads,
+         num_calls.load(), num_mismatches.load());
+  return num_mismatches.load() == 0 ? 0 : -1;
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares ConvertTokensToIds(Tokenize(text)), which builds every token
+// and looks it up again, with TokenizeToIds, and times Encode on the
+// workload of the demo main(): the Chinese line and pair encoded 10000
+// times. Also runs an English text, where most words go through
+// WordPiece.
+//
+// Usage: tokenize_to_ids_benchmark <vocab_file> [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+const char* kLine =
+  "泰晤士河水绿如蓝，两岸的建筑物涂染着生机勃发的色彩，"
+  "阳光也绿意葱笼，为一个季节围起了温情的栅栏。"
+  "只有圣保罗大教堂不为任何季节所动，一如故我地穿一身灰色法衣，"
+  "傲岸地站在泰晤士河畔，守望着岁月，它沉郁的钟声，"
+  "只让浪漫的水手和虔诚的拜谒者感动。林徽因和梁思成将从这里开始他们的造访之旅。"
+  "林徽因是旧地重游，丝风片云都感到亲切，"
+  "而梁思成，这里的一切都是陌生的。因着这陌生，"
+  "他才对这座举世闻名的宗教建筑产生了神秘和向往。遵照父亲梁启超的安排，"
+  "他们蜜月后的旅行主要是考察古建筑圣保罗大教堂是他们最先瞩目的第一座圣殿。"
+  "当他们踏上第一个青石台阶的时候，"
+  "仿佛踏进了一阕古老的乐章。那是竖琴与占筝合奏的一支宏伟而悲怆的交响。"
+  "圣保罗大教堂是一座比较成熟的文艺复兴建筑。"
+  "它碟状形高大的弯窿，以及它的两层楹廊，看上去典雅庄重，整个布局完美和谐，"
+  "在这里，中世纪的建筑语言几乎完全消失，"
+  "全部造型生动地反映出文艺复兴建筑文化的特质。这座教堂闻名于世，"
+  "不仅仅因为它是18世纪著名建筑师克里斯托弗-仑的作品，"
+  "更因为这里埋葬着曾经打败拿破仑的威灵顿公爵和战功赫赫的海军大将纳尔逊的遗骨。"
+  "在雕刻着圣保罗旧主生平的山墙下，";
+const char* kPair = "梁思成问林徽因：“你上看这座教堂，有什么感觉？” ";
+const char* kEnglish =
+  "The quick brown fox jumps over the lazy dog, and St. Paul's Cathedral "
+  "is one of the most famous Renaissance buildings in London. "
+  "Unbelievably, tokenization isn't always straightforward: naive cafe "
+  "owners keep rewriting their resumes, internationalization notwithstanding.";
+
+template <typename Func>
+double Time(size_t iterations, Func func) {
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) func();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> [iterations]" << endl;
+    return -1;
+  }
+  const size_t iterations = argc > 2 ? std::atoi(argv[2]) : 10000;
+  unique_ptr<BertTokenizer> tokenizer;
+  try {
+    tokenizer.reset(new BertTokenizer(argv[1]));
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  printf("%-10s %-34s %10s %9s\n", "text", "path", "us/call", "speedup");
+  for (const string text : {kLine, kEnglish}) {
+    const string name = text == kLine ? "chinese" : "english";
+    if (tokenizer->TokenizeToIds(text) !=
+        tokenizer->ConvertTokensToIds(tokenizer->Tokenize(text))) {
+      cerr << "TokenizeToIds differs on the " << name << " text" << endl;
+      return -1;
+    }
+    const double tokens_seconds = Time(iterations, [&]() {
+      tokenizer->ConvertTokensToIds(tokenizer->Tokenize(text));
+    });
+    const double ids_seconds = Time(iterations, [&]() {
+      tokenizer->TokenizeToIds(text);
+    });
+    printf("%-10s %-34s %10.2f %8.2fx\n", name.c_str(),
+           "ConvertTokensToIds(Tokenize)", tokens_seconds * 1e6 / iterations,
+           1.0);
+    printf("%-10s %-34s %10.2f %8.2fx\n", name.c_str(), "TokenizeToIds",
+           ids_seconds * 1e6 / iterations, tokens_seconds / ids_seconds);
+  }
+  // The loop of main().
+  const double encode_seconds = Time(iterations, [&]() {
+    tokenizer->Encode(kLine, kPair);
+  });
+  printf("%-10s %-34s %10.2f\n", "main()", "Encode(line, pair)",
+         encode_seconds * 1e6 / iterations);
+  return 0;
+}
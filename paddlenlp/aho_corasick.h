@@ -0,0 +1,69 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_AHO_CORASICK_H_
+#define PADDLENLP_AHO_CORASICK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::size_t;
+
+
+// Aho-Corasick automaton over UTF-8 bytes. It locates every occurrence of a
+// set of patterns (e.g. added tokens like "[SEP]") in one linear scan of
+// the raw input text.
+class AhoCorasick {
+ public:
+  struct Match {
+    size_t begin;       // byte offset of the first matched byte
+    size_t end;         // byte offset one past the last matched byte
+    size_t pattern_id;  // index into the patterns passed to Build()
+  };
+
+  AhoCorasick();
+  // Rebuilds the automaton. Empty patterns are ignored.
+  void Build(const vector<string>& patterns);
+  // Finds the leftmost-longest, non-overlapping matches in text, ordered by
+  // position. The output is cleared first.
+  void FindAll(const string& text, vector<Match>* matches) const;
+  // Same on text[0, size).
+  void FindAll(const char* text, size_t size, vector<Match>* matches) const;
+  bool Empty() const { return num_patterns_ == 0; }
+  size_t MaxPatternSize() const { return max_pattern_size_; }
+
+ private:
+  int next_state(int state, uint8_t byte) const;
+
+  // The trie is stored in CSR form: the edges leaving node i are
+  // edge_labels_/edge_targets_[edge_begin_[i], edge_begin_[i + 1]), sorted
+  // by label. The root also has a dense transition table.
+  vector<int> edge_begin_;
+  vector<uint8_t> edge_labels_;
+  vector<int> edge_targets_;
+  vector<int> root_next_;
+  vector<int> fail_;
+  // dict_link_: the nearest node on the fail chain that ends a pattern.
+  vector<int> dict_link_;
+  // pattern_: the pattern ending exactly at the node, -1 if none.
+  vector<int> pattern_;
+  vector<size_t> depth_;
+  size_t num_patterns_{0};
+  size_t max_pattern_size_{0};
+  // A power of two above max_pattern_size_: FindAll keeps the longest
+  // match of every start it has not resolved yet in a ring of this size.
+  size_t ring_size_{1};
+};
+
+#endif  // PADDLENLP_AHO_CORASICK_H_
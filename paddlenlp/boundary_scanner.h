@@ -0,0 +1,89 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_BOUNDARY_SCANNER_H_
+#define PADDLENLP_BOUNDARY_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+using std::size_t;
+
+
+const size_t kScanBlockSize = 64;
+
+// The classes of the bytes of a block of UTF-8 text, one bit per byte: bit i
+// of a mask describes the i-th byte of the block.
+struct ByteClassMasks {
+  // ' ', '\t', '\n' and '\r', the ASCII characters IsWhiteSpace accepts.
+  uint64_t whitespace;
+  // The ASCII characters IsPunctuation accepts.
+  uint64_t punctuation;
+  // The other ASCII control characters, which the cleaning step drops.
+  uint64_t control;
+  // 0xE3..0xE9, the lead bytes of U+3000..U+9FFF, where most CJK
+  // characters live.
+  uint64_t cjk_lead;
+  // All the bytes >= 0x80.
+  uint64_t non_ascii;
+};
+
+// Classifies data[0, n), n <= kScanBlockSize. The bits past n are 0. Uses
+// AVX2 or SSE2 when the build enables them, and ClassifyBytesScalar
+// otherwise; both give the same masks.
+void ClassifyBytes(const char* data, size_t n, ByteClassMasks* masks);
+void ClassifyBytesScalar(const char* data, size_t n, ByteClassMasks* masks);
+
+// The bytes of a block the check for normalized text looks at, one bit per
+// byte like ByteClassMasks.
+struct NormalizedClassMasks {
+  // The ASCII control characters but '\t', '\n' and '\r'.
+  uint64_t control;
+  // 'A'..'Z'.
+  uint64_t upper;
+  // All the bytes >= 0x80.
+  uint64_t non_ascii;
+  // 0xE4..0xE9, the lead bytes of U+4000..U+9FFF.
+  uint64_t ideograph_lead;
+  // 0x80..0xBF.
+  uint64_t continuation;
+};
+
+// Same as ClassifyBytes for these classes.
+void ClassifyNormalizedBytes(const char* data,
+                             size_t n,
+                             NormalizedClassMasks* masks);
+void ClassifyNormalizedBytesScalar(const char* data,
+                                   size_t n,
+                                   NormalizedClassMasks* masks);
+
+// The bytes the pre-tokenizer has to look at one by one. The bytes in
+// between are ASCII letters, digits and symbols which just extend the
+// current word.
+inline uint64_t BoundaryMask(const ByteClassMasks& masks) {
+  return masks.whitespace | masks.punctuation | masks.control |
+         masks.non_ascii;
+}
+
+inline size_t CountTrailingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(x));
+#else
+  size_t n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+#endif  // PADDLENLP_BOUNDARY_SCANNER_H_
@@ -0,0 +1,111 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_BPE_TOKENIZER_H_
+#define PADDLENLP_BPE_TOKENIZER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::pair;
+using std::size_t;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+
+// Byte pair encoding of GPT-2 and RoBERTa style models, from a vocab.json
+// (token to id) and a merges.txt (one "left right" merge per line, by
+// priority). Every piece of the pre-tokenization is merged on its own.
+//
+// In byte-level mode the text is split with the GPT-2 pattern
+//   's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+// and the pieces are merged over their UTF-8 bytes, mapped to printable
+// characters as GPT-2 does. Otherwise the pieces are the words of
+// BasicTokenizer (without lower casing), merged over their characters;
+// the characters missing from the vocab become unk_token, or are dropped
+// without one.
+//
+// Like BertTokenizer, a BPETokenizer can be shared by any number of
+// threads. The merge results of the pieces are cached in shards, each with
+// its own mutex and share of cache_capacity entries. A full shard evicts
+// with the CLOCK policy: the hand skips, and clears the mark of, the
+// entries hit since it last passed them. A cache_capacity of 0 disables
+// the cache.
+class BPETokenizer {
+ public:
+  explicit BPETokenizer(
+    const string& vocab_file,
+    const string& merges_file,
+    bool byte_level = true,
+    bool add_prefix_space = false,
+    const string& unk_token = "",
+    size_t cache_capacity = 10000);
+  ~BPETokenizer();
+
+  vector<string> Tokenize(const string& text) const;
+  vector<size_t> TokenizeToIds(const string& text) const;
+  vector<size_t> ConvertTokensToIds(const vector<string>& tokens) const;
+  vector<string> ConvertIdsToTokens(const vector<size_t>& token_ids) const;
+  // Concatenates the tokens, mapping the byte-level characters back to
+  // the bytes they stand for.
+  string Decode(const vector<size_t>& token_ids) const;
+  size_t VocabSize() const { return vocab_.size(); }
+
+  // Splits text with the GPT-2 pattern of the byte-level mode. A malformed
+  // UTF-8 sequence is matched as one U+FFFD but keeps its bytes, so the
+  // byte-level mode encodes any input losslessly.
+  static vector<string> PreTokenize(const string& text);
+
+ private:
+  struct MergeRule {
+    uint32_t rank;
+    uint32_t merged_id;
+  };
+  static const uint32_t kUnknownSymbol = 0xFFFFFFFF;
+
+  void load_vocab(const string& vocab_file);
+  void load_merges(const string& merges_file);
+  // Appends the ids of one pre-tokenized piece.
+  void merge_piece(const string& piece, vector<size_t>* ids) const;
+  void merge_symbols(vector<uint32_t>* symbols) const;
+  const MergeRule* find_merge(uint32_t left, uint32_t right) const;
+
+  class PieceMerger;
+  class PieceCache;
+
+  bool byte_level_{true};
+  bool add_prefix_space_{false};
+  string unk_token_;
+  size_t unk_token_id_{0};
+  bool has_unk_token_{false};
+  // The ids are checked to fit in 32 bits, the size of the symbols of
+  // merge_symbols.
+  unordered_map<string, size_t> vocab_;
+  unordered_map<size_t, string> inv_vocab_;
+  // The key is the left id in the high half and the right id in the low
+  // half.
+  unordered_map<uint64_t, MergeRule> merges_;
+  // byte_symbols_[b]: the vocab id of the character standing for byte b.
+  vector<uint32_t> byte_symbols_;
+  BasicTokenizer basic_tokenizer_;
+
+  // Null if the cache is disabled.
+  std::unique_ptr<PieceCache> cache_;
+};
+
+#endif  // PADDLENLP_BPE_TOKENIZER_H_
@@ -0,0 +1,110 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_ENCODE_CACHE_H_
+#define PADDLENLP_ENCODE_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+
+// A bounded result cache in front of BertTokenizer::Encode, for serving
+// traffic where a small set of query strings makes up most of the calls.
+// Entries are keyed by the texts and all the encode options, and hold the
+// encoded output as 32-bit values. The cache is split into shards, each
+// with its own mutex, least recently used order and share of max_entries
+// and max_bytes.
+//
+// A miss only replaces the victims of its shard if it was requested more
+// often than them lately (TinyLFU: the request frequencies are estimated
+// by a count-min sketch of small counters which are halved periodically).
+// So a burst of one-off texts does not flush the popular ones. Texts longer
+// than max_text_bytes go straight to the tokenizer.
+//
+// An EncodeCache is bound to one tokenizer; after a vocab reload, build a
+// new cache around the new tokenizer.
+class EncodeCache {
+ public:
+  struct Options {
+    size_t max_entries{100000};
+    size_t max_bytes{size_t{64} << 20};
+    // Entries older than this are dropped; 0 keeps them until evicted.
+    double ttl_seconds{0};
+    // The limit of text.size() + text_pair.size() of the cached calls.
+    size_t max_text_bytes{4096};
+    size_t num_shards{16};
+  };
+
+  struct Stats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+    uint64_t admissions{0};  // misses stored in the cache
+    uint64_t rejections{0};  // misses turned down by the admission policy
+    uint64_t bypasses{0};  // calls with texts over max_text_bytes
+    uint64_t evictions{0};
+    uint64_t expirations{0};
+    size_t num_entries{0};
+    size_t num_bytes{0};  // estimated heap size of the entries
+
+    // hits / (hits + misses), or 0 before the first lookup.
+    double HitRatio() const;
+  };
+
+  explicit EncodeCache(shared_ptr<const BertTokenizer> tokenizer);
+  EncodeCache(shared_ptr<const BertTokenizer> tokenizer,
+              const Options& options);
+  ~EncodeCache();
+
+  // Same as BertTokenizer::Encode. Safe to call from any number of threads.
+  unordered_map<string, vector<size_t>> Encode(
+    const string& text,
+    const string& text_pair = "",
+    const int max_seq_len = -1,
+    bool pad_to_max_seq_len = false,
+    bool return_length = false,
+    bool return_token_type_ids = true,
+    bool return_position_ids = false,
+    bool return_attention_mask = false,
+    const string&  truncation_strategy = "longest_first",
+    bool return_overflowing_tokens = false,
+    bool return_special_tokens_mask = false);
+  void Clear();
+  Stats GetStats() const;
+
+ private:
+  struct Entry;
+  class Shard;
+
+  // Inserts entry unless the admission policy turns it down. Requires the
+  // mutex of shard.
+  void admit(Shard* shard, Entry* entry);
+
+  shared_ptr<const BertTokenizer> tokenizer_;
+  Options options_;
+  size_t shard_max_entries_;
+  size_t shard_max_bytes_;
+  vector<unique_ptr<Shard>> shards_;
+  std::atomic<uint64_t> bypasses_{0};
+};
+
+#endif  // PADDLENLP_ENCODE_CACHE_H_
@@ -0,0 +1,124 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_ENCODE_PIPELINE_H_
+#define PADDLENLP_ENCODE_PIPELINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+
+// Runs BertTokenizer::EncodeInto over large batches of texts as a pipeline
+// of stages, each on its own threads:
+//
+//   kNormalize: UTF-8 decoding, cleaning, normalization and the word split
+//               (BertTokenizer::PreTokenize);
+//   kLookup:    WordPiece and the vocab lookups (ConvertPreTokenizedToIds);
+//   kEncode:    truncation, special tokens and padding into the output
+//               rows (EncodeIdsInto).
+//
+// With plain data parallelism every thread runs the whole chain, and its
+// cache holds the normalization tables, the vocab and the output rows in
+// turn; here every thread keeps the data of one stage. The texts travel
+// in batches of batch_size examples through bounded lock-free queues
+// (RingBuffer) of queue_batches batches. A thread which finds its queue
+// empty or full yields for a while, then sleeps until the queue changes.
+// A full queue stalls the stage feeding it, and the batches are recycled
+// from a fixed pool, so the memory in flight is bounded whatever the input
+// size.
+//
+// An EncodePipeline is immutable; the threads are started by every call,
+// and several calls can run at once.
+class EncodePipeline {
+ public:
+  enum Stage { kNormalize, kLookup, kEncode, kNumStages };
+
+  struct Options {
+    size_t batch_size{64};
+    size_t queue_batches{4};
+    // The threads of every stage.
+    size_t num_threads[kNumStages]{1, 1, 1};
+  };
+
+  struct StageStats {
+    uint64_t batches{0};
+    // Summed over the threads of the stage.
+    double busy_seconds{0};
+    // The times a thread found its input queue empty or its output queue
+    // full, and had to wait.
+    uint64_t input_waits{0};
+    uint64_t output_waits{0};
+    // The waits which outlasted the spinning, so that the thread slept on
+    // the condition variable of the queue.
+    uint64_t input_blocks{0};
+    uint64_t output_blocks{0};
+  };
+
+  // Over all the calls so far.
+  struct Stats {
+    StageStats stages[kNumStages];
+  };
+
+  explicit EncodePipeline(shared_ptr<const BertTokenizer> tokenizer);
+  EncodePipeline(shared_ptr<const BertTokenizer> tokenizer,
+                 const Options& options);
+  ~EncodePipeline();
+
+  // Same rows and seq_lens as BertTokenizer::EncodeInto. If an example
+  // fails, the other rows are still written and the exception of the
+  // first failing example is thrown at the end.
+  void EncodeInto(
+    const vector<string>& texts,
+    const vector<string>& text_pairs,
+    const int max_seq_len,
+    const EncodeBuffers<int64_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first") const;
+  void EncodeInto(
+    const vector<string>& texts,
+    const vector<string>& text_pairs,
+    const int max_seq_len,
+    const EncodeBuffers<int32_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first") const;
+
+  Stats GetStats() const;
+  static const char* StageName(Stage stage);
+
+ private:
+  struct Batch;
+  class Run;
+  struct StageCounters;
+
+  template <typename T>
+  void encode_into(
+    const vector<string>& texts,
+    const vector<string>& text_pairs,
+    const int max_seq_len,
+    const EncodeBuffers<T>& buffers,
+    vector<size_t>* seq_lens,
+    const string& truncation_strategy) const;
+
+  shared_ptr<const BertTokenizer> tokenizer_;
+  Options options_;
+  std::unique_ptr<StageCounters[]> counters_;
+};
+
+#endif  // PADDLENLP_ENCODE_PIPELINE_H_
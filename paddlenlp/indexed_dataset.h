@@ -0,0 +1,183 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_INDEXED_DATASET_H_
+#define PADDLENLP_INDEXED_DATASET_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// Tokenized corpora in the Megatron-LM "mmap" layout: prefix.bin holds the
+// ids of all the sequences back to back, prefix.idx a header and the
+// index:
+//
+//   "MMIDIDX\0\0", uint64 version 1, uint8 dtype code,
+//   uint64 number of sequences, uint64 number of documents + 1,
+//   int32 sizes[sequences], int64 byte pointers[sequences],
+//   int64 document starts[documents + 1]
+//
+// all little endian. A document is a run of sequences (e.g. sentences);
+// document i is the sequences [starts[i], starts[i + 1]).
+
+// The id types, by their Megatron dtype codes. Megatron has no uint32, so
+// vocabs of more than 65536 ids use int32.
+enum class IdType : uint8_t {
+  kUInt16 = 8,
+  kInt32 = 4,
+};
+
+// uint16 ids if every id of the vocab fits, int32 otherwise.
+IdType IdTypeForVocabSize(size_t vocab_size);
+size_t IdTypeSize(IdType type);
+
+// The ids of a sequence or document, read in place from the mapped .bin
+// file.
+template <typename T>
+class IdSpan {
+ public:
+  IdSpan() {}
+  IdSpan(const T* data, size_t size) : data_(data), size_(size) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  T operator[](size_t i) const { return data_[i]; }
+
+ private:
+  const T* data_{nullptr};
+  size_t size_{0};
+};
+
+
+// Writes a .bin/.idx pair. The documents can be added from any number of
+// threads; each one is written whole, in the order of the calls. Throws
+// runtime_error on I/O errors and on ids the id type can not hold.
+class IndexedDatasetWriter {
+ public:
+  IndexedDatasetWriter(const string& prefix, IdType id_type);
+  // Writes the index if Close was not called; errors are lost then.
+  ~IndexedDatasetWriter();
+
+  IndexedDatasetWriter(const IndexedDatasetWriter&) = delete;
+  IndexedDatasetWriter& operator=(const IndexedDatasetWriter&) = delete;
+
+  // Adds a document of one sequence, e.g. the ids of
+  // BertTokenizer::TokenizeToIds. Returns the index of the document.
+  size_t AddDocument(const vector<size_t>& ids);
+  size_t AddDocument(const vector<vector<size_t>>& sequences);
+  // Writes the index and closes the files.
+  void Close();
+
+  size_t NumSequences() const;
+  size_t NumDocuments() const;
+
+ private:
+  // Throws if the ids do not fit id_type_.
+  void check_ids(const vector<size_t>& ids) const;
+  void add_sequence(const vector<size_t>& ids);
+
+  string prefix_;
+  IdType id_type_;
+  mutable std::mutex mutex_;
+  FILE* bin_{nullptr};
+  uint64_t bin_bytes_{0};
+  vector<int32_t> sizes_;
+  vector<int64_t> pointers_;
+  vector<int64_t> document_starts_{0};
+  vector<char> buffer_;
+};
+
+
+// A memory-mapped .bin/.idx pair. Every lookup is O(1) and reads the
+// mapped files in place. Safe to share between threads.
+class IndexedDataset {
+ public:
+  // Maps prefix.bin and prefix.idx. Throws runtime_error if they can not
+  // be mapped or the index is malformed.
+  explicit IndexedDataset(const string& prefix);
+  ~IndexedDataset();
+
+  IndexedDataset(const IndexedDataset&) = delete;
+  IndexedDataset& operator=(const IndexedDataset&) = delete;
+
+  IdType GetIdType() const { return id_type_; }
+  size_t NumSequences() const { return num_sequences_; }
+  size_t NumDocuments() const { return num_documents_; }
+  size_t SequenceLength(size_t i) const;
+  // The sequences [DocumentBegin(i), DocumentEnd(i)) of document i.
+  size_t DocumentBegin(size_t i) const;
+  size_t DocumentEnd(size_t i) const { return DocumentBegin(i + 1); }
+
+  // T must be the type of GetIdType(): uint16_t or int32_t.
+  template <typename T>
+  IdSpan<T> Sequence(size_t i) const {
+    check_type(sizeof(T));
+    return IdSpan<T>(reinterpret_cast<const T*>(bin_ + pointer(i)),
+                     SequenceLength(i));
+  }
+  // All the ids of document i. Needs the sequences of every document to
+  // be adjacent in the .bin file, as IndexedDatasetWriter and Megatron
+  // write them; throws otherwise.
+  template <typename T>
+  IdSpan<T> Document(size_t i) const {
+    check_type(sizeof(T));
+    check_adjacent();
+    const size_t begin = DocumentBegin(i);
+    const size_t end = DocumentEnd(i);
+    if (begin == end) return IdSpan<T>();
+    const uint64_t first = pointer(begin);
+    const uint64_t last = pointer(end - 1) +
+                          SequenceLength(end - 1) * sizeof(T);
+    return IdSpan<T>(reinterpret_cast<const T*>(bin_ + first),
+                     (last - first) / sizeof(T));
+  }
+  // The ids of sequence i as size_t, for either id type.
+  vector<size_t> SequenceIds(size_t i) const;
+
+ private:
+  friend void MergeIndexedDatasets(const vector<string>& prefixes,
+                                   const string& output_prefix);
+
+  uint64_t pointer(size_t i) const;
+  void check_type(size_t type_size) const;
+  void check_adjacent() const;
+
+  IdType id_type_;
+  size_t num_sequences_{0};
+  size_t num_documents_{0};
+  const char* idx_{nullptr};
+  size_t idx_size_{0};
+  const char* bin_{nullptr};
+  size_t bin_size_{0};
+  // The arrays of the index inside idx_; they need not be aligned.
+  const char* sizes_{nullptr};
+  const char* pointers_{nullptr};
+  const char* document_starts_{nullptr};
+  bool adjacent_documents_{true};
+};
+
+
+// Concatenates the datasets of prefixes (e.g. the shards written by
+// several processes) into output_prefix. The ids are widened to int32 if
+// the inputs mix the id types.
+void MergeIndexedDatasets(const vector<string>& prefixes,
+                          const string& output_prefix);
+
+#endif  // PADDLENLP_INDEXED_DATASET_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_MULTI_VOCAB_ENCODER_H_
+#define PADDLENLP_MULTI_VOCAB_ENCODER_H_
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string_view;
+using std::vector;
+
+
+// Tokenizes a text for several tokenizers at once, e.g. the models of an
+// ensemble with different vocabs. The cleaning, CJK splitting,
+// lowercasing, accent stripping and punctuation split run once per group
+// of tokenizers sharing them (see BertTokenizer::SharesPreTokenization),
+// and only WordPiece runs once per tokenizer. The groups are found when
+// the encoder is built.
+//
+// The encoder is immutable, so it can be shared by any number of threads
+// like the tokenizers.
+class MultiVocabEncoder {
+ public:
+  explicit MultiVocabEncoder(
+    const vector<shared_ptr<const BertTokenizer>>& tokenizers);
+
+  size_t NumTokenizers() const { return tokenizers_.size(); }
+  // The number of normalization passes over every text.
+  size_t NumGroups() const { return group_tokenizers_.size(); }
+  // The group of tokenizer i.
+  size_t GroupOf(size_t i) const { return groups_[i]; }
+
+  // (*words)[g] receives the words of text for group g. The malformed
+  // UTF-8 is counted by the diagnostics of the first tokenizer of the
+  // group.
+  void PreTokenize(string_view text, vector<PreTokenizedText>* words) const;
+  // (*ids)[i] receives the ids of tokenizer i for the words of PreTokenize.
+  void ConvertToIds(const vector<PreTokenizedText>& words,
+                    vector<vector<size_t>>* ids) const;
+  // (*ids)[i] receives TokenizeToIds(text) of tokenizer i.
+  void TokenizeToIds(string_view text, vector<vector<size_t>>* ids) const;
+
+ private:
+  vector<shared_ptr<const BertTokenizer>> tokenizers_;
+  vector<size_t> groups_;
+  // The index of the first tokenizer of every group.
+  vector<size_t> group_tokenizers_;
+};
+
+#endif  // PADDLENLP_MULTI_VOCAB_ENCODER_H_
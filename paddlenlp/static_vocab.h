@@ -0,0 +1,158 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_STATIC_VOCAB_H_
+#define PADDLENLP_STATIC_VOCAB_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+// A vocab compiled into the binary by tools/vocab_codegen, which writes a
+// header of constexpr tables (see CMakeLists.txt, EMBEDDED_VOCAB):
+//
+//   - the UTF-8 bytes of all the tokens back to back;
+//   - a minimal perfect hash of the tokens: the hash of a token picks a
+//     bucket, the seed of the bucket picks the slot of the token among
+//     the num_entries slots, and no two tokens share a slot;
+//   - the slot of every id, for the inverse lookup;
+//   - the tables of CharIdTable and the length of the longest token,
+//     which bounds the WordPiece search.
+//
+// The tables are constant data, so they live in the read-only pages of
+// the binary, shared by every process running it, and need no startup
+// work. BertTokenizer binds to them with BertTokenizer(const StaticVocab&).
+
+// A token of the vocab, stored at its slot.
+struct StaticVocabEntry {
+  uint32_t id;
+  // Bits of the token hash, which reject most other tokens without
+  // comparing the bytes.
+  uint32_t fingerprint;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct StaticVocabData {
+  const char* token_bytes;
+  const StaticVocabEntry* entries;
+  size_t num_entries;
+  const uint32_t* bucket_seeds;
+  size_t num_buckets;
+  // The slot of every id, or StaticVocab::kNoSlot for the ids without a
+  // token (lines overridden by a later duplicate).
+  const uint32_t* id_slots;
+  size_t num_ids;
+  size_t max_token_chars;
+  // The CharIdTable of the vocab: ids of the ASCII characters and of the
+  // main CJK blocks.
+  const uint32_t* ascii_ids;
+  const uint32_t* cjk_ids;
+};
+
+class StaticVocab {
+ public:
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+  static constexpr uint32_t kNoSlot = 0xFFFFFFFF;
+
+  constexpr explicit StaticVocab(const StaticVocabData& data) : data_(data) {}
+
+  // The id of token, or kNotFound. Usable in constant expressions, e.g.
+  //   constexpr size_t kUnkId = kMyVocab.Find(L"[UNK]");
+  constexpr size_t Find(std::wstring_view token) const {
+    if (data_.num_entries == 0) return kNotFound;
+    const uint64_t hash = Hash(token);
+    const uint32_t seed = data_.bucket_seeds[Bucket(hash, data_.num_buckets)];
+    const StaticVocabEntry& entry =
+      data_.entries[Slot(hash, seed, data_.num_entries)];
+    if (entry.fingerprint != Fingerprint(hash)) return kNotFound;
+    return SameToken(entry, token) ? entry.id : kNotFound;
+  }
+
+  // The number of tokens, as Vocab::size of the parsed vocab file.
+  constexpr size_t size() const { return data_.num_entries; }
+  // Ids run from 0 to NumIds() - 1; some may have no token.
+  constexpr size_t NumIds() const { return data_.num_ids; }
+  constexpr bool HasId(size_t id) const {
+    return id < data_.num_ids && data_.id_slots[id] != kNoSlot;
+  }
+  // The UTF-8 bytes of the token of id, which must satisfy HasId.
+  constexpr std::string_view Token(size_t id) const {
+    const StaticVocabEntry& entry = data_.entries[data_.id_slots[id]];
+    return std::string_view(data_.token_bytes + entry.offset, entry.size);
+  }
+  constexpr const StaticVocabData& data() const { return data_; }
+
+  // The hash functions shared with vocab_codegen. Hash reads the code
+  // points, so that the wstring candidates of WordPiece need no encoding.
+  static constexpr uint64_t Hash(std::wstring_view token) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (wchar_t ch : token) {
+      hash = (hash ^ static_cast<uint32_t>(ch)) * 0x100000001b3ULL;
+    }
+    return Mix(hash);
+  }
+  static constexpr size_t Bucket(uint64_t hash, size_t num_buckets) {
+    return static_cast<size_t>(hash % num_buckets);
+  }
+  static constexpr size_t Slot(uint64_t hash, uint32_t seed,
+                               size_t num_entries) {
+    return static_cast<size_t>(
+      Mix(hash + seed * 0x9e3779b97f4a7c15ULL) % num_entries);
+  }
+  static constexpr uint32_t Fingerprint(uint64_t hash) {
+    return static_cast<uint32_t>(hash >> 32);
+  }
+
+ private:
+  static constexpr uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // Compares the UTF-8 bytes of entry, which vocab_codegen wrote from
+  // valid code points, with the code points of token.
+  constexpr bool SameToken(const StaticVocabEntry& entry,
+                           std::wstring_view token) const {
+    const char* p = data_.token_bytes + entry.offset;
+    const char* end = p + entry.size;
+    for (wchar_t ch : token) {
+      if (p == end) return false;
+      const uint32_t lead = static_cast<unsigned char>(*p++);
+      uint32_t cp = lead;
+      int trail = 0;
+      if (lead >= 0xF0) {
+        cp = lead & 0x07;
+        trail = 3;
+      } else if (lead >= 0xE0) {
+        cp = lead & 0x0F;
+        trail = 2;
+      } else if (lead >= 0xC0) {
+        cp = lead & 0x1F;
+        trail = 1;
+      }
+      for (; trail > 0 && p != end; --trail) {
+        cp = (cp << 6) | (static_cast<unsigned char>(*p++) & 0x3F);
+      }
+      if (cp != static_cast<uint32_t>(ch)) return false;
+    }
+    return p == end;
+  }
+
+  StaticVocabData data_;
+};
+
+#endif  // PADDLENLP_STATIC_VOCAB_H_
@@ -14,13 +14,21 @@
 
 #include <utf8proc.h>
 
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
 #include <unordered_set>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
+#include "paddlenlp/aho_corasick.h"
+
 using std::wstring;
 using std::string;
+using std::string_view;
 using std::shared_ptr;
 using std::vector;
 using std::unordered_map;
@@ -31,17 +39,108 @@ using std::size_t;
 using Vocab = unordered_map<std::wstring, size_t>;
 using InvVocab = unordered_map<size_t, wstring>;
 
+class StaticVocab;
+
+// Parses a vocab with one token per line. The line number is the token id.
+shared_ptr<Vocab> ParseVocab(std::istream* is);
+// Loads a vocab file. Throws runtime_error if the file can not be opened.
+// Prefer VocabRegistry::GetVocab, which shares the vocab between tokenizers.
+shared_ptr<Vocab> LoadVocab(const string& vocab_file);
+
+// Receives the words produced by BasicTokenizer one by one.
+class WordVisitor {
+ public:
+  virtual ~WordVisitor() {}
+  // word is the normalized word; [begin, end) is the byte range of the input
+  // text it comes from. Returns false to stop the tokenization.
+  virtual bool OnWord(const wstring& word, size_t begin, size_t end) = 0;
+  // A CJK character or an ASCII punctuation character, which is always a
+  // word on its own. The default passes it to OnWord.
+  virtual bool OnChar(wchar_t ch, size_t begin, size_t end);
+};
+
+
+// The ids of the single character tokens of a vocab. The ASCII characters
+// and the main CJK blocks (U+3400..U+9FFF) are looked up with one array
+// load, the other characters go through a hash map, or the perfect hash
+// of a StaticVocab.
+class CharIdTable {
+ public:
+  static const uint32_t kNotFound = 0xFFFFFFFF;
+  static const uint32_t kAsciiSize = 0x80;
+  static const uint32_t kCjkBegin = 0x3400;
+  static const uint32_t kCjkSize = 0xA000 - 0x3400;
+
+  explicit CharIdTable(const Vocab& vocab);
+  // Uses the tables compiled into vocab, which must outlive the table.
+  explicit CharIdTable(const StaticVocab& vocab);
+  CharIdTable(const CharIdTable&) = delete;
+  CharIdTable& operator=(const CharIdTable&) = delete;
+
+  uint32_t Find(wchar_t ch) const {
+    const uint32_t c = static_cast<uint32_t>(ch);
+    if (c < kAsciiSize) return ascii_ids_[c];
+    if (c - kCjkBegin < kCjkSize) return cjk_ids_[c - kCjkBegin];
+    return find_other(ch);
+  }
+  size_t EstimateMemoryUsage() const;
+
+ private:
+  uint32_t find_other(wchar_t ch) const;
+
+  const uint32_t* ascii_ids_;
+  const uint32_t* cjk_ids_;
+  // The arrays of ascii_ids_ and cjk_ids_, unless they are static.
+  vector<uint32_t> tables_;
+  unordered_map<wchar_t, uint32_t> other_ids_;
+  const StaticVocab* static_vocab_{nullptr};
+};
+
+
 class BasicTokenizer {
  public:
   explicit BasicTokenizer(bool do_lower_case = true);
   vector<wstring> Tokenize(const string& text) const;
+  // Streams the words of text to the visitor instead of collecting them.
+  // Malformed UTF-8 is read as U+FFFD, which is dropped like in the
+  // Python tokenizer; returns the number of malformed sequences.
+  size_t Tokenize(string_view text, WordVisitor* visitor) const;
+  // True if the cleaning and the normalization leave text as it is: it is
+  // valid UTF-8 without control characters or U+FFFD and, with
+  // do_lower_case, without upper case letters, characters NFD decomposes
+  // and combining marks. The text is classified 64 bytes at a time, and
+  // blocks of ASCII and CJK ideographs need no look at the characters.
+  bool IsNormalized(string_view text) const;
+  // Same words as Tokenize(text, visitor) for a text for which IsNormalized
+  // holds, without the cleaning, the lower casing and the accent stripping
+  // of the non-ASCII characters.
+  void TokenizeNormalized(string_view text, WordVisitor* visitor) const;
+  // Returns the last position p in (begin, end] where the text can be cut
+  // without changing its words: p follows an ASCII whitespace or
+  // punctuation character, or a CJK character. Returns begin if there is
+  // none.
+  size_t FindStableCut(string_view text, size_t begin, size_t end) const;
 
  private:
-  wstring clean_text(const wstring& text) const;
   bool is_chinese_char(const wchar_t& ch) const;
-  wstring tokenize_chinese_chars(const wstring& text) const;
   wstring run_strip_accents(const wstring& text) const;
-  vector<wstring> run_split_on_punc(const wstring& text) const;
+  // Emits the words of text split on the punctuation; returns false if
+  // the visitor stops.
+  bool run_split_on_punc(const wstring& text,
+                         size_t begin,
+                         size_t end,
+                         WordVisitor* visitor) const;
+  // Emits a word to the visitor. If normalize is set, the word is lower
+  // cased and stripped of accents (with fold) and split on the punctuation
+  // first.
+  bool emit_word(const wstring& word,
+                 bool normalize,
+                 bool fold,
+                 size_t begin,
+                 size_t end,
+                 WordVisitor* visitor) const;
+  // Tokenize, or TokenizeNormalized if normalized is set.
+  size_t scan(string_view text, bool normalized, WordVisitor* visitor) const;
 
   bool do_lower_case_{true};
 };
@@ -49,19 +148,54 @@ class BasicTokenizer {
 
 class WordPieceTokenizer {
  public:
+  static const size_t kUnknownId = static_cast<size_t>(-1);
+
+  // A token of a word: the characters [begin, end) of the word and the
+  // vocab id, or kUnknownId for the unknown token.
+  struct Piece {
+    size_t begin;
+    size_t end;
+    size_t id;
+  };
+
+  explicit WordPieceTokenizer(
+    const shared_ptr<const Vocab>& vocab,
+    const wstring& unk_token = L"[UNK]",
+    const size_t max_input_chars_per_word = 100);
+  // Uses a vocab compiled into the binary, which must outlive the
+  // tokenizer.
   explicit WordPieceTokenizer(
-    const shared_ptr<Vocab>& vocab,
+    const StaticVocab* vocab,
     const wstring& unk_token = L"[UNK]",
     const size_t max_input_chars_per_word = 100);
   vector<wstring> Tokenize(const wstring& text) const;
+  // Returns Tokenize(text).size(). buffer holds the candidate pieces, so
+  // that a caller reusing it allocates nothing per token.
+  size_t CountTokens(const wstring& text, wstring* buffer) const;
+  // The pieces of Tokenize(text), without building the token strings.
+  void TokenizePieces(const wstring& text,
+                      wstring* buffer,
+                      vector<Piece>* pieces) const;
 
  private:
-  shared_ptr<Vocab> vocab_;
+  // The id of token, or kUnknownId if it is not in the vocab.
+  size_t find_id(const wstring& token) const;
+
+  // One of vocab_ and static_vocab_ is set.
+  shared_ptr<const Vocab> vocab_;
+  const StaticVocab* static_vocab_{nullptr};
   wstring unk_token_{L"[UNK]"};
+  // Longer words are a single unknown token.
   size_t max_input_chars_per_word_;
+  // The length of the longest token of the vocab, which bounds the
+  // candidate pieces.
+  size_t max_token_chars_{0};
 };
 
 
+// FullTokenizer and BertTokenizer are immutable after construction (and
+// after BertTokenizer::AddTokens), so one instance can be shared by any
+// number of threads: every lookup only reads the vocab.
 class FullTokenizer {
  public:
   explicit FullTokenizer(const string& vocab_file, bool do_lower_case = true);
@@ -69,17 +203,156 @@ class FullTokenizer {
   vector<size_t> ConvertTokensToIds(const vector<wstring>& text) const;
 
  private:
-  shared_ptr<Vocab> vocab_;
-  InvVocab inv_vocab_;
+  shared_ptr<const Vocab> vocab_;
+  shared_ptr<const InvVocab> inv_vocab_;
   string vocab_file_;
   bool do_lower_case_{true};
   BasicTokenizer basic_tokenizer_;
   WordPieceTokenizer word_piece_tokenizer_;
+  size_t unk_token_id_{0};
+};
+
+
+// Row-major destination buffers of BertTokenizer::EncodeInto, e.g. the
+// input tensors of an inference engine. Row i of a buffer starts
+// i * stride elements after the pointer; a stride of 0 means rows of
+// max_seq_len elements. Null buffers are not written.
+template <typename T>
+struct EncodeBuffers {
+  T* input_ids{nullptr};
+  size_t input_ids_stride{0};
+  T* token_type_ids{nullptr};
+  size_t token_type_ids_stride{0};
+  T* attention_mask{nullptr};
+  size_t attention_mask_stride{0};
+  T* position_ids{nullptr};
+  size_t position_ids_stride{0};
+};
+
+// Unpadded rows laid out back to back: row i takes the positions
+// [row_offsets[i], row_offsets[i + 1]) of input_ids and token_type_ids.
+template <typename T>
+struct RaggedEncoding {
+  vector<T> input_ids;
+  vector<T> token_type_ids;
+  vector<size_t> row_offsets;
+};
+
+// Whole-word masking of BertTokenizer::EncodeMasked, as in BERT
+// pre-training: words are picked at random until masking_rate of the
+// tokens (at most max_predictions) are picked, and every token of a
+// picked word is replaced by the mask token with probability mask_prob,
+// by a random token with probability random_prob and kept otherwise.
+struct MaskingOptions {
+  double masking_rate{0.15};
+  size_t max_predictions{20};
+  double mask_prob{0.8};
+  double random_prob{0.1};
+};
+
+struct MaskedEncoding {
+  // The masked [CLS] text [SEP] text_pair [SEP].
+  vector<size_t> input_ids;
+  vector<size_t> token_type_ids;
+  // The picked positions in increasing order and their original ids.
+  vector<size_t> masked_positions;
+  vector<size_t> labels;
+};
+
+// A token of BertTokenizer::TokenizeSpans: its bytes [byte_begin,
+// byte_end) and its id. The bytes are a slice of the input text, or of
+// TokenSpans::normalized if the normalization changed the word (flag
+// kNormalized). A "##" piece (kContinuation) spans the bytes after the
+// "##"; an unknown word spans the whole word.
+struct TokenSpan {
+  static const uint32_t kNormalized = 1;
+  static const uint32_t kContinuation = 2;
+  static const uint32_t kUnknown = 4;
+  static const uint32_t kAddedToken = 8;
+
+  uint32_t byte_begin;
+  uint32_t byte_end;
+  uint32_t id;
+  uint32_t flags;
+};
+
+// Reusing one TokenSpans for many texts keeps the tokenization free of
+// allocations once the vectors are large enough.
+struct TokenSpans {
+  vector<TokenSpan> spans;
+  // The normalized words the kNormalized spans point into.
+  string normalized;
+
+  // The bytes of span, where input is the text given to TokenizeSpans.
+  string_view Text(const TokenSpan& span, string_view input) const {
+    const string_view source =
+      span.flags & TokenSpan::kNormalized ? string_view(normalized) : input;
+    return source.substr(span.byte_begin, span.byte_end - span.byte_begin);
+  }
+};
+
+// Per-call bounds on the work of BertTokenizer::TokenizeToIds, e.g. for
+// untrusted inputs. The tokenization takes time linear in the bytes
+// scanned, so the two limits bound its latency.
+struct TokenizeLimits {
+  // Longer texts throw runtime_error before anything is tokenized.
+  size_t max_bytes{static_cast<size_t>(-1)};
+  // Only the first max_tokens ids are returned, and the text is only
+  // scanned as far as they need.
+  size_t max_tokens{static_cast<size_t>(-1)};
+};
+
+// The words of a text after the added token split and the basic
+// tokenization, before WordPiece. They only depend on do_lower_case and
+// the added tokens, so one BertTokenizer::PreTokenize serves every
+// tokenizer for which SharesPreTokenization holds, whatever its vocab.
+struct PreTokenizedText {
+  enum Kind : uint8_t {
+    // Normalized characters that go through WordPiece.
+    kWord,
+    // A CJK or ASCII punctuation character, a token on its own.
+    kChar,
+    // An added token, by its index in the added tokens.
+    kAddedToken,
+  };
+  struct Word {
+    Kind kind;
+    // The characters [char_begin, char_end) of chars, or the index of the
+    // added token in char_begin.
+    size_t char_begin;
+    size_t char_end;
+    // The bytes of the input text the word comes from.
+    size_t byte_begin;
+    size_t byte_end;
+  };
+
+  vector<Word> words;
+  wstring chars;
 };
 
 
 class BertTokenizer {
  public:
+    static const size_t kNoTokenLimit = static_cast<size_t>(-1);
+
+    // Counts of the non-fatal problems of the inputs so far, over all
+    // threads.
+    struct Diagnostics {
+      // Malformed UTF-8 sequences, dropped like U+FFFD.
+      uint64_t malformed_utf8_sequences{0};
+      // Truncations the strategy could not do; the sequences are left as
+      // they were.
+      uint64_t failed_truncations{0};
+    };
+
+    // What one call did with SetNormalizedFastPath: the texts checked
+    // (every text between added tokens counts), and those which passed the
+    // check and took the fast path.
+    struct NormalizedStats {
+      uint64_t checks{0};
+      uint64_t fast_paths{0};
+    };
+
     explicit BertTokenizer(
       const string& vocab_file,
       bool do_lower_case = true,
@@ -89,8 +362,79 @@ class BertTokenizer {
       const wstring& mask_token = L"[MASK]",
       const wstring& sep_token = L"[SEP]",
       const string& padding_site = "right");
+    // Binds to a vocab compiled into the binary by tools/vocab_codegen,
+    // e.g. the kEmbeddedVocab of paddlenlp/embedded_vocab.h. No file is
+    // read and no table is built: the lookups read the constant tables of
+    // vocab, which must outlive the tokenizer.
+    explicit BertTokenizer(
+      const StaticVocab& vocab,
+      bool do_lower_case = true,
+      const wstring& unk_token = L"[UNK]",
+      const wstring& pad_token = L"[PAD]",
+      const wstring& cls_token = L"[CLS]",
+      const wstring& mask_token = L"[MASK]",
+      const wstring& sep_token = L"[SEP]",
+      const string& padding_site = "right");
 
+    // Registers tokens that are never split by Tokenize, e.g. domain
+    // specific terms. Added tokens are matched case-sensitively in the raw
+    // text; tokens missing from the vocab get new ids after the last id.
+    // If special_tokens is true, the tokens are also treated as special
+    // tokens by GetSpecialTokensMask. Returns the number of tokens that
+    // were missing from the vocab. AddTokens modifies the tokenizer, so
+    // call it before sharing the tokenizer across threads.
+    size_t AddTokens(
+      const vector<wstring>& tokens,
+      bool special_tokens = false);
+    // For inputs which are mostly normalized already (lower cased, with no
+    // accents and no control characters): every text is first checked by
+    // BasicTokenizer::IsNormalized, and skips the cleaning and the
+    // normalization if it passes. The other texts take the full path, so
+    // the tokens are the same either way; TokenizeToIds can report which
+    // path the texts took. Like AddTokens, call it before sharing the
+    // tokenizer across threads.
+    void SetNormalizedFastPath(bool enable);
     vector<wstring> Tokenize(const string& text) const;
+    // Returns the last position p in (begin, end] where text can be cut
+    // whatever is appended to it later: the tokens of text[0, p) followed
+    // by those of the rest are the tokens of the whole text. begin must be
+    // 0 or such a cut. Returns begin if there is none.
+    size_t FindStableCut(string_view text, size_t begin, size_t end) const;
+    // Tokenizes text like Tokenize, but returns the tokens as spans of
+    // text and ids instead of strings. Throws if text is 4GB or more.
+    void TokenizeSpans(string_view text, TokenSpans* output) const;
+    // Returns ConvertTokensToIds(Tokenize(text)). The vocab lookups of the
+    // tokenization give the ids directly, so no token string is built.
+    vector<size_t> TokenizeToIds(string_view text) const;
+    vector<size_t> TokenizeToIds(string_view text,
+                                 const TokenizeLimits& limits) const;
+    // Same as TokenizeToIds(text), and fills *stats for this call.
+    vector<size_t> TokenizeToIds(string_view text,
+                                 NormalizedStats* stats) const;
+    // Splits text into the words TokenizeToIds maps to ids, so that they
+    // can be mapped by several tokenizers (see MultiVocabEncoder).
+    void PreTokenize(string_view text, PreTokenizedText* output) const;
+    // Same for a prefix of text with at least min_words words, if there
+    // is one: the words are the first ones of the whole text, and they
+    // give at least min_words ids. The text is scanned in growing windows,
+    // so a long text costs about as much as the prefix.
+    void PreTokenize(string_view text,
+                     size_t min_words,
+                     PreTokenizedText* output) const;
+    // Gives TokenizeToIds(text) from the words of PreTokenize(text) of a
+    // tokenizer for which SharesPreTokenization holds.
+    void ConvertPreTokenizedToIds(const PreTokenizedText& text,
+                                  vector<size_t>* ids) const;
+    // True if the two tokenizers split every text into the same words:
+    // they have the same do_lower_case and the same added tokens, added in
+    // the same order.
+    bool SharesPreTokenization(const BertTokenizer& other) const;
+    // Returns min(Tokenize(text).size(), max_count) without building the
+    // tokens. The tokenization stops once max_count tokens are counted.
+    size_t CountTokens(const string& text,
+                       size_t max_count = kNoTokenLimit) const;
+    vector<size_t> CountTokens(const vector<string>& texts,
+                               size_t max_count = kNoTokenLimit) const;
     vector<size_t> BuildInputsWithSpecialTokens(
       const vector<size_t>& token_ids_0,
       const vector<size_t>& token_ids_1 = vector<size_t>()) const;
@@ -102,7 +446,10 @@ class BertTokenizer {
     string ConvertTokensToString(
       const vector<wstring>& tokens) const;
     vector<wstring> ConvertIdsToTokens(
-      const vector<size_t>& token_ids);
+      const vector<size_t>& token_ids) const;
+    // If the strategy can not remove num_tokens_to_remove tokens, the
+    // sequences are left unchanged and the failure is counted in
+    // GetDiagnostics.
     unordered_map<string, vector<size_t>> TruncateSequence(
       vector<size_t>* ids,
       vector<size_t>* pair_ids,
@@ -121,6 +468,12 @@ class BertTokenizer {
       const vector<size_t>& token_ids_1 = vector<size_t>(),
       const bool already_has_special_tokens = false) const;
     size_t GetNumSpecialTokensToAdd(const bool pair = false) const;
+    // The number of ids, with the added tokens.
+    size_t GetVocabSize() const;
+    Diagnostics GetDiagnostics() const;
+    // With max_seq_len > 0, only the part of the texts kept by the
+    // truncation is tokenized. overflowing_token_ids and
+    // num_truncated_tokens are only returned with return_overflowing_tokens.
     unordered_map<string, vector<size_t>> Encode(
       const string& text,
       const string& text_pair = "",
@@ -146,23 +499,242 @@ class BertTokenizer {
     const string&  truncation_strategy = "longest_first",
     bool return_overflowing_tokens = false,
     bool return_special_tokens_mask = false) const;
+  // Encodes texts[i], with text_pairs[i] unless text_pairs is empty,
+  // straight into row i of the buffers. The rows hold the values of
+  // Encode with pad_to_max_seq_len, padded on the left if padding_site is
+  // "left" and on the right otherwise; the attention mask is 0 on the
+  // padding. seq_lens, if not null, receives the lengths before padding.
+  // Throws where Encode does, after writing the rows before the failing
+  // example.
+  void EncodeInto(
+    const vector<string>& texts,
+    const vector<string>& text_pairs,
+    const int max_seq_len,
+    const EncodeBuffers<int64_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first") const;
+  void EncodeInto(
+    const vector<string>& texts,
+    const vector<string>& text_pairs,
+    const int max_seq_len,
+    const EncodeBuffers<int32_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first") const;
+  // The last steps of EncodeInto for ids and pair_ids from TokenizeToIds
+  // (or ConvertPreTokenizedToIds) of a text and its pair, e.g. in a
+  // pipeline tokenizing them elsewhere: truncates them and writes row i of
+  // the buffers. Returns the length before padding.
+  size_t EncodeIdsInto(
+    vector<size_t>* ids,
+    vector<size_t>* pair_ids,
+    const int max_seq_len,
+    const EncodeBuffers<int64_t>& buffers,
+    size_t i,
+    const string& truncation_strategy = "longest_first") const;
+  size_t EncodeIdsInto(
+    vector<size_t>* ids,
+    vector<size_t>* pair_ids,
+    const int max_seq_len,
+    const EncodeBuffers<int32_t>& buffers,
+    size_t i,
+    const string& truncation_strategy = "longest_first") const;
+  // Encodes the pairs (query, passages[i]) as EncodeInto does, e.g. for
+  // reranking with a cross-encoder. The query is tokenized once and the
+  // passages on num_threads threads (0 means one per core). Row i gets
+  // the same values as Encode(query, passages[i], ...). Throws where
+  // Encode does, before writing any row.
+  void EncodePairs(
+    const string& query,
+    const vector<string>& passages,
+    const int max_seq_len,
+    const EncodeBuffers<int64_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first",
+    size_t num_threads = 0) const;
+  void EncodePairs(
+    const string& query,
+    const vector<string>& passages,
+    const int max_seq_len,
+    const EncodeBuffers<int32_t>& buffers,
+    vector<size_t>* seq_lens = nullptr,
+    const string& truncation_strategy = "longest_first",
+    size_t num_threads = 0) const;
+  // Same without padding; max_seq_len <= 0 keeps the pairs whole.
+  void EncodePairs(
+    const string& query,
+    const vector<string>& passages,
+    const int max_seq_len,
+    RaggedEncoding<int64_t>* output,
+    const string& truncation_strategy = "longest_first",
+    size_t num_threads = 0) const;
+  void EncodePairs(
+    const string& query,
+    const vector<string>& passages,
+    const int max_seq_len,
+    RaggedEncoding<int32_t>* output,
+    const string& truncation_strategy = "longest_first",
+    size_t num_threads = 0) const;
+  // Encodes text and text_pair as Encode does without padding and masks
+  // whole words, taken from the word boundaries of the tokenization. The
+  // special tokens are never masked. The masking only depends on the ids
+  // and seed, so an example gets the same masks on every platform and
+  // thread; give every example and epoch its own seed.
+  void EncodeMasked(
+    const string& text,
+    const string& text_pair,
+    const int max_seq_len,
+    const MaskingOptions& options,
+    uint64_t seed,
+    MaskedEncoding* output,
+    const string& truncation_strategy = "longest_first") const;
 
 
  private:
+    // Collects the ids of the words of BasicTokenizer; the single
+    // characters are looked up in char_ids_.
+    class IdCollector;
+    // Collects the spans of TokenizeSpans.
+    class SpanCollector;
+
+    // Returns the first max_tokens ids of text. With a limit, the text is
+    // consumed in growing windows and the tokenization stops as soon as
+    // the limit is reached.
     vector<size_t> get_input_ids(
-      const string& text) const;
+      string_view text,
+      size_t max_tokens = kNoTokenLimit,
+      vector<size_t>* word_starts = nullptr) const;
+    // Feeds the ids of text to collector until it is full.
+    void collect_ids(string_view text,
+                     size_t max_tokens,
+                     IdCollector* collector) const;
+    // Tokenizes text and text_pair only as far as the truncation to
+    // max_seq_len keeps them: TruncateSequence gives the same ids on the
+    // returned prefixes as on the full sequences. Without a limit, or when
+    // the overflowing tokens are requested, everything is tokenized. The
+    // word starts, if not null, receive the index of the first id of
+    // every word.
+    void get_bounded_input_ids(
+      const string& text,
+      const string& text_pair,
+      const int max_seq_len,
+      const string& truncation_strategy,
+      bool return_overflowing_tokens,
+      vector<size_t>* ids,
+      vector<size_t>* pair_ids,
+      vector<size_t>* word_starts = nullptr,
+      vector<size_t>* pair_word_starts = nullptr) const;
+    // The same with the ids of text already at hand.
+    void get_bounded_pair_ids(
+      const vector<size_t>& text_ids,
+      const string& text_pair,
+      const int max_seq_len,
+      const string& truncation_strategy,
+      vector<size_t>* ids,
+      vector<size_t>* pair_ids) const;
+    // Truncates ids and pair_ids as Encode does and returns the length
+    // with the special tokens. Throws if they still do not fit.
+    size_t truncate_ids(
+      const int max_seq_len,
+      const string& truncation_strategy,
+      vector<size_t>* ids,
+      vector<size_t>* pair_ids) const;
+    template <typename T>
+    size_t encode_ids_into(
+      vector<size_t>* ids,
+      vector<size_t>* pair_ids,
+      const int max_seq_len,
+      const EncodeBuffers<T>& buffers,
+      size_t i,
+      const string& truncation_strategy) const;
+    // Writes the padded row i of width columns.
+    template <typename T>
+    void write_padded_row(
+      const vector<size_t>& ids,
+      const vector<size_t>& pair_ids,
+      size_t width,
+      const EncodeBuffers<T>& buffers,
+      size_t i) const;
+    // Gets the truncated ids of every pair, in parallel.
+    void encode_pair_ids(
+      const string& query,
+      const vector<string>& passages,
+      const int max_seq_len,
+      const string& truncation_strategy,
+      size_t num_threads,
+      vector<vector<size_t>>* ids,
+      vector<vector<size_t>>* pair_ids) const;
+    template <typename T>
+    void encode_pairs(
+      const string& query,
+      const vector<string>& passages,
+      const int max_seq_len,
+      const EncodeBuffers<T>& buffers,
+      vector<size_t>* seq_lens,
+      const string& truncation_strategy,
+      size_t num_threads) const;
+    template <typename T>
+    void encode_pairs(
+      const string& query,
+      const vector<string>& passages,
+      const int max_seq_len,
+      RaggedEncoding<T>* output,
+      const string& truncation_strategy,
+      size_t num_threads) const;
+    template <typename T>
+    void encode_into(
+      const vector<string>& texts,
+      const vector<string>& text_pairs,
+      const int max_seq_len,
+      const EncodeBuffers<T>& buffers,
+      vector<size_t>* seq_lens,
+      const string& truncation_strategy) const;
+    vector<wstring> tokenize_segment(const string& text) const;
+    void tokenize_segment_ids(string_view text,
+                              IdCollector* collector) const;
+    size_t token_to_id(const wstring& token) const;
+    // The id of token in the vocab, or WordPieceTokenizer::kUnknownId;
+    // the added tokens are not looked up.
+    size_t vocab_id(const wstring& token) const;
+    size_t vocab_size() const;
+    // Sets *token to the vocab token of id; returns false if there is none.
+    bool vocab_token(size_t id, wstring* token) const;
+    void count_malformed(size_t num_malformed) const;
+    // basic_tokenizer_.Tokenize(text, visitor), or TokenizeNormalized with
+    // the normalized fast path; counts the malformed UTF-8, and the checks
+    // of the fast path in stats if not null.
+    void basic_tokenize(string_view text,
+                        WordVisitor* visitor,
+                        NormalizedStats* stats = nullptr) const;
+    void rebuild_added_tokens_matcher();
     vector<wstring> all_special_tokens_;
     unordered_set<size_t> all_special_token_ids_;
     string vocab_file_;
-    shared_ptr<Vocab> vocab_;
-    InvVocab inv_vocab_;
+    // vocab_ and inv_vocab_, or static_vocab_ for a compiled vocab.
+    shared_ptr<const Vocab> vocab_;
+    shared_ptr<const InvVocab> inv_vocab_;
+    const StaticVocab* static_vocab_{nullptr};
+    shared_ptr<const CharIdTable> char_ids_;
     bool do_lower_case_{true};
+    bool normalized_fast_path_{false};
     BasicTokenizer basic_tokenizer_;
     WordPieceTokenizer word_piece_tokenizer_;
     wstring unk_token_, cls_token_, mask_token_, pad_token_, sep_token_;
     size_t unk_token_id_, cls_token_id_,
       mask_token_id_, pad_token_id_, sep_token_id_;
     string padding_site_{"right"};
+    // The added tokens and their ids, indexed by the pattern id of
+    // added_tokens_matcher_. The special tokens are always registered.
+    vector<wstring> added_tokens_;
+    vector<size_t> added_token_ids_;
+    // added_vocab_: the added tokens which are not in vocab_.
+    Vocab added_vocab_;
+    InvVocab added_inv_vocab_;
+    // The id of the next token added to added_vocab_: one past the largest
+    // id so far, with the added tokens.
+    size_t next_added_id_{0};
+    AhoCorasick added_tokens_matcher_;
+    mutable std::atomic<uint64_t> num_malformed_utf8_{0};
+    mutable std::atomic<uint64_t> num_failed_truncations_{0};
 };
 
 #endif  // PADDLENLP_TOKENIZER_H_
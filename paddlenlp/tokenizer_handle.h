@@ -0,0 +1,117 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_TOKENIZER_HANDLE_H_
+#define PADDLENLP_TOKENIZER_HANDLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using std::wstring;
+
+
+// Publishes an immutable BertTokenizer snapshot to many reader threads, so
+// that a new vocab or new special tokens can be rolled out without restarting
+// the process. A swap never waits for the in-flight encodes.
+//
+// Every Publish bumps a version counter next to the pointer. Each thread
+// caches the snapshot it last took, with the version it saw, and only
+// reloads it when the version has changed, so a steady state Tokenize or
+// Encode costs one acquire load of the version. Reloading goes through
+// std::atomic_load, which is not lock-free in libstdc++ (it takes one of a
+// small table of spinlocks) and increments the shared use count; Get()
+// also copies the cached pointer, so prefer Tokenize and Encode, or hold on
+// to the snapshot, rather than calling Get() for every text.
+//
+// Replaced snapshots are retired and freed by the writer side once no
+// reader holds them anymore, so a reader never pays for destroying one. A
+// thread keeps its cached snapshot until its next call through the handle
+// or until it exits, so an idle thread delays freeing a retired snapshot.
+class TokenizerHandle {
+ public:
+  using Factory = std::function<shared_ptr<const BertTokenizer>()>;
+
+  explicit TokenizerHandle(shared_ptr<const BertTokenizer> tokenizer);
+
+  // Returns the current snapshot. Hold on to the returned pointer to encode
+  // several texts with the same vocab.
+  shared_ptr<const BertTokenizer> Get() const;
+  // Replaces the current snapshot and retires the previous one. The readers
+  // holding the previous one are not affected.
+  void Publish(shared_ptr<const BertTokenizer> tokenizer);
+  // Frees the retired snapshots that no reader holds anymore. Returns the
+  // number of retired snapshots which are still in use.
+  size_t Reclaim();
+  // Builds a new tokenizer with the factory in a background thread and
+  // publishes it once it is ready. The current snapshot keeps serving in the
+  // meantime. The background thread then waits (up to one second) for the
+  // readers to drain the previous snapshot and frees it; otherwise it is
+  // freed by a later Publish or Reclaim. The future rethrows the exception
+  // of a failed build, in which case nothing is published. The background
+  // thread uses the handle, so the handle must outlive the future. Like
+  // every future of std::async, the future waits for the thread when it is
+  // destroyed: a discarded future makes the call synchronous.
+  [[nodiscard]] std::future<void> ReloadAsync(Factory factory);
+  [[nodiscard]] std::future<void> ReloadAsync(
+    const string& vocab_file,
+    bool do_lower_case = true,
+    const wstring& unk_token = L"[UNK]",
+    const wstring& pad_token = L"[PAD]",
+    const wstring& cls_token = L"[CLS]",
+    const wstring& mask_token = L"[MASK]",
+    const wstring& sep_token = L"[SEP]",
+    const string& padding_site = "right");
+  // The number of snapshots published so far, starting at 1.
+  uint64_t Version() const;
+
+  vector<wstring> Tokenize(const string& text) const;
+  unordered_map<string, vector<size_t>> Encode(
+    const string& text,
+    const string& text_pair = "",
+    const int max_seq_len = -1,
+    bool pad_to_max_seq_len = false,
+    bool return_length = false,
+    bool return_token_type_ids = true,
+    bool return_position_ids = false,
+    bool return_attention_mask = false,
+    const string&  truncation_strategy = "longest_first",
+    bool return_overflowing_tokens = false,
+    bool return_special_tokens_mask = false) const;
+
+ private:
+  // Returns the snapshot cached by the calling thread, reloaded if a newer
+  // one was published. Valid until the thread's next call on the handle.
+  const shared_ptr<const BertTokenizer>& cached() const;
+
+  // Tells apart the handles in the per-thread caches.
+  const uint64_t id_;
+  // Only accessed through the std::atomic_* functions for shared_ptr.
+  shared_ptr<const BertTokenizer> tokenizer_;
+  // Bumped after tokenizer_ is replaced.
+  std::atomic<uint64_t> version_{1};
+  std::mutex retired_mutex_;
+  vector<shared_ptr<const BertTokenizer>> retired_;
+};
+
+#endif  // PADDLENLP_TOKENIZER_HANDLE_H_
@@ -0,0 +1,67 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_TOKENIZER_SESSION_H_
+#define PADDLENLP_TOKENIZER_SESSION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::wstring;
+
+
+// Tokenizes a text which grows by appending, e.g. a chat message being
+// typed. The tokens before the last stable cut of the text (see
+// BertTokenizer::FindStableCut) are final, so Append only tokenizes the
+// tail after that cut again instead of the whole text. After every Append,
+// Tokens() is Tokenize(Text()) and Ids() its ids.
+//
+// A session is not thread safe; the tokenizer can be shared by many.
+class TokenizerSession {
+ public:
+  // The change of the output made by one Append: the last num_removed
+  // tokens are dropped, then tokens are appended.
+  struct Delta {
+    size_t num_removed{0};
+    vector<wstring> tokens;
+    vector<size_t> ids;
+  };
+
+  explicit TokenizerSession(shared_ptr<const BertTokenizer> tokenizer);
+
+  // Appends chunk, which can end in the middle of a UTF-8 character, to
+  // the text. If Tokenize throws, the session is left as it was.
+  void Append(const string& chunk, Delta* delta = nullptr);
+  void Reset();
+
+  const string& Text() const { return text_; }
+  const vector<wstring>& Tokens() const { return tokens_; }
+  const vector<size_t>& Ids() const { return ids_; }
+  // The bytes of Text() whose tokens can not change anymore.
+  size_t StableSize() const { return stable_end_; }
+
+ private:
+  shared_ptr<const BertTokenizer> tokenizer_;
+  string text_;
+  vector<wstring> tokens_;
+  vector<size_t> ids_;
+  // The tokens of text_[0, stable_end_) are the first num_stable_tokens_.
+  size_t stable_end_{0};
+  size_t num_stable_tokens_{0};
+};
+
+#endif  // PADDLENLP_TOKENIZER_SESSION_H_
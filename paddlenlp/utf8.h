@@ -0,0 +1,111 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_UTF8_H_
+#define PADDLENLP_UTF8_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using std::size_t;
+using std::string;
+
+
+const int32_t kUtf8Invalid = -1;
+const int32_t kUtf8Incomplete = -2;
+const uint32_t kUtf8Replacement = 0xFFFD;
+
+// Decodes the UTF-8 character at the beginning of s[0, n), n > 0. Returns the
+// code point and sets *len to its length in bytes. For a malformed sequence,
+// returns kUtf8Invalid and sets *len to the length of its longest valid
+// prefix, at least 1: the bytes to replace by one U+FFFD before decoding on.
+// Returns kUtf8Incomplete if s[0, n) is a valid but unfinished sequence. The
+// accepted sequences are the same as the ones of std::codecvt_utf8<wchar_t>:
+// overlong forms and code points above U+10FFFF are rejected, surrogates are
+// accepted.
+inline int32_t DecodeUtf8(const char* s, size_t n, size_t* len) {
+  const uint8_t c0 = static_cast<uint8_t>(s[0]);
+  *len = 1;
+  if (c0 < 0x80) return c0;
+  size_t need;
+  int32_t cp;
+  uint8_t min1 = 0x80, max1 = 0xBF;
+  if (c0 < 0xC2) {
+    return kUtf8Invalid;
+  } else if (c0 < 0xE0) {
+    need = 2;
+    cp = c0 & 0x1F;
+  } else if (c0 < 0xF0) {
+    need = 3;
+    cp = c0 & 0x0F;
+    if (c0 == 0xE0) min1 = 0xA0;
+  } else if (c0 < 0xF5) {
+    need = 4;
+    cp = c0 & 0x07;
+    if (c0 == 0xF0) min1 = 0x90;
+    if (c0 == 0xF4) max1 = 0x8F;
+  } else {
+    return kUtf8Invalid;
+  }
+  for (size_t k = 1; k < need; ++k) {
+    if (k == n) return kUtf8Incomplete;
+    const uint8_t c = static_cast<uint8_t>(s[k]);
+    if (k == 1 ? (c < min1 || c > max1) : (c & 0xC0) != 0x80) {
+      *len = k;
+      return kUtf8Invalid;
+    }
+    cp = (cp << 6) | (c & 0x3F);
+  }
+  *len = need;
+  return cp;
+}
+
+// Decodes text, replacing every malformed sequence and an unfinished last
+// character by U+FFFD. Never throws.
+inline std::wstring DecodeUtf8Lenient(const string& text) {
+  std::wstring out;
+  out.reserve(text.size());
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t len = 1;
+    const int32_t cp = DecodeUtf8(text.data() + pos, text.size() - pos, &len);
+    if (cp == kUtf8Incomplete) {
+      out.push_back(static_cast<wchar_t>(kUtf8Replacement));
+      break;
+    }
+    out.push_back(static_cast<wchar_t>(cp >= 0 ? cp : kUtf8Replacement));
+    pos += len;
+  }
+  return out;
+}
+
+// Code points above U+10FFFF are written as U+FFFD.
+inline void AppendUtf8(uint32_t cp, string* out) {
+  if (cp > 0x10FFFF) cp = kUtf8Replacement;
+  if (cp < 0x80) {
+    out->push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+#endif  // PADDLENLP_UTF8_H_
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PADDLENLP_VOCAB_REGISTRY_H_
+#define PADDLENLP_VOCAB_REGISTRY_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "paddlenlp/tokenizer.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::weak_ptr;
+
+
+// Process-wide cache of the loaded vocabs. Every tokenizer built over the same
+// vocab file gets the same immutable Vocab and InvVocab objects instead of
+// loading its own copy. Entries are keyed by the file path plus a hash of the
+// file content, so a vocab file rewritten in place is loaded again. The
+// registry only holds weak references: a vocab is freed once the last
+// tokenizer using it is destroyed.
+class VocabRegistry {
+ public:
+  struct Stats {
+    size_t num_vocabs{0};  // live vocabs
+    size_t num_tokens{0};  // tokens of the live vocabs
+    size_t vocab_bytes{0};  // estimated heap size of the live vocabs
+    size_t inv_vocab_bytes{0};  // estimated heap size of the live inv vocabs
+    size_t char_ids_bytes{0};  // estimated heap size of the live char ids
+    size_t num_loads{0};  // vocab files parsed so far
+    size_t num_hits{0};  // requests served without parsing
+  };
+
+  static VocabRegistry& Instance();
+
+  // Returns the vocab of vocab_file, parsing the file only if no tokenizer
+  // holds a vocab with the same path and content. Throws runtime_error if
+  // the file can not be read.
+  shared_ptr<const Vocab> GetVocab(const string& vocab_file);
+  // Returns the inverse of a vocab returned by GetVocab, building it on
+  // the first request. Vocabs from elsewhere get a private InvVocab.
+  shared_ptr<const InvVocab> GetInvVocab(const shared_ptr<const Vocab>& vocab);
+  // Same as GetInvVocab for the single character id table.
+  shared_ptr<const CharIdTable> GetCharIdTable(
+    const shared_ptr<const Vocab>& vocab);
+  Stats GetStats() const;
+
+  static size_t EstimateMemoryUsage(const Vocab& vocab);
+  static size_t EstimateMemoryUsage(const InvVocab& inv_vocab);
+
+ private:
+  VocabRegistry() = default;
+  VocabRegistry(const VocabRegistry&) = delete;
+  VocabRegistry& operator=(const VocabRegistry&) = delete;
+
+  struct Entry {
+    weak_ptr<const Vocab> vocab;
+    weak_ptr<const InvVocab> inv_vocab;
+    weak_ptr<const CharIdTable> char_ids;
+    size_t num_tokens{0};
+    size_t vocab_bytes{0};
+    size_t inv_vocab_bytes{0};
+    size_t char_ids_bytes{0};
+  };
+
+  // Drops the entries whose vocab has been freed. Requires mutex_.
+  void prune_entries();
+  // The entry holding vocab, or nullptr. Requires mutex_.
+  Entry* find_entry(const shared_ptr<const Vocab>& vocab);
+
+  mutable std::mutex mutex_;
+  // The key is the vocab file path followed by the content hash.
+  unordered_map<string, Entry> entries_;
+  size_t num_loads_{0};
+  size_t num_hits_{0};
+};
+
+#endif  // PADDLENLP_VOCAB_REGISTRY_H_
@@ -0,0 +1,168 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/aho_corasick.h"
+
+
+using std::map;
+using std::queue;
+using std::size_t;
+using std::string;
+using std::vector;
+
+
+// FindAll keeps its ring on the stack up to this size.
+const size_t kStackRingSize = 64;
+
+
+AhoCorasick::AhoCorasick() : root_next_(256, 0) {}
+
+void AhoCorasick::Build(const vector<string>& patterns) {
+  // Build the plain trie first.
+  vector<map<uint8_t, int>> children(1);
+  vector<int> pattern(1, -1);
+  vector<size_t> depth(1, 0);
+  num_patterns_ = 0;
+  max_pattern_size_ = 0;
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    const string& p = patterns[i];
+    if (p.empty()) continue;
+    int node = 0;
+    for (const char& c : p) {
+      uint8_t byte = static_cast<uint8_t>(c);
+      auto iter = children[node].find(byte);
+      if (iter != children[node].end()) {
+        node = iter->second;
+        continue;
+      }
+      int child = static_cast<int>(children.size());
+      children[node][byte] = child;
+      children.emplace_back();
+      pattern.push_back(-1);
+      depth.push_back(depth[node] + 1);
+      node = child;
+    }
+    // Keep the first id for duplicated patterns.
+    if (pattern[node] < 0) pattern[node] = static_cast<int>(i);
+    num_patterns_++;
+    max_pattern_size_ = std::max(max_pattern_size_, p.size());
+  }
+
+  // Flatten the trie into CSR form.
+  size_t num_nodes = children.size();
+  edge_begin_.assign(num_nodes + 1, 0);
+  edge_labels_.clear();
+  edge_targets_.clear();
+  for (size_t i = 0; i < num_nodes; ++i) {
+    edge_begin_[i] = static_cast<int>(edge_labels_.size());
+    for (auto& edge : children[i]) {
+      edge_labels_.push_back(edge.first);
+      edge_targets_.push_back(edge.second);
+    }
+  }
+  edge_begin_[num_nodes] = static_cast<int>(edge_labels_.size());
+  pattern_.swap(pattern);
+  depth_.swap(depth);
+  ring_size_ = 1;
+  while (ring_size_ <= max_pattern_size_) ring_size_ <<= 1;
+
+  // Compute the fail and dictionary links in BFS order.
+  root_next_.assign(256, 0);
+  fail_.assign(num_nodes, 0);
+  dict_link_.assign(num_nodes, 0);
+  queue<int> nodes;
+  for (auto& edge : children[0]) {
+    root_next_[edge.first] = edge.second;
+    nodes.push(edge.second);
+  }
+  while (!nodes.empty()) {
+    int node = nodes.front();
+    nodes.pop();
+    for (auto& edge : children[node]) {
+      int child = edge.second;
+      int fail = next_state(fail_[node], edge.first);
+      fail_[child] = fail;
+      dict_link_[child] = pattern_[fail] >= 0 ? fail : dict_link_[fail];
+      nodes.push(child);
+    }
+  }
+}
+
+int AhoCorasick::next_state(int state, uint8_t byte) const {
+  while (state != 0) {
+    auto first = edge_labels_.begin() + edge_begin_[state];
+    auto last = edge_labels_.begin() + edge_begin_[state + 1];
+    auto iter = std::lower_bound(first, last, byte);
+    if (iter != last && *iter == byte) {
+      return edge_targets_[iter - edge_labels_.begin()];
+    }
+    state = fail_[state];
+  }
+  return root_next_[byte];
+}
+
+void AhoCorasick::FindAll(const string& text, vector<Match>* matches) const {
+  FindAll(text.data(), text.size(), matches);
+}
+
+void AhoCorasick::FindAll(const char* text,
+                          size_t size,
+                          vector<Match>* matches) const {
+  matches->clear();
+  if (num_patterns_ == 0) return;
+  // The matches come out ordered by end; ring[begin & mask] holds the
+  // longest one seen so far of every start begin >= resolved. Once the
+  // automaton is in a state of depth d at position end, no later match
+  // starts before end - d, so the starts before it are final and are
+  // resolved in order: the longest match of a start is kept unless it
+  // overlaps the previous match kept.
+  Match stack_ring[kStackRingSize];
+  vector<Match> heap_ring;
+  Match* ring = stack_ring;
+  if (ring_size_ > kStackRingSize) {
+    heap_ring.resize(ring_size_);
+    ring = heap_ring.data();
+  }
+  const size_t mask = ring_size_ - 1;
+  for (size_t k = 0; k < ring_size_; ++k) ring[k].end = 0;
+  size_t resolved = 0;
+  // The end of the last match kept; the next one starts at or after it.
+  size_t pos = 0;
+  auto resolve = [&](size_t limit) {
+    for (; resolved < limit; ++resolved) {
+      Match& longest = ring[resolved & mask];
+      if (longest.end != 0 && resolved >= pos) {
+        matches->push_back(longest);
+        pos = longest.end;
+      }
+      longest.end = 0;
+    }
+  };
+  int state = 0;
+  for (size_t i = 0; i < size; ++i) {
+    state = next_state(state, static_cast<uint8_t>(text[i]));
+    const size_t end = i + 1;
+    int node = pattern_[state] >= 0 ? state : dict_link_[state];
+    for (; node != 0; node = dict_link_[node]) {
+      const size_t begin = end - depth_[node];
+      if (begin < pos) continue;
+      ring[begin & mask] = {begin, end, static_cast<size_t>(pattern_[node])};
+    }
+    resolve(end - depth_[state]);
+  }
+  resolve(size);
+}
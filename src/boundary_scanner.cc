@@ -0,0 +1,270 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "paddlenlp/boundary_scanner.h"
+
+
+namespace {
+
+enum ByteClass : uint8_t {
+  kWhiteSpaceByte = 1,
+  kPunctuationByte = 2,
+  kControlByte = 4,
+  kCjkLeadByte = 8,
+  kNonAsciiByte = 16,
+  kUpperByte = 32,
+  kIdeographLeadByte = 64,
+  kContinuationByte = 128,
+};
+
+struct ByteClassTable {
+  uint8_t classes[256];
+
+  ByteClassTable() {
+    for (int c = 0; c < 256; ++c) {
+      uint8_t cls = 0;
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        cls = kWhiteSpaceByte;
+      } else if (c < 0x20 || c == 0x7F) {
+        cls = kControlByte;
+      } else if ((c >= 33 && c <= 47) || (c >= 58 && c <= 64) ||
+                 (c >= 91 && c <= 96) || (c >= 123 && c <= 126)) {
+        cls = kPunctuationByte;
+      } else if (c >= 0x80) {
+        cls = kNonAsciiByte;
+        if (c >= 0xE3 && c <= 0xE9) cls |= kCjkLeadByte;
+        if (c >= 0xE4 && c <= 0xE9) cls |= kIdeographLeadByte;
+        if (c <= 0xBF) cls |= kContinuationByte;
+      } else if (c >= 'A' && c <= 'Z') {
+        cls = kUpperByte;
+      }
+      classes[c] = cls;
+    }
+  }
+};
+
+const ByteClassTable kByteClassTable;
+
+#if defined(__AVX2__)
+
+inline __m256i InRange(__m256i v, int lo, int hi) {
+  // Signed compares: the non-ASCII bytes are negative.
+  return _mm256_and_si256(
+    _mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+    _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+inline uint64_t ToMask(__m256i v) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+}
+
+// Classifies 64 bytes.
+void ClassifyBlock(const char* data, ByteClassMasks* masks) {
+  for (int k = 0; k < 2; ++k) {
+    __m256i v = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(data + 32 * k));
+    __m256i ws = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    __m256i control = _mm256_or_si256(
+      _mm256_andnot_si256(ws, InRange(v, 0, 0x1F)),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+    __m256i punct = _mm256_or_si256(
+      _mm256_or_si256(InRange(v, 33, 47), InRange(v, 58, 64)),
+      _mm256_or_si256(InRange(v, 91, 96), InRange(v, 123, 126)));
+    // 0xE3..0xE9 as signed bytes.
+    __m256i cjk_lead = InRange(v, -29, -23);
+    const int shift = 32 * k;
+    masks->whitespace |= ToMask(ws) << shift;
+    masks->control |= ToMask(control) << shift;
+    masks->punctuation |= ToMask(punct) << shift;
+    masks->cjk_lead |= ToMask(cjk_lead) << shift;
+    masks->non_ascii |= ToMask(v) << shift;
+  }
+}
+
+// Classifies 64 bytes.
+void ClassifyNormalizedBlock(const char* data, NormalizedClassMasks* masks) {
+  for (int k = 0; k < 2; ++k) {
+    __m256i v = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(data + 32 * k));
+    __m256i ws = _mm256_or_si256(
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    __m256i control = _mm256_or_si256(
+      _mm256_andnot_si256(ws, InRange(v, 0, 0x1F)),
+      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+    // 0xE4..0xE9 and 0x80..0xBF as signed bytes.
+    __m256i ideograph_lead = InRange(v, -28, -23);
+    __m256i continuation = _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v);
+    const int shift = 32 * k;
+    masks->control |= ToMask(control) << shift;
+    masks->upper |= ToMask(InRange(v, 'A', 'Z')) << shift;
+    masks->non_ascii |= ToMask(v) << shift;
+    masks->ideograph_lead |= ToMask(ideograph_lead) << shift;
+    masks->continuation |= ToMask(continuation) << shift;
+  }
+}
+
+#elif defined(__SSE2__)
+
+inline __m128i InRange(__m128i v, int lo, int hi) {
+  // Signed compares: the non-ASCII bytes are negative.
+  return _mm_and_si128(
+    _mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+    _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+inline uint64_t ToMask(__m128i v) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(v));
+}
+
+// Classifies 64 bytes.
+void ClassifyBlock(const char* data, ByteClassMasks* masks) {
+  for (int k = 0; k < 4; ++k) {
+    __m128i v = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(data + 16 * k));
+    __m128i ws = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    __m128i control = _mm_or_si128(
+      _mm_andnot_si128(ws, InRange(v, 0, 0x1F)),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    __m128i punct = _mm_or_si128(
+      _mm_or_si128(InRange(v, 33, 47), InRange(v, 58, 64)),
+      _mm_or_si128(InRange(v, 91, 96), InRange(v, 123, 126)));
+    // 0xE3..0xE9 as signed bytes.
+    __m128i cjk_lead = InRange(v, -29, -23);
+    const int shift = 16 * k;
+    masks->whitespace |= ToMask(ws) << shift;
+    masks->control |= ToMask(control) << shift;
+    masks->punctuation |= ToMask(punct) << shift;
+    masks->cjk_lead |= ToMask(cjk_lead) << shift;
+    masks->non_ascii |= ToMask(v) << shift;
+  }
+}
+
+// Classifies 64 bytes.
+void ClassifyNormalizedBlock(const char* data, NormalizedClassMasks* masks) {
+  for (int k = 0; k < 4; ++k) {
+    __m128i v = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(data + 16 * k));
+    __m128i ws = _mm_or_si128(
+      _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    __m128i control = _mm_or_si128(
+      _mm_andnot_si128(ws, InRange(v, 0, 0x1F)),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    // 0xE4..0xE9 and 0x80..0xBF as signed bytes.
+    __m128i ideograph_lead = InRange(v, -28, -23);
+    __m128i continuation = _mm_cmplt_epi8(v, _mm_set1_epi8(-64));
+    const int shift = 16 * k;
+    masks->control |= ToMask(control) << shift;
+    masks->upper |= ToMask(InRange(v, 'A', 'Z')) << shift;
+    masks->non_ascii |= ToMask(v) << shift;
+    masks->ideograph_lead |= ToMask(ideograph_lead) << shift;
+    masks->continuation |= ToMask(continuation) << shift;
+  }
+}
+
+#endif
+
+}  // namespace
+
+
+void ClassifyBytesScalar(const char* data, size_t n, ByteClassMasks* masks) {
+  memset(masks, 0, sizeof(*masks));
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t cls = kByteClassTable.classes[static_cast<uint8_t>(data[i])];
+    const uint64_t bit = 1ULL << i;
+    if (cls & kWhiteSpaceByte) masks->whitespace |= bit;
+    if (cls & kPunctuationByte) masks->punctuation |= bit;
+    if (cls & kControlByte) masks->control |= bit;
+    if (cls & kCjkLeadByte) masks->cjk_lead |= bit;
+    if (cls & kNonAsciiByte) masks->non_ascii |= bit;
+  }
+}
+
+void ClassifyBytes(const char* data, size_t n, ByteClassMasks* masks) {
+#if defined(__AVX2__) || defined(__SSE2__)
+  memset(masks, 0, sizeof(*masks));
+  if (n == kScanBlockSize) {
+    ClassifyBlock(data, masks);
+    return;
+  }
+  // Classify a zero padded copy of a partial block and drop the bits of the
+  // padding (zero bytes are control bytes).
+  alignas(64) char block[kScanBlockSize] = {0};
+  memcpy(block, data, n);
+  ClassifyBlock(block, masks);
+  const uint64_t valid = (1ULL << n) - 1;
+  masks->whitespace &= valid;
+  masks->punctuation &= valid;
+  masks->control &= valid;
+  masks->cjk_lead &= valid;
+  masks->non_ascii &= valid;
+#else
+  ClassifyBytesScalar(data, n, masks);
+#endif
+}
+
+void ClassifyNormalizedBytesScalar(const char* data,
+                                   size_t n,
+                                   NormalizedClassMasks* masks) {
+  memset(masks, 0, sizeof(*masks));
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t cls = kByteClassTable.classes[static_cast<uint8_t>(data[i])];
+    const uint64_t bit = 1ULL << i;
+    if (cls & kControlByte) masks->control |= bit;
+    if (cls & kUpperByte) masks->upper |= bit;
+    if (cls & kNonAsciiByte) masks->non_ascii |= bit;
+    if (cls & kIdeographLeadByte) masks->ideograph_lead |= bit;
+    if (cls & kContinuationByte) masks->continuation |= bit;
+  }
+}
+
+void ClassifyNormalizedBytes(const char* data,
+                             size_t n,
+                             NormalizedClassMasks* masks) {
+#if defined(__AVX2__) || defined(__SSE2__)
+  memset(masks, 0, sizeof(*masks));
+  if (n == kScanBlockSize) {
+    ClassifyNormalizedBlock(data, masks);
+    return;
+  }
+  alignas(64) char block[kScanBlockSize] = {0};
+  memcpy(block, data, n);
+  ClassifyNormalizedBlock(block, masks);
+  const uint64_t valid = (1ULL << n) - 1;
+  masks->control &= valid;
+  masks->upper &= valid;
+  masks->non_ascii &= valid;
+  masks->ideograph_lead &= valid;
+  masks->continuation &= valid;
+#else
+  ClassifyNormalizedBytesScalar(data, n, masks);
+#endif
+}
@@ -0,0 +1,648 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <utf8proc.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddlenlp/bpe_tokenizer.h"
+#include "paddlenlp/utf8.h"
+
+
+using std::ifstream;
+using std::lock_guard;
+using std::mutex;
+using std::ostringstream;
+using std::pair;
+using std::priority_queue;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+
+namespace {
+
+enum CharClass : uint8_t {
+  kOtherChar,
+  kSpaceChar,
+  kLetterChar,
+  kNumberChar,
+};
+
+// \s of the pre-tokenization pattern: the White_Space property.
+bool IsPatternSpace(int32_t cp) {
+  return (cp >= 0x09 && cp <= 0x0D) || cp == 0x20 || cp == 0x85 ||
+         cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+         cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F ||
+         cp == 0x3000;
+}
+
+CharClass Classify(int32_t cp) {
+  if (cp < 0x80) {
+    if ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z')) {
+      return kLetterChar;
+    }
+    if (cp >= '0' && cp <= '9') return kNumberChar;
+    return IsPatternSpace(cp) ? kSpaceChar : kOtherChar;
+  }
+  if (IsPatternSpace(cp)) return kSpaceChar;
+  switch (utf8proc_category(cp)) {
+    case UTF8PROC_CATEGORY_LU:
+    case UTF8PROC_CATEGORY_LL:
+    case UTF8PROC_CATEGORY_LT:
+    case UTF8PROC_CATEGORY_LM:
+    case UTF8PROC_CATEGORY_LO:
+      return kLetterChar;
+    case UTF8PROC_CATEGORY_ND:
+    case UTF8PROC_CATEGORY_NL:
+    case UTF8PROC_CATEGORY_NO:
+      return kNumberChar;
+    default:
+      return kOtherChar;
+  }
+}
+
+// Splits text into the byte ranges matched by
+//   's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+// The alternatives are tried in order at every position, as a regex engine
+// does.
+void SplitPieces(const string& text, vector<pair<size_t, size_t>>* pieces) {
+  vector<int32_t> chars;
+  vector<uint8_t> classes;
+  vector<size_t> offsets;
+  chars.reserve(text.size());
+  classes.reserve(text.size());
+  offsets.reserve(text.size() + 1);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t len = 0;
+    int32_t cp = DecodeUtf8(text.data() + pos, text.size() - pos, &len);
+    if (cp < 0) {
+      if (cp == kUtf8Incomplete) len = text.size() - pos;
+      cp = kUtf8Replacement;
+    }
+    chars.push_back(cp);
+    classes.push_back(Classify(cp));
+    offsets.push_back(pos);
+    pos += len;
+  }
+  offsets.push_back(pos);
+
+  const size_t n = chars.size();
+  size_t i = 0;
+  while (i < n) {
+    size_t j = i + 1;
+    if (chars[i] == '\'' && i + 1 < n &&
+        (chars[i + 1] == 's' || chars[i + 1] == 't' || chars[i + 1] == 'm' ||
+         chars[i + 1] == 'd')) {
+      j = i + 2;
+    } else if (chars[i] == '\'' && i + 2 < n &&
+               ((chars[i + 1] == 'r' && chars[i + 2] == 'e') ||
+                (chars[i + 1] == 'v' && chars[i + 2] == 'e') ||
+                (chars[i + 1] == 'l' && chars[i + 2] == 'l'))) {
+      j = i + 3;
+    } else {
+      // The optional space of the letter, number and other alternatives.
+      size_t k = i;
+      if (chars[i] == ' ' && i + 1 < n && classes[i + 1] != kSpaceChar) k++;
+      if (classes[k] != kSpaceChar) {
+        j = k + 1;
+        while (j < n && classes[j] == classes[k]) j++;
+      } else {
+        j = i;
+        while (j < n && classes[j] == kSpaceChar) j++;
+        // \s+(?!\S) leaves the last space to the next piece, \s+ takes a
+        // single space.
+        if (j < n && j - i >= 2) j--;
+      }
+    }
+    pieces->emplace_back(offsets[i], offsets[j]);
+    i = j;
+  }
+}
+
+// The printable characters GPT-2 uses for the 256 byte values: the
+// printable Latin-1 characters stand for themselves, the other bytes are
+// mapped to U+0100 and up.
+vector<uint32_t> ByteToUnicode() {
+  vector<uint32_t> table(256, 0);
+  uint32_t next = 256;
+  for (uint32_t b = 0; b < 256; ++b) {
+    const bool printable = (b >= '!' && b <= '~') || (b >= 0xA1 && b <= 0xAC) ||
+                           (b >= 0xAE && b <= 0xFF);
+    table[b] = printable ? b : next++;
+  }
+  return table;
+}
+
+string ReadFile(const string& file) {
+  ifstream ifs(file, ifstream::in | ifstream::binary);
+  if (!ifs) {
+    throw runtime_error(
+      "Open the file failly, please check the file " + file + ".");
+  }
+  ostringstream content;
+  content << ifs.rdbuf();
+  return content.str();
+}
+
+// A reader for the flat JSON object of vocab.json.
+class JsonReader {
+ public:
+  JsonReader(const string& text, const string& file) :
+    text_(text), file_(file) {}
+
+  void SkipSpaces() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' ||
+            text_[pos_] == '\n' || text_[pos_] == '\r')) {
+      pos_++;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipSpaces();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  void Expect(char c) {
+    if (!Consume(c)) Fail(string("expected '") + c + "'");
+  }
+
+  string ReadString() {
+    Expect('"');
+    string out;
+    while (true) {
+      if (pos_ >= text_.size()) Fail("unterminated string");
+      const char c = text_[pos_++];
+      if (c == '"') return out;
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+      if (pos_ >= text_.size()) Fail("unterminated string");
+      const char e = text_[pos_++];
+      switch (e) {
+        case '"': out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case '/': out.push_back('/'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+          uint32_t cp = ReadHex4();
+          if (cp >= 0xD800 && cp <= 0xDBFF && pos_ + 1 < text_.size() &&
+              text_[pos_] == '\\' && text_[pos_ + 1] == 'u') {
+            pos_ += 2;
+            const uint32_t low = ReadHex4();
+            if (low < 0xDC00 || low > 0xDFFF) Fail("invalid surrogate pair");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          }
+          AppendUtf8(cp, &out);
+          break;
+        }
+        default:
+          Fail("invalid escape");
+      }
+    }
+  }
+
+  uint64_t ReadUnsigned() {
+    SkipSpaces();
+    const size_t begin = pos_;
+    uint64_t value = 0;
+    while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') {
+      value = value * 10 + (text_[pos_] - '0');
+      pos_++;
+    }
+    if (pos_ == begin) Fail("expected a non-negative integer");
+    return value;
+  }
+
+  bool AtEnd() {
+    SkipSpaces();
+    return pos_ == text_.size();
+  }
+
+  [[noreturn]] void Fail(const string& message) const {
+    throw runtime_error("Invalid json file " + file_ + " at byte " +
+                        std::to_string(pos_) + ": " + message + ".");
+  }
+
+ private:
+  uint32_t ReadHex4() {
+    if (pos_ + 4 > text_.size()) Fail("invalid \\u escape");
+    uint32_t value = 0;
+    for (int k = 0; k < 4; ++k) {
+      const char c = text_[pos_++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        Fail("invalid \\u escape");
+      }
+    }
+    return value;
+  }
+
+  const string& text_;
+  const string& file_;
+  size_t pos_{0};
+};
+
+const size_t kCacheShards = 16;
+
+}  // namespace
+
+
+class BPETokenizer::PieceCache {
+ public:
+  explicit PieceCache(size_t capacity) :
+    shards_(std::min(capacity, kCacheShards)) {
+    const size_t shard_capacity =
+      (capacity + shards_.size() - 1) / shards_.size();
+    for (auto& shard : shards_) shard.capacity = shard_capacity;
+  }
+
+  // Appends the cached ids of piece. Returns false on a miss.
+  bool Find(const string& piece, vector<size_t>* ids) {
+    Shard& shard = shards_[std::hash<string>()(piece) % shards_.size()];
+    lock_guard<mutex> lock(shard.mu);
+    auto iter = shard.index.find(piece);
+    if (iter == shard.index.end()) return false;
+    Slot& slot = shard.slots[iter->second];
+    slot.referenced = true;
+    ids->insert(ids->end(), slot.ids.begin(), slot.ids.end());
+    return true;
+  }
+
+  void Insert(const string& piece, vector<size_t>&& ids) {
+    Shard& shard = shards_[std::hash<string>()(piece) % shards_.size()];
+    lock_guard<mutex> lock(shard.mu);
+    // Another thread may have merged the same piece meanwhile.
+    if (shard.index.count(piece)) return;
+    size_t victim = shard.slots.size();
+    if (victim < shard.capacity) {
+      shard.slots.emplace_back();
+    } else {
+      while (shard.slots[shard.hand].referenced) {
+        shard.slots[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.capacity;
+      }
+      victim = shard.hand;
+      shard.hand = (shard.hand + 1) % shard.capacity;
+      shard.index.erase(shard.slots[victim].piece);
+    }
+    Slot& slot = shard.slots[victim];
+    slot.piece = piece;
+    slot.ids = std::move(ids);
+    slot.referenced = false;
+    shard.index[piece] = victim;
+  }
+
+ private:
+  struct Slot {
+    string piece;
+    vector<size_t> ids;
+    bool referenced{false};
+  };
+
+  struct Shard {
+    mutex mu;
+    size_t capacity{0};
+    // The position of the clock hand in slots.
+    size_t hand{0};
+    vector<Slot> slots;
+    unordered_map<string, size_t> index;
+  };
+
+  vector<Shard> shards_;
+};
+
+
+BPETokenizer::BPETokenizer(
+  const string& vocab_file,
+  const string& merges_file,
+  bool byte_level /* = true */,
+  bool add_prefix_space /* = false */,
+  const string& unk_token /* = "" */,
+  size_t cache_capacity /* = 10000 */) :
+  byte_level_(byte_level),
+  add_prefix_space_(add_prefix_space),
+  unk_token_(unk_token),
+  basic_tokenizer_(false),
+  cache_(cache_capacity > 0 ? new PieceCache(cache_capacity) : nullptr) {
+    load_vocab(vocab_file);
+    load_merges(merges_file);
+    if (!unk_token_.empty()) {
+      auto iter = vocab_.find(unk_token_);
+      if (iter == vocab_.end()) {
+        throw runtime_error("The unk token " + unk_token_ +
+                            " is not in the vocab " + vocab_file + ".");
+      }
+      unk_token_id_ = iter->second;
+      has_unk_token_ = true;
+    }
+    const vector<uint32_t>& byte_to_unicode = ByteToUnicode();
+    byte_symbols_.assign(256, kUnknownSymbol);
+    for (size_t b = 0; b < 256; ++b) {
+      string symbol;
+      AppendUtf8(byte_to_unicode[b], &symbol);
+      auto iter = vocab_.find(symbol);
+      if (iter != vocab_.end()) {
+        byte_symbols_[b] = static_cast<uint32_t>(iter->second);
+      }
+    }
+  }
+
+BPETokenizer::~BPETokenizer() {}
+
+void BPETokenizer::load_vocab(const string& vocab_file) {
+  const string& content = ReadFile(vocab_file);
+  JsonReader reader(content, vocab_file);
+  reader.Expect('{');
+  if (!reader.Consume('}')) {
+    do {
+      string token = reader.ReadString();
+      reader.Expect(':');
+      const uint64_t id = reader.ReadUnsigned();
+      if (id >= kUnknownSymbol) reader.Fail("token id out of range");
+      inv_vocab_[id] = token;
+      vocab_[std::move(token)] = id;
+    } while (reader.Consume(','));
+    reader.Expect('}');
+  }
+  if (!reader.AtEnd()) reader.Fail("trailing data");
+}
+
+void BPETokenizer::load_merges(const string& merges_file) {
+  ifstream ifs(merges_file, ifstream::in | ifstream::binary);
+  if (!ifs) {
+    throw runtime_error(
+      "Open the merges file failly, please check the file " +
+      merges_file + ".");
+  }
+  string line;
+  uint32_t rank = 0;
+  size_t line_number = 0;
+  while (getline(ifs, line)) {
+    line_number++;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line.compare(0, 8, "#version") == 0) continue;
+    const size_t space = line.find(' ');
+    if (space == string::npos || space == 0 ||
+        line.find(' ', space + 1) != string::npos) {
+      throw runtime_error("Invalid merge at line " +
+                          std::to_string(line_number) + " of " +
+                          merges_file + ".");
+    }
+    const string left = line.substr(0, space);
+    const string right = line.substr(space + 1);
+    auto left_iter = vocab_.find(left);
+    auto right_iter = vocab_.find(right);
+    auto merged_iter = vocab_.find(left + right);
+    if (left_iter == vocab_.end() || right_iter == vocab_.end() ||
+        merged_iter == vocab_.end()) {
+      throw runtime_error("The merge at line " + std::to_string(line_number) +
+                          " of " + merges_file + " is not in the vocab.");
+    }
+    const uint64_t key = (static_cast<uint64_t>(left_iter->second) << 32) |
+                         right_iter->second;
+    // Same as the reference implementations, a repeated merge gets the
+    // rank of its last occurrence.
+    merges_[key] = {rank, static_cast<uint32_t>(merged_iter->second)};
+    rank++;
+  }
+}
+
+const BPETokenizer::MergeRule* BPETokenizer::find_merge(
+  uint32_t left, uint32_t right) const {
+    auto iter = merges_.find((static_cast<uint64_t>(left) << 32) | right);
+    return iter != merges_.end() ? &iter->second : nullptr;
+  }
+
+void BPETokenizer::merge_symbols(vector<uint32_t>* symbols) const {
+  // The symbols form a linked list; a heap holds the mergeable adjacent
+  // pairs by rank, then by position. A merge only changes the pairs around
+  // it, so a word of n symbols takes O(n log n). Entries of the heap made
+  // stale by a merge are skipped when popped.
+  const int n = static_cast<int>(symbols->size());
+  if (n < 2) return;
+  struct Candidate {
+    uint32_t rank;
+    int pos;
+    bool operator>(const Candidate& other) const {
+      return rank != other.rank ? rank > other.rank : pos > other.pos;
+    }
+  };
+  vector<uint32_t>& s = *symbols;
+  vector<int> prev(n);
+  vector<int> next(n);
+  vector<uint8_t> removed(n, 0);
+  priority_queue<Candidate, vector<Candidate>, std::greater<Candidate>> heap;
+  for (int i = 0; i < n; ++i) {
+    prev[i] = i - 1;
+    next[i] = i + 1 < n ? i + 1 : -1;
+    if (i + 1 < n) {
+      const MergeRule* rule = find_merge(s[i], s[i + 1]);
+      if (rule) heap.push({rule->rank, i});
+    }
+  }
+  while (!heap.empty()) {
+    const Candidate top = heap.top();
+    heap.pop();
+    const int p = top.pos;
+    if (removed[p] || next[p] < 0) continue;
+    const int q = next[p];
+    const MergeRule* rule = find_merge(s[p], s[q]);
+    if (!rule || rule->rank != top.rank) continue;
+
+    s[p] = rule->merged_id;
+    removed[q] = 1;
+    next[p] = next[q];
+    if (next[q] >= 0) prev[next[q]] = p;
+    if (prev[p] >= 0) {
+      const MergeRule* left = find_merge(s[prev[p]], s[p]);
+      if (left) heap.push({left->rank, prev[p]});
+    }
+    if (next[p] >= 0) {
+      const MergeRule* right = find_merge(s[p], s[next[p]]);
+      if (right) heap.push({right->rank, p});
+    }
+  }
+  size_t k = 0;
+  for (int i = 0; i >= 0; i = next[i]) s[k++] = s[i];
+  s.resize(k);
+}
+
+void BPETokenizer::merge_piece(const string& piece, vector<size_t>* ids) const {
+  if (cache_ && cache_->Find(piece, ids)) return;
+
+  vector<uint32_t> symbols;
+  if (byte_level_) {
+    symbols.reserve(piece.size());
+    for (const char& c : piece) {
+      symbols.push_back(byte_symbols_[static_cast<uint8_t>(c)]);
+    }
+  } else {
+    size_t pos = 0;
+    while (pos < piece.size()) {
+      size_t len = 0;
+      DecodeUtf8(piece.data() + pos, piece.size() - pos, &len);
+      auto iter = vocab_.find(piece.substr(pos, len));
+      symbols.push_back(iter != vocab_.end() ?
+                        static_cast<uint32_t>(iter->second) : kUnknownSymbol);
+      pos += len;
+    }
+  }
+  merge_symbols(&symbols);
+
+  vector<size_t> piece_ids;
+  piece_ids.reserve(symbols.size());
+  for (auto& symbol : symbols) {
+    if (symbol != kUnknownSymbol) {
+      piece_ids.push_back(symbol);
+    } else if (has_unk_token_) {
+      piece_ids.push_back(unk_token_id_);
+    }
+  }
+  ids->insert(ids->end(), piece_ids.begin(), piece_ids.end());
+  if (cache_) cache_->Insert(piece, std::move(piece_ids));
+}
+
+vector<string> BPETokenizer::PreTokenize(const string& text) {
+  vector<pair<size_t, size_t>> pieces;
+  SplitPieces(text, &pieces);
+  vector<string> out;
+  out.reserve(pieces.size());
+  for (auto& piece : pieces) {
+    out.push_back(text.substr(piece.first, piece.second - piece.first));
+  }
+  return out;
+}
+
+class BPETokenizer::PieceMerger : public WordVisitor {
+ public:
+  PieceMerger(const BPETokenizer* tokenizer, vector<size_t>* ids) :
+    tokenizer_(tokenizer), ids_(ids) {}
+
+  bool OnWord(const wstring& word, size_t /*begin*/, size_t /*end*/) override {
+    piece_.clear();
+    for (const wchar_t& ch : word) AppendUtf8(ch, &piece_);
+    tokenizer_->merge_piece(piece_, ids_);
+    return true;
+  }
+
+ private:
+  const BPETokenizer* tokenizer_;
+  vector<size_t>* ids_;
+  string piece_;
+};
+
+vector<size_t> BPETokenizer::TokenizeToIds(const string& text) const {
+  if (!byte_level_) {
+    vector<size_t> ids;
+    PieceMerger merger(this, &ids);
+    basic_tokenizer_.Tokenize(text, &merger);
+    return ids;
+  }
+
+  string prefixed;
+  const string* input = &text;
+  if (add_prefix_space_ && !text.empty() && text[0] != ' ') {
+    prefixed = " " + text;
+    input = &prefixed;
+  }
+  vector<pair<size_t, size_t>> pieces;
+  SplitPieces(*input, &pieces);
+  vector<size_t> ids;
+  ids.reserve(input->size() / 3);
+  for (auto& piece : pieces) {
+    merge_piece(input->substr(piece.first, piece.second - piece.first),
+                &ids);
+  }
+  return ids;
+}
+
+vector<string> BPETokenizer::Tokenize(const string& text) const {
+  return ConvertIdsToTokens(TokenizeToIds(text));
+}
+
+vector<size_t> BPETokenizer::ConvertTokensToIds(
+  const vector<string>& tokens) const {
+    vector<size_t> ids(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      auto iter = vocab_.find(tokens[i]);
+      ids[i] = iter != vocab_.end() ? iter->second : unk_token_id_;
+    }
+    return ids;
+  }
+
+vector<string> BPETokenizer::ConvertIdsToTokens(
+  const vector<size_t>& token_ids) const {
+    vector<string> tokens(token_ids.size());
+    for (size_t i = 0; i < token_ids.size(); ++i) {
+      auto iter = inv_vocab_.find(token_ids[i]);
+      tokens[i] = iter != inv_vocab_.end() ? iter->second : unk_token_;
+    }
+    return tokens;
+  }
+
+string BPETokenizer::Decode(const vector<size_t>& token_ids) const {
+  string text;
+  for (auto& token : ConvertIdsToTokens(token_ids)) text += token;
+  if (!byte_level_) return text;
+
+  // unicode_to_byte[c]: the byte standing for character c, or -1.
+  static const vector<int> unicode_to_byte = [] {
+    const vector<uint32_t>& byte_to_unicode = ByteToUnicode();
+    vector<int> table(0x144, -1);
+    for (int b = 0; b < 256; ++b) table[byte_to_unicode[b]] = b;
+    return table;
+  }();
+  string bytes;
+  bytes.reserve(text.size());
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t len = 1;
+    const int32_t cp = DecodeUtf8(text.data() + pos, text.size() - pos, &len);
+    if (cp >= 0 && static_cast<size_t>(cp) < unicode_to_byte.size() &&
+        unicode_to_byte[cp] >= 0) {
+      bytes.push_back(static_cast<char>(unicode_to_byte[cp]));
+    } else {
+      bytes.append(text, pos, cp >= 0 ? len : 1);
+      if (cp < 0) len = 1;
+    }
+    pos += len;
+  }
+  return bytes;
+}
@@ -0,0 +1,396 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddlenlp/encode_cache.h"
+
+
+using std::list;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+using Clock = std::chrono::steady_clock;
+
+
+namespace {
+
+// The fields Encode can return, in the order of the compact entries.
+const char* const kFieldNames[] = {
+  "input_ids",
+  "token_type_ids",
+  "special_tokens_mask",
+  "seq_len",
+  "attention_mask",
+  "position_ids",
+  "overflowing_token_ids",
+  "num_truncated_tokens",
+};
+const size_t kNumFields = sizeof(kFieldNames) / sizeof(kFieldNames[0]);
+
+uint64_t Mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Approximate request counts of the recently seen keys: a count-min sketch
+// with 4 rows of counters saturating at 15. Every sample_limit increments,
+// all the counters are halved, so the counts follow the recent traffic.
+class FrequencySketch {
+ public:
+  explicit FrequencySketch(size_t capacity) {
+    size_t width = 64;
+    while (width < capacity) width <<= 1;
+    mask_ = width - 1;
+    counters_.assign(kRows * width, 0);
+    sample_limit_ = 10 * std::max<size_t>(capacity, 1);
+  }
+
+  void Increment(uint64_t hash) {
+    for (size_t row = 0; row < kRows; ++row) {
+      uint8_t& counter = counters_[index(hash, row)];
+      if (counter < kMaxCount) counter++;
+    }
+    if (++samples_ >= sample_limit_) {
+      for (auto& counter : counters_) counter >>= 1;
+      samples_ /= 2;
+    }
+  }
+
+  uint8_t Estimate(uint64_t hash) const {
+    uint8_t count = kMaxCount;
+    for (size_t row = 0; row < kRows; ++row) {
+      count = std::min(count, counters_[index(hash, row)]);
+    }
+    return count;
+  }
+
+  void Clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    samples_ = 0;
+  }
+
+ private:
+  static const size_t kRows = 4;
+  static const uint8_t kMaxCount = 15;
+
+  size_t index(uint64_t hash, size_t row) const {
+    const uint64_t h = Mix(hash + 0x9e3779b97f4a7c15ULL * (row + 1));
+    return row * (mask_ + 1) + (h & mask_);
+  }
+
+  vector<uint8_t> counters_;
+  size_t mask_;
+  size_t samples_{0};
+  size_t sample_limit_;
+};
+
+}  // namespace
+
+
+struct EncodeCache::Entry {
+  uint64_t hash;
+  string text;
+  string text_pair;
+  string truncation_strategy;
+  // max_seq_len in the high half, the flags of Encode in the low half.
+  uint64_t options;
+  // The values of field k are values[begins[k], begins[k + 1]); the field
+  // is missing from the output if its bit is not set in fields.
+  vector<uint32_t> values;
+  uint32_t begins[kNumFields + 1];
+  uint32_t fields;
+  Clock::time_point expires;
+  size_t bytes;
+
+  bool Matches(const string& other_text,
+               const string& other_text_pair,
+               uint64_t other_options,
+               const string& other_truncation_strategy) const {
+    return options == other_options && text == other_text &&
+           text_pair == other_text_pair &&
+           truncation_strategy == other_truncation_strategy;
+  }
+
+  // Stores the output in values, or returns false if it has values which
+  // do not fit.
+  bool Pack(const unordered_map<string, vector<size_t>>& output) {
+    size_t num_values = 0;
+    for (auto& field : output) num_values += field.second.size();
+    values.clear();
+    values.reserve(num_values);
+    fields = 0;
+    size_t num_found = 0;
+    for (size_t k = 0; k < kNumFields; ++k) {
+      begins[k] = static_cast<uint32_t>(values.size());
+      auto iter = output.find(kFieldNames[k]);
+      if (iter == output.end()) continue;
+      fields |= 1u << k;
+      num_found++;
+      for (auto& value : iter->second) {
+        if (value > UINT32_MAX) return false;
+        values.push_back(static_cast<uint32_t>(value));
+      }
+    }
+    begins[kNumFields] = static_cast<uint32_t>(values.size());
+    return num_found == output.size();
+  }
+
+  unordered_map<string, vector<size_t>> Unpack() const {
+    unordered_map<string, vector<size_t>> output;
+    for (size_t k = 0; k < kNumFields; ++k) {
+      if (!(fields & (1u << k))) continue;
+      output[kFieldNames[k]].assign(values.begin() + begins[k],
+                                    values.begin() + begins[k + 1]);
+    }
+    return output;
+  }
+};
+
+
+class EncodeCache::Shard {
+ public:
+  explicit Shard(size_t max_entries) : sketch(max_entries) {}
+
+  void Remove(list<Entry>::iterator iter) {
+    bytes -= iter->bytes;
+    index.erase(iter->hash);
+    entries.erase(iter);
+  }
+
+  mutex mu;
+  // The most recently used entry first.
+  list<Entry> entries;
+  unordered_map<uint64_t, list<Entry>::iterator> index;
+  FrequencySketch sketch;
+  size_t bytes{0};
+  uint64_t hits{0};
+  uint64_t misses{0};
+  uint64_t admissions{0};
+  uint64_t rejections{0};
+  uint64_t evictions{0};
+  uint64_t expirations{0};
+};
+
+
+double EncodeCache::Stats::HitRatio() const {
+  const uint64_t lookups = hits + misses;
+  return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+}
+
+EncodeCache::EncodeCache(shared_ptr<const BertTokenizer> tokenizer) :
+  EncodeCache(std::move(tokenizer), Options()) {}
+
+EncodeCache::EncodeCache(shared_ptr<const BertTokenizer> tokenizer,
+                         const Options& options) :
+  tokenizer_(std::move(tokenizer)),
+  options_(options) {
+  if (!tokenizer_) {
+    throw runtime_error("EncodeCache needs a tokenizer.");
+  }
+  if (options_.num_shards == 0 || options_.max_entries == 0) {
+    throw runtime_error(
+      "The shards and entries of an EncodeCache should be positive.");
+  }
+  const size_t num_shards = options_.num_shards;
+  shard_max_entries_ = (options_.max_entries + num_shards - 1) / num_shards;
+  shard_max_bytes_ = options_.max_bytes / num_shards;
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard(shard_max_entries_));
+  }
+}
+
+EncodeCache::~EncodeCache() = default;
+
+unordered_map<string, vector<size_t>> EncodeCache::Encode(
+  const string& text,
+  const string& text_pair /* = "" */,
+  const int max_seq_len /* = -1 */,
+  bool pad_to_max_seq_len /* = false */,
+  bool return_length /* = false */,
+  bool return_token_type_ids /* = true */,
+  bool return_position_ids /* = false */,
+  bool return_attention_mask /* = false */,
+  const string&  truncation_strategy /* = "longest_first" */,
+  bool return_overflowing_tokens /* = false */,
+  bool return_special_tokens_mask /* = false */) {
+    if (text.size() + text_pair.size() > options_.max_text_bytes) {
+      bypasses_.fetch_add(1, std::memory_order_relaxed);
+      return tokenizer_->Encode(
+        text, text_pair, max_seq_len, pad_to_max_seq_len, return_length,
+        return_token_type_ids, return_position_ids, return_attention_mask,
+        truncation_strategy, return_overflowing_tokens,
+        return_special_tokens_mask);
+    }
+
+    const uint64_t options =
+      (static_cast<uint64_t>(static_cast<uint32_t>(max_seq_len)) << 32) |
+      (pad_to_max_seq_len << 0) | (return_length << 1) |
+      (return_token_type_ids << 2) | (return_position_ids << 3) |
+      (return_attention_mask << 4) | (return_overflowing_tokens << 5) |
+      (return_special_tokens_mask << 6);
+    std::hash<string> hash_string;
+    uint64_t hash = Mix(hash_string(text));
+    hash = Mix(hash ^ hash_string(text_pair));
+    hash = Mix(hash ^ options);
+    hash = Mix(hash ^ hash_string(truncation_strategy));
+    Shard* shard = shards_[hash % shards_.size()].get();
+
+    {
+      lock_guard<mutex> lock(shard->mu);
+      shard->sketch.Increment(hash);
+      auto iter = shard->index.find(hash);
+      if (iter != shard->index.end() &&
+          iter->second->Matches(text, text_pair, options,
+                                truncation_strategy)) {
+        if (iter->second->expires <= Clock::now()) {
+          shard->Remove(iter->second);
+          shard->expirations++;
+        } else {
+          shard->entries.splice(shard->entries.begin(), shard->entries,
+                                iter->second);
+          shard->hits++;
+          return shard->entries.front().Unpack();
+        }
+      }
+      shard->misses++;
+    }
+
+    auto&& output = tokenizer_->Encode(
+      text, text_pair, max_seq_len, pad_to_max_seq_len, return_length,
+      return_token_type_ids, return_position_ids, return_attention_mask,
+      truncation_strategy, return_overflowing_tokens,
+      return_special_tokens_mask);
+
+    Entry entry;
+    if (!entry.Pack(output)) return output;
+    entry.hash = hash;
+    entry.text = text;
+    entry.text_pair = text_pair;
+    entry.truncation_strategy = truncation_strategy;
+    entry.options = options;
+    entry.expires = options_.ttl_seconds > 0 ?
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options_.ttl_seconds)) :
+      Clock::time_point::max();
+    // The list and index nodes are about 64 bytes.
+    entry.bytes = sizeof(Entry) + 64 + text.size() + text_pair.size() +
+                  truncation_strategy.size() +
+                  entry.values.size() * sizeof(uint32_t);
+
+    lock_guard<mutex> lock(shard->mu);
+    admit(shard, &entry);
+    return output;
+  }
+
+void EncodeCache::admit(Shard* shard, Entry* entry) {
+  if (entry->bytes > shard_max_bytes_) {
+    shard->rejections++;
+    return;
+  }
+  auto iter = shard->index.find(entry->hash);
+  if (iter != shard->index.end()) {
+    // Another thread stored the same key meanwhile, or a key with the same
+    // hash, which is replaced.
+    if (iter->second->Matches(entry->text, entry->text_pair, entry->options,
+                              entry->truncation_strategy)) {
+      return;
+    }
+    shard->Remove(iter->second);
+  }
+
+  // Collects from the LRU tail every victim needed to make room. The
+  // candidate has to be requested more often than each of them which has
+  // not expired; otherwise nothing but the expired victims is removed.
+  const uint8_t frequency = shard->sketch.Estimate(entry->hash);
+  const Clock::time_point now = Clock::now();
+  vector<list<Entry>::iterator> victims;
+  size_t num_entries = shard->entries.size();
+  size_t bytes = shard->bytes;
+  bool admitted = true;
+  for (auto iter = shard->entries.rbegin();
+       num_entries >= shard_max_entries_ ||
+       bytes + entry->bytes > shard_max_bytes_;
+       ++iter) {
+    victims.push_back(std::prev(iter.base()));
+    num_entries--;
+    bytes -= iter->bytes;
+    if (iter->expires > now &&
+        shard->sketch.Estimate(iter->hash) >= frequency) {
+      admitted = false;
+    }
+  }
+  for (auto& victim : victims) {
+    if (victim->expires <= now) {
+      shard->Remove(victim);
+      shard->expirations++;
+    } else if (admitted) {
+      shard->Remove(victim);
+      shard->evictions++;
+    }
+  }
+  if (!admitted) {
+    shard->rejections++;
+    return;
+  }
+
+  shard->bytes += entry->bytes;
+  shard->entries.push_front(std::move(*entry));
+  shard->index[shard->entries.front().hash] = shard->entries.begin();
+  shard->admissions++;
+}
+
+void EncodeCache::Clear() {
+  for (auto& shard : shards_) {
+    lock_guard<mutex> lock(shard->mu);
+    shard->entries.clear();
+    shard->index.clear();
+    shard->sketch.Clear();
+    shard->bytes = 0;
+  }
+}
+
+EncodeCache::Stats EncodeCache::GetStats() const {
+  Stats stats;
+  for (auto& shard : shards_) {
+    lock_guard<mutex> lock(shard->mu);
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.admissions += shard->admissions;
+    stats.rejections += shard->rejections;
+    stats.evictions += shard->evictions;
+    stats.expirations += shard->expirations;
+    stats.num_entries += shard->entries.size();
+    stats.num_bytes += shard->bytes;
+  }
+  stats.bypasses = bypasses_.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,420 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "paddlenlp/encode_pipeline.h"
+#include "paddlenlp/ring_buffer.h"
+
+
+using std::function;
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+namespace {
+
+// The yields before a thread blocks on an empty or full queue.
+const int kSpinCount = 64;
+
+// A RingBuffer on which a thread that finds the queue empty or full yields
+// kSpinCount times, then sleeps on a condition variable until a push or pop
+// changes the queue. The mutex is only taken by the threads which block and
+// by the pushes and pops which wake them.
+template <typename T>
+class BlockingQueue {
+ public:
+  explicit BlockingQueue(size_t capacity) : ring_(capacity) {}
+
+  // waits counts the calls which found the queue empty, and blocks those
+  // which had to sleep.
+  T Pop(uint64_t* waits, uint64_t* blocks) {
+    T value;
+    wait([&]() { return ring_.TryPop(&value); }, waits, blocks);
+    return value;
+  }
+  void Push(const T& value, uint64_t* waits, uint64_t* blocks) {
+    wait([&]() { return ring_.TryPush(value); }, waits, blocks);
+  }
+  bool TryPush(const T& value) { return ring_.TryPush(value); }
+
+ private:
+  template <typename TryFunc>
+  void wait(TryFunc try_once, uint64_t* waits, uint64_t* blocks) {
+    if (!try_once()) {
+      ++*waits;
+      int spins = 0;
+      while (!try_once()) {
+        if (++spins < kSpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+        ++*blocks;
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        while (!try_once()) changed_.wait(lock);
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    signal();
+  }
+
+  // Wakes the sleepers after a push or pop. The fence pairs with the
+  // increment of sleepers_ before a sleeper retries: either the sleeper
+  // sees the change of the ring, or this thread sees the sleeper, and then
+  // the mutex orders the notification after the sleeper waits.
+  void signal() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      changed_.notify_all();
+    }
+  }
+
+  RingBuffer<T> ring_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::atomic<int> sleepers_{0};
+};
+
+}  // namespace
+
+struct EncodePipeline::StageCounters {
+  std::atomic<uint64_t> batches{0};
+  std::atomic<uint64_t> busy_ns{0};
+  std::atomic<uint64_t> input_waits{0};
+  std::atomic<uint64_t> output_waits{0};
+  std::atomic<uint64_t> input_blocks{0};
+  std::atomic<uint64_t> output_blocks{0};
+};
+
+// The examples [begin, end) and what the stages made of them so far. The
+// buffers are kept when the batch is recycled.
+struct EncodePipeline::Batch {
+  size_t begin{0};
+  size_t end{0};
+  // Two per example: the text and the pair.
+  vector<PreTokenizedText> words;
+  vector<vector<size_t>> ids;
+  // The examples which failed in an earlier stage.
+  vector<char> failed;
+};
+
+// The state of one EncodeInto call. The calling thread feeds the batches;
+// a null batch tells a thread that its stage is done, and the last thread
+// of a stage to finish passes one to every thread of the next.
+class EncodePipeline::Run {
+ public:
+  // encode_row truncates and writes the ids of example i and returns its
+  // length.
+  using EncodeRow =
+    function<size_t(vector<size_t>*, vector<size_t>*, size_t)>;
+
+  // Only the first text_words and pair_words words of the texts and pairs
+  // are needed.
+  Run(const EncodePipeline& pipeline,
+      const vector<string>& texts,
+      const vector<string>& text_pairs,
+      size_t text_words,
+      size_t pair_words,
+      const EncodeRow& encode_row,
+      vector<size_t>* seq_lens);
+  // Returns once every example went through every stage; then throws the
+  // exception of the first failing example, if any.
+  void Execute();
+
+ private:
+  void work(Stage stage);
+  void process(Stage stage, Batch* batch);
+  bool has_pair(size_t i) const {
+    return !text_pairs_.empty() && !text_pairs_[i].empty();
+  }
+  // Records the exception being handled for example i.
+  void fail(size_t i);
+
+  const BertTokenizer& tokenizer_;
+  const Options& options_;
+  StageCounters* counters_;
+  const vector<string>& texts_;
+  const vector<string>& text_pairs_;
+  size_t text_words_;
+  size_t pair_words_;
+  EncodeRow encode_row_;
+  vector<size_t>* seq_lens_;
+
+  vector<Batch> batches_;
+  BlockingQueue<Batch*> free_batches_;
+  // The input queue of every stage.
+  vector<unique_ptr<BlockingQueue<Batch*>>> queues_;
+  std::atomic<size_t> running_[kNumStages];
+
+  std::mutex error_mutex_;
+  size_t error_index_;
+  std::exception_ptr error_;
+};
+
+EncodePipeline::Run::Run(const EncodePipeline& pipeline,
+                         const vector<string>& texts,
+                         const vector<string>& text_pairs,
+                         size_t text_words,
+                         size_t pair_words,
+                         const EncodeRow& encode_row,
+                         vector<size_t>* seq_lens) :
+  tokenizer_(*pipeline.tokenizer_),
+  options_(pipeline.options_),
+  counters_(pipeline.counters_.get()),
+  texts_(texts),
+  text_pairs_(text_pairs),
+  text_words_(text_words),
+  pair_words_(pair_words),
+  encode_row_(encode_row),
+  seq_lens_(seq_lens),
+  // Enough batches to fill every queue and keep every thread busy, so
+  // only the queues bound the work in flight.
+  batches_(kNumStages * options_.queue_batches + options_.num_threads[0] +
+           options_.num_threads[1] + options_.num_threads[2] + 1),
+  free_batches_(batches_.size()),
+  error_index_(texts.size()) {
+  for (size_t s = 0; s < kNumStages; ++s) {
+    queues_.emplace_back(new BlockingQueue<Batch*>(options_.queue_batches));
+    running_[s] = options_.num_threads[s];
+  }
+  for (auto& batch : batches_) free_batches_.TryPush(&batch);
+}
+
+void EncodePipeline::Run::fail(size_t i) {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  if (i < error_index_) {
+    error_index_ = i;
+    error_ = std::current_exception();
+  }
+}
+
+void EncodePipeline::Run::process(Stage stage, Batch* batch) {
+  const size_t n = batch->end - batch->begin;
+  if (stage == kNormalize) {
+    batch->words.resize(2 * n);
+    batch->ids.resize(2 * n);
+    batch->failed.assign(n, 0);
+  }
+  for (size_t k = 0; k < n; ++k) {
+    if (batch->failed[k]) continue;
+    const size_t i = batch->begin + k;
+    vector<size_t>& ids = batch->ids[2 * k];
+    vector<size_t>& pair_ids = batch->ids[2 * k + 1];
+    try {
+      if (stage == kNormalize) {
+        tokenizer_.PreTokenize(texts_[i], text_words_, &batch->words[2 * k]);
+        if (has_pair(i)) {
+          tokenizer_.PreTokenize(text_pairs_[i], pair_words_,
+                                 &batch->words[2 * k + 1]);
+        }
+      } else if (stage == kLookup) {
+        tokenizer_.ConvertPreTokenizedToIds(batch->words[2 * k], &ids);
+        pair_ids.clear();
+        if (has_pair(i)) {
+          tokenizer_.ConvertPreTokenizedToIds(batch->words[2 * k + 1],
+                                              &pair_ids);
+        }
+      } else {
+        const size_t len = encode_row_(&ids, &pair_ids, i);
+        if (seq_lens_) (*seq_lens_)[i] = len;
+      }
+    }
+    catch (...) {
+      batch->failed[k] = 1;
+      fail(i);
+    }
+  }
+}
+
+void EncodePipeline::Run::work(Stage stage) {
+  uint64_t batches = 0;
+  uint64_t input_waits = 0;
+  uint64_t output_waits = 0;
+  uint64_t input_blocks = 0;
+  uint64_t output_blocks = 0;
+  std::chrono::steady_clock::duration busy{0};
+  BlockingQueue<Batch*>* input = queues_[stage].get();
+  BlockingQueue<Batch*>* output =
+    stage + 1 < kNumStages ? queues_[stage + 1].get() : &free_batches_;
+  for (;;) {
+    Batch* batch = input->Pop(&input_waits, &input_blocks);
+    if (!batch) break;
+    const auto begin = std::chrono::steady_clock::now();
+    process(stage, batch);
+    busy += std::chrono::steady_clock::now() - begin;
+    batches++;
+    output->Push(batch, &output_waits, &output_blocks);
+  }
+  if (--running_[stage] == 0 && stage + 1 < kNumStages) {
+    for (size_t t = 0; t < options_.num_threads[stage + 1]; ++t) {
+      output->Push(nullptr, &output_waits, &output_blocks);
+    }
+  }
+  StageCounters& counters = counters_[stage];
+  counters.batches += batches;
+  counters.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    busy).count();
+  counters.input_waits += input_waits;
+  counters.output_waits += output_waits;
+  counters.input_blocks += input_blocks;
+  counters.output_blocks += output_blocks;
+}
+
+void EncodePipeline::Run::Execute() {
+  vector<std::thread> threads;
+  for (size_t s = 0; s < kNumStages; ++s) {
+    for (size_t t = 0; t < options_.num_threads[s]; ++t) {
+      threads.emplace_back(&Run::work, this, static_cast<Stage>(s));
+    }
+  }
+  uint64_t waits = 0;
+  uint64_t blocks = 0;
+  for (size_t begin = 0; begin < texts_.size();
+       begin += options_.batch_size) {
+    Batch* batch = free_batches_.Pop(&waits, &blocks);
+    batch->begin = begin;
+    batch->end = std::min(texts_.size(), begin + options_.batch_size);
+    queues_[kNormalize]->Push(batch, &waits, &blocks);
+  }
+  for (size_t t = 0; t < options_.num_threads[kNormalize]; ++t) {
+    queues_[kNormalize]->Push(nullptr, &waits, &blocks);
+  }
+  for (auto& thread : threads) thread.join();
+  if (error_) std::rethrow_exception(error_);
+}
+
+
+EncodePipeline::EncodePipeline(shared_ptr<const BertTokenizer> tokenizer) :
+  EncodePipeline(tokenizer, Options()) {}
+
+EncodePipeline::EncodePipeline(shared_ptr<const BertTokenizer> tokenizer,
+                               const Options& options) :
+  tokenizer_(tokenizer),
+  options_(options),
+  counters_(new StageCounters[kNumStages]) {
+  if (!tokenizer_) {
+    throw runtime_error("EncodePipeline needs a non-null tokenizer.");
+  }
+  if (options_.batch_size == 0 || options_.queue_batches == 0) {
+    throw runtime_error("EncodePipeline needs batches and queues of at "
+                        "least one.");
+  }
+  for (size_t s = 0; s < kNumStages; ++s) {
+    if (options_.num_threads[s] == 0) {
+      throw runtime_error("EncodePipeline needs at least one thread per "
+                          "stage.");
+    }
+  }
+}
+
+EncodePipeline::~EncodePipeline() {}
+
+template <typename T>
+void EncodePipeline::encode_into(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<T>& buffers,
+  vector<size_t>* seq_lens,
+  const string& truncation_strategy) const {
+    if (max_seq_len <= 0) {
+      throw runtime_error("EncodeInto needs a positive max_seq_len.");
+    }
+    if (!text_pairs.empty() && text_pairs.size() != texts.size()) {
+      throw runtime_error(
+        "The number of text pairs should be the same as the texts.");
+    }
+    if (seq_lens) seq_lens->resize(texts.size());
+    // Every word gives at least one id, so these prefixes hold the ids the
+    // truncation keeps (as in BertTokenizer::get_bounded_input_ids), and
+    // a long text is only normalized as far as it is used.
+    const size_t kNoLimit = BertTokenizer::kNoTokenLimit;
+    size_t text_words = kNoLimit;
+    size_t pair_words = kNoLimit;
+    if (max_seq_len > 3 && truncation_strategy == "longest_first") {
+      text_words = max_seq_len - 2;
+      pair_words = max_seq_len - 3;
+    } else if (max_seq_len > 3 && truncation_strategy == "only_first") {
+      text_words = max_seq_len - 2;
+    }
+    const BertTokenizer& tokenizer = *tokenizer_;
+    auto encode_row = [&](vector<size_t>* ids,
+                          vector<size_t>* pair_ids,
+                          size_t i) {
+      return tokenizer.EncodeIdsInto(ids, pair_ids, max_seq_len, buffers, i,
+                                     truncation_strategy);
+    };
+    Run run(*this, texts, text_pairs, text_words, pair_words, encode_row,
+            seq_lens);
+    run.Execute();
+  }
+
+void EncodePipeline::EncodeInto(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<int64_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    encode_into(texts, text_pairs, max_seq_len, buffers, seq_lens,
+                truncation_strategy);
+  }
+
+void EncodePipeline::EncodeInto(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<int32_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    encode_into(texts, text_pairs, max_seq_len, buffers, seq_lens,
+                truncation_strategy);
+  }
+
+EncodePipeline::Stats EncodePipeline::GetStats() const {
+  Stats stats;
+  for (size_t s = 0; s < kNumStages; ++s) {
+    StageStats& stage = stats.stages[s];
+    stage.batches = counters_[s].batches;
+    stage.busy_seconds = counters_[s].busy_ns * 1e-9;
+    stage.input_waits = counters_[s].input_waits;
+    stage.output_waits = counters_[s].output_waits;
+    stage.input_blocks = counters_[s].input_blocks;
+    stage.output_blocks = counters_[s].output_blocks;
+  }
+  return stats;
+}
+
+const char* EncodePipeline::StageName(Stage stage) {
+  switch (stage) {
+    case kNormalize: return "normalize";
+    case kLookup: return "lookup";
+    case kEncode: return "encode";
+    default: return "";
+  }
+}
@@ -0,0 +1,396 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/indexed_dataset.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+namespace {
+
+const char kMagic[9] = {'M', 'M', 'I', 'D', 'I', 'D', 'X', '\0', '\0'};
+const uint64_t kVersion = 1;
+// Magic, version, dtype code, number of sequences, length of the document
+// starts.
+const size_t kHeaderSize = sizeof(kMagic) + 8 + 1 + 8 + 8;
+const size_t kMergeBlockBytes = 1 << 20;
+
+// The index is not aligned: it follows the 34 bytes of the header.
+template <typename T>
+T Load(const char* p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void Store(T value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Maps a whole file read-only; an empty file maps to size 0.
+const char* MapFile(const string& path, size_t* size) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw runtime_error("Can not open " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw runtime_error("Can not stat " + path);
+  }
+  *size = st.st_size;
+  if (*size == 0) {
+    close(fd);
+    return nullptr;
+  }
+  void* data = mmap(nullptr, *size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) throw runtime_error("Can not map " + path);
+  return static_cast<const char*>(data);
+}
+
+void WriteAll(FILE* file, const void* data, size_t size,
+              const string& path) {
+  if (size > 0 && fwrite(data, 1, size, file) != size) {
+    throw runtime_error("Can not write " + path);
+  }
+}
+
+void WriteIndex(const string& path,
+                IdType id_type,
+                const vector<int32_t>& sizes,
+                const vector<int64_t>& pointers,
+                const vector<int64_t>& document_starts) {
+  string header(kMagic, sizeof(kMagic));
+  Store<uint64_t>(kVersion, &header);
+  Store<uint8_t>(static_cast<uint8_t>(id_type), &header);
+  Store<uint64_t>(sizes.size(), &header);
+  Store<uint64_t>(document_starts.size(), &header);
+  FILE* idx = fopen(path.c_str(), "wb");
+  if (!idx) throw runtime_error("Can not create " + path);
+  unique_ptr<FILE, int (*)(FILE*)> closer(idx, fclose);
+  WriteAll(idx, header.data(), header.size(), path);
+  WriteAll(idx, sizes.data(), sizes.size() * sizeof(int32_t), path);
+  WriteAll(idx, pointers.data(), pointers.size() * sizeof(int64_t), path);
+  WriteAll(idx, document_starts.data(),
+           document_starts.size() * sizeof(int64_t), path);
+  if (fclose(closer.release()) != 0) {
+    throw runtime_error("Can not write " + path);
+  }
+}
+
+}  // namespace
+
+
+IdType IdTypeForVocabSize(size_t vocab_size) {
+  return vocab_size <= 65536 ? IdType::kUInt16 : IdType::kInt32;
+}
+
+size_t IdTypeSize(IdType type) {
+  return type == IdType::kUInt16 ? sizeof(uint16_t) : sizeof(int32_t);
+}
+
+
+IndexedDatasetWriter::IndexedDatasetWriter(const string& prefix,
+                                           IdType id_type) :
+  prefix_(prefix), id_type_(id_type) {
+    bin_ = fopen((prefix_ + ".bin").c_str(), "wb");
+    if (!bin_) throw runtime_error("Can not create " + prefix_ + ".bin");
+  }
+
+IndexedDatasetWriter::~IndexedDatasetWriter() {
+  try {
+    Close();
+  }
+  catch (...) {
+  }
+}
+
+size_t IndexedDatasetWriter::AddDocument(const vector<size_t>& ids) {
+  check_ids(ids);
+  lock_guard<mutex> lock(mutex_);
+  add_sequence(ids);
+  document_starts_.push_back(sizes_.size());
+  return document_starts_.size() - 2;
+}
+
+size_t IndexedDatasetWriter::AddDocument(
+  const vector<vector<size_t>>& sequences) {
+  // A bad id must not leave a part of the document behind.
+  for (auto& ids : sequences) check_ids(ids);
+  lock_guard<mutex> lock(mutex_);
+  for (auto& ids : sequences) add_sequence(ids);
+  document_starts_.push_back(sizes_.size());
+  return document_starts_.size() - 2;
+}
+
+void IndexedDatasetWriter::check_ids(const vector<size_t>& ids) const {
+  if (ids.size() > static_cast<size_t>(INT32_MAX)) {
+    throw runtime_error("A sequence has more than 2^31 ids.");
+  }
+  const size_t max_id = id_type_ == IdType::kUInt16 ?
+    UINT16_MAX : static_cast<size_t>(INT32_MAX);
+  for (auto& id : ids) {
+    if (id > max_id) {
+      throw runtime_error("Id " + std::to_string(id) + " does not fit " +
+                          (id_type_ == IdType::kUInt16 ? "uint16." : "int32."));
+    }
+  }
+}
+
+void IndexedDatasetWriter::add_sequence(const vector<size_t>& ids) {
+  if (!bin_) throw runtime_error("The writer of " + prefix_ + " is closed.");
+  const size_t id_size = IdTypeSize(id_type_);
+  buffer_.resize(ids.size() * id_size);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (id_type_ == IdType::kUInt16) {
+      const uint16_t id = static_cast<uint16_t>(ids[i]);
+      std::memcpy(&buffer_[i * id_size], &id, id_size);
+    } else {
+      const int32_t id = static_cast<int32_t>(ids[i]);
+      std::memcpy(&buffer_[i * id_size], &id, id_size);
+    }
+  }
+  WriteAll(bin_, buffer_.data(), buffer_.size(), prefix_ + ".bin");
+  sizes_.push_back(static_cast<int32_t>(ids.size()));
+  pointers_.push_back(bin_bytes_);
+  bin_bytes_ += buffer_.size();
+}
+
+void IndexedDatasetWriter::Close() {
+  lock_guard<mutex> lock(mutex_);
+  if (!bin_) return;
+  const bool bin_ok = fclose(bin_) == 0;
+  bin_ = nullptr;
+  if (!bin_ok) throw runtime_error("Can not write " + prefix_ + ".bin");
+
+  WriteIndex(prefix_ + ".idx", id_type_, sizes_, pointers_,
+             document_starts_);
+}
+
+size_t IndexedDatasetWriter::NumSequences() const {
+  lock_guard<mutex> lock(mutex_);
+  return sizes_.size();
+}
+
+size_t IndexedDatasetWriter::NumDocuments() const {
+  lock_guard<mutex> lock(mutex_);
+  return document_starts_.size() - 1;
+}
+
+
+IndexedDataset::IndexedDataset(const string& prefix) {
+  idx_ = MapFile(prefix + ".idx", &idx_size_);
+  try {
+    bin_ = MapFile(prefix + ".bin", &bin_size_);
+  }
+  catch (...) {
+    if (idx_) munmap(const_cast<char*>(idx_), idx_size_);
+    throw;
+  }
+  try {
+    const string error = "Malformed index " + prefix + ".idx";
+    if (idx_size_ < kHeaderSize ||
+        std::memcmp(idx_, kMagic, sizeof(kMagic)) != 0 ||
+        Load<uint64_t>(idx_ + sizeof(kMagic)) != kVersion) {
+      throw runtime_error(error);
+    }
+    const uint8_t code = Load<uint8_t>(idx_ + sizeof(kMagic) + 8);
+    if (code == static_cast<uint8_t>(IdType::kUInt16)) {
+      id_type_ = IdType::kUInt16;
+    } else if (code == static_cast<uint8_t>(IdType::kInt32)) {
+      id_type_ = IdType::kInt32;
+    } else {
+      throw runtime_error(error + ": ids of dtype code " +
+                          std::to_string(code) + " are not supported.");
+    }
+    const uint64_t num_sequences = Load<uint64_t>(idx_ + sizeof(kMagic) + 9);
+    const uint64_t num_starts = Load<uint64_t>(idx_ + sizeof(kMagic) + 17);
+    if (num_starts == 0 ||
+        num_sequences > (idx_size_ - kHeaderSize) / 12 ||
+        num_starts > (idx_size_ - kHeaderSize) / 8 ||
+        kHeaderSize + num_sequences * 12 + num_starts * 8 > idx_size_) {
+      throw runtime_error(error);
+    }
+    num_sequences_ = num_sequences;
+    num_documents_ = num_starts - 1;
+    sizes_ = idx_ + kHeaderSize;
+    pointers_ = sizes_ + num_sequences_ * sizeof(int32_t);
+    document_starts_ = pointers_ + num_sequences_ * sizeof(int64_t);
+
+    // One pass over the index, so that the lookups need no checks of the
+    // file contents.
+    const size_t id_size = IdTypeSize(id_type_);
+    for (size_t i = 0; i < num_sequences_; ++i) {
+      const int32_t size = Load<int32_t>(sizes_ + i * sizeof(int32_t));
+      const int64_t pointer = Load<int64_t>(pointers_ + i * sizeof(int64_t));
+      if (size < 0 || pointer < 0 || pointer % id_size != 0 ||
+          static_cast<uint64_t>(pointer) + static_cast<uint64_t>(size) *
+            id_size > bin_size_) {
+        throw runtime_error(error + ": sequence " + std::to_string(i) +
+                            " is outside of " + prefix + ".bin");
+      }
+    }
+    int64_t previous = 0;
+    for (size_t i = 0; i <= num_documents_; ++i) {
+      const int64_t start =
+        Load<int64_t>(document_starts_ + i * sizeof(int64_t));
+      if (start < previous ||
+          static_cast<uint64_t>(start) > num_sequences_ ||
+          (i == 0 && start != 0)) {
+        throw runtime_error(error + ": bad document start " +
+                            std::to_string(i));
+      }
+      for (int64_t s = previous + 1; i > 0 && s < start; ++s) {
+        if (pointer(s) != pointer(s - 1) + SequenceLength(s - 1) * id_size) {
+          adjacent_documents_ = false;
+        }
+      }
+      previous = start;
+    }
+  }
+  catch (...) {
+    if (idx_) munmap(const_cast<char*>(idx_), idx_size_);
+    if (bin_) munmap(const_cast<char*>(bin_), bin_size_);
+    throw;
+  }
+}
+
+IndexedDataset::~IndexedDataset() {
+  if (idx_) munmap(const_cast<char*>(idx_), idx_size_);
+  if (bin_) munmap(const_cast<char*>(bin_), bin_size_);
+}
+
+size_t IndexedDataset::SequenceLength(size_t i) const {
+  if (i >= num_sequences_) {
+    throw runtime_error("Sequence " + std::to_string(i) + " is out of range.");
+  }
+  return Load<int32_t>(sizes_ + i * sizeof(int32_t));
+}
+
+size_t IndexedDataset::DocumentBegin(size_t i) const {
+  if (i > num_documents_) {
+    throw runtime_error("Document " + std::to_string(i) + " is out of range.");
+  }
+  return Load<int64_t>(document_starts_ + i * sizeof(int64_t));
+}
+
+uint64_t IndexedDataset::pointer(size_t i) const {
+  if (i >= num_sequences_) {
+    throw runtime_error("Sequence " + std::to_string(i) + " is out of range.");
+  }
+  return Load<int64_t>(pointers_ + i * sizeof(int64_t));
+}
+
+void IndexedDataset::check_type(size_t type_size) const {
+  if (type_size != IdTypeSize(id_type_)) {
+    throw runtime_error("The ids of the dataset are " +
+                        std::to_string(IdTypeSize(id_type_) * 8) +
+                        "-bit; use the matching span type.");
+  }
+}
+
+void IndexedDataset::check_adjacent() const {
+  if (!adjacent_documents_) {
+    throw runtime_error(
+      "The sequences of a document are not adjacent; use Sequence.");
+  }
+}
+
+vector<size_t> IndexedDataset::SequenceIds(size_t i) const {
+  vector<size_t> ids;
+  if (id_type_ == IdType::kUInt16) {
+    const IdSpan<uint16_t>& span = Sequence<uint16_t>(i);
+    ids.assign(span.begin(), span.end());
+  } else {
+    const IdSpan<int32_t>& span = Sequence<int32_t>(i);
+    ids.assign(span.begin(), span.end());
+  }
+  return ids;
+}
+
+
+void MergeIndexedDatasets(const vector<string>& prefixes,
+                          const string& output_prefix) {
+  vector<unique_ptr<IndexedDataset>> inputs;
+  IdType id_type = IdType::kUInt16;
+  for (auto& prefix : prefixes) {
+    inputs.emplace_back(new IndexedDataset(prefix));
+    if (inputs.back()->GetIdType() == IdType::kInt32) {
+      id_type = IdType::kInt32;
+    }
+  }
+
+  const string bin_path = output_prefix + ".bin";
+  FILE* bin = fopen(bin_path.c_str(), "wb");
+  if (!bin) throw runtime_error("Can not create " + bin_path);
+  unique_ptr<FILE, int (*)(FILE*)> closer(bin, fclose);
+  vector<int32_t> sizes;
+  vector<int64_t> pointers;
+  vector<int64_t> document_starts{0};
+  uint64_t bin_bytes = 0;
+  vector<int32_t> widened;
+  for (auto& input : inputs) {
+    const size_t base = sizes.size();
+    if (input->GetIdType() == id_type) {
+      // The .bin file is copied as it is, so the pointers only move.
+      for (size_t i = 0; i < input->NumSequences(); ++i) {
+        sizes.push_back(input->SequenceLength(i));
+        pointers.push_back(bin_bytes + input->pointer(i));
+      }
+      for (size_t pos = 0; pos < input->bin_size_; pos += kMergeBlockBytes) {
+        WriteAll(bin, input->bin_ + pos,
+                 std::min(kMergeBlockBytes, input->bin_size_ - pos),
+                 bin_path);
+      }
+      bin_bytes += input->bin_size_;
+    } else {
+      // uint16 ids widened to int32, sequence by sequence.
+      for (size_t i = 0; i < input->NumSequences(); ++i) {
+        const IdSpan<uint16_t>& span = input->Sequence<uint16_t>(i);
+        widened.assign(span.begin(), span.end());
+        WriteAll(bin, widened.data(), widened.size() * sizeof(int32_t),
+                 bin_path);
+        sizes.push_back(span.size());
+        pointers.push_back(bin_bytes);
+        bin_bytes += widened.size() * sizeof(int32_t);
+      }
+    }
+    for (size_t d = 1; d <= input->NumDocuments(); ++d) {
+      document_starts.push_back(base + input->DocumentBegin(d));
+    }
+  }
+  if (fclose(closer.release()) != 0) {
+    throw runtime_error("Can not write " + bin_path);
+  }
+  WriteIndex(output_prefix + ".idx", id_type, sizes, pointers,
+             document_starts);
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "paddlenlp/multi_vocab_encoder.h"
+
+
+using std::runtime_error;
+using std::shared_ptr;
+using std::string_view;
+using std::vector;
+
+
+MultiVocabEncoder::MultiVocabEncoder(
+  const vector<shared_ptr<const BertTokenizer>>& tokenizers) :
+  tokenizers_(tokenizers) {
+  for (auto& tokenizer : tokenizers_) {
+    if (!tokenizer) {
+      throw runtime_error("MultiVocabEncoder needs non-null tokenizers.");
+    }
+    size_t group = 0;
+    while (group < group_tokenizers_.size() &&
+           !tokenizer->SharesPreTokenization(
+             *tokenizers_[group_tokenizers_[group]])) {
+      group++;
+    }
+    if (group == group_tokenizers_.size()) {
+      group_tokenizers_.push_back(groups_.size());
+    }
+    groups_.push_back(group);
+  }
+}
+
+void MultiVocabEncoder::PreTokenize(string_view text,
+                                    vector<PreTokenizedText>* words) const {
+  words->resize(group_tokenizers_.size());
+  for (size_t g = 0; g < group_tokenizers_.size(); ++g) {
+    tokenizers_[group_tokenizers_[g]]->PreTokenize(text, &(*words)[g]);
+  }
+}
+
+void MultiVocabEncoder::ConvertToIds(const vector<PreTokenizedText>& words,
+                                     vector<vector<size_t>>* ids) const {
+  if (words.size() != group_tokenizers_.size()) {
+    throw runtime_error("ConvertToIds needs the words of every group.");
+  }
+  ids->resize(tokenizers_.size());
+  for (size_t i = 0; i < tokenizers_.size(); ++i) {
+    tokenizers_[i]->ConvertPreTokenizedToIds(words[groups_[i]], &(*ids)[i]);
+  }
+}
+
+void MultiVocabEncoder::TokenizeToIds(string_view text,
+                                      vector<vector<size_t>>* ids) const {
+  vector<PreTokenizedText> words;
+  PreTokenize(text, &words);
+  ConvertToIds(words, ids);
+}
@@ -12,40 +12,52 @@
 #include <utf8proc.h>
 
 #include <algorithm>
-#include <codecvt>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <exception>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 #include <boost/algorithm/string.hpp>
 
+#include "paddlenlp/boundary_scanner.h"
+#include "paddlenlp/static_vocab.h"
 #include "paddlenlp/tokenizer.h"
+#include "paddlenlp/utf8.h"
+#include "paddlenlp/vocab_registry.h"
 
 
-using std::bad_cast;
 using std::cerr;
 using std::cin;
-using std::codecvt_utf8;
 using std::cout;
 using std::endl;
 using std::exception;
 using std::ifstream;
+using std::max;
 using std::min;
 using std::runtime_error;
 using std::unordered_map;
-using std::unorder_set;
+using std::unordered_set;
 using std::shared_ptr;
 using std::size_t;
 using std::string;
+using std::string_view;
 using std::vector;
 using std::wcout;
 using std::wstring;
-using std::wstring_convert;
 
 
 const wstring kStripChars = L" \t\n\r\v\f";
@@ -78,32 +90,52 @@ bool IsPunctuation(const wchar_t& ch) {
   return false;
 }
 
-string NormalizeNfd(const string& s) {
-  string ret;
-  char* result = reinterpret_cast<char*>(
-    utf8proc_NFD(reinterpret_cast<const unsigned char*>(s.c_str())));
-  if (result) {
-    ret = string(result);
-    free(result);
-    result = nullptr;
-  }
-
-  return ret;
+uint8_t CombiningClass(wchar_t ch) {
+  return utf8proc_get_property(ch)->combining_class;
 }
 
-bool IsStripChar(const wchar_t& ch) {
-  return kStripChars.find(ch) != wstring::npos;
+// NFD of text. utf8proc_NFD puts the combining marks in canonical order by
+// swapping neighbours, which is quadratic in the length of a run of marks;
+// here every character is decomposed on its own and every run of marks is
+// put in order with a stable sort, which gives the same result.
+wstring NormalizeNfd(const wstring& text) {
+  const utf8proc_ssize_t kMaxDecomposition = 8;
+  utf8proc_int32_t decomposed[kMaxDecomposition];
+  wstring ret;
+  ret.reserve(text.size());
+  for (auto& ch : text) {
+    const utf8proc_ssize_t n = utf8proc_decompose_char(
+      ch, decomposed, kMaxDecomposition, UTF8PROC_DECOMPOSE, nullptr);
+    if (n < 0 || n > kMaxDecomposition) {
+      ret.push_back(ch);
+      continue;
+    }
+    ret.append(decomposed, decomposed + n);
+  }
+  size_t i = 0;
+  while (i < ret.size()) {
+    if (CombiningClass(ret[i]) == 0) {
+      i++;
+      continue;
+    }
+    size_t end = i + 1;
+    while (end < ret.size() && CombiningClass(ret[end]) != 0) end++;
+    if (end - i > 1) {
+      std::stable_sort(ret.begin() + i, ret.begin() + end,
+                       [](wchar_t a, wchar_t b) {
+                         return CombiningClass(a) < CombiningClass(b);
+                       });
+    }
+    i = end;
+  }
+  return ret;
 }
 
 wstring Strip(const wstring& text) {
-  wstring ret = text;
-  if (ret.empty()) return ret;
-  size_t pos = 0;
-  while (pos < ret.size() && IsStripChar(ret[pos])) pos++;
-  if (pos != 0) ret = ret.substr(pos, ret.size() - pos);
-  pos = ret.size() - 1;
-  while (IsStripChar(ret[pos])) pos--;
-  return ret.substr(0, pos + 1);
+  const size_t begin = text.find_first_not_of(kStripChars);
+  if (begin == wstring::npos) return wstring();
+  const size_t end = text.find_last_not_of(kStripChars);
+  return text.substr(begin, end + 1 - begin);
 }
 
 vector<wstring> Split(const wstring& text) {
@@ -119,13 +151,14 @@ vector<wstring> WhiteSpaceTokenize(const wstring& text) {
 }
 
 wstring ConvertStrToWstr(const string& src) {
-  wstring_convert<codecvt_utf8<wchar_t>> converter;
-  return converter.from_bytes(src);
+  return DecodeUtf8Lenient(src);
 }
 
 string ConvertWstrToStr(const wstring& src) {
-  wstring_convert<codecvt_utf8<wchar_t>> converter;
-  return converter.to_bytes(src);
+  string out;
+  out.reserve(src.size());
+  for (auto& ch : src) AppendUtf8(static_cast<uint32_t>(ch), &out);
+  return out;
 }
 
 wstring ToLower(const wstring& s) {
@@ -136,17 +169,11 @@ wstring ToLower(const wstring& s) {
   return ret;
 }
 
-shared_ptr<Vocab> LoadVocab(const string& vocab_file) {
+shared_ptr<Vocab> ParseVocab(std::istream* is) {
   shared_ptr<Vocab> vocab(new Vocab);
-  ifstream ifs(vocab_file, ifstream::in);
-  if (!ifs) {
-    throw runtime_error(
-      "Open the vocab file failly, please check the file " + vocab_file + ".");
-  }
-
   string line;
   size_t index = 0;
-  while (getline(ifs, line)) {
+  while (getline(*is, line)) {
     wstring token = ConvertStrToWstr(line);
     // The input line cann't be converted to unicode.
     // The drop it.
@@ -155,6 +182,16 @@ shared_ptr<Vocab> LoadVocab(const string& vocab_file) {
     (*vocab)[token] = index;
     index++;
   }
+  return vocab;
+}
+
+shared_ptr<Vocab> LoadVocab(const string& vocab_file) {
+  ifstream ifs(vocab_file, ifstream::in);
+  if (!ifs) {
+    throw runtime_error(
+      "Open the vocab file failly, please check the file " + vocab_file + ".");
+  }
+  shared_ptr<Vocab> vocab = ParseVocab(&ifs);
   ifs.close();
   return vocab;
 }
@@ -187,18 +224,6 @@ int LoadVocab(const string& vocab_file, shared_ptr<Vocab> vocab) {
 BasicTokenizer::BasicTokenizer(bool do_lower_case /* = true */) :
   do_lower_case_(do_lower_case) {}
 
-wstring BasicTokenizer::clean_text(const wstring& text) const {
-  wstring output;
-  for (const wchar_t& cp : text) {
-    if (cp == 0 || cp == 0xfffd || IsControl(cp)) continue;
-    if (IsWhiteSpace(cp))
-      output.push_back(L' ');
-    else
-      output.push_back(cp);
-  }
-  return output;
-}
-
 bool BasicTokenizer::is_chinese_char(const wchar_t& ch) const {
   if ((ch >= 0x4E00 && ch <= 0x9FFF) || (ch >= 0x3400 && ch <= 0x4DBF) ||
       (ch >= 0x20000 && ch <= 0x2A6DF) || (ch >= 0x2A700 && ch <= 0x2B73F) ||
@@ -208,33 +233,10 @@ bool BasicTokenizer::is_chinese_char(const wchar_t& ch) const {
   return false;
 }
 
-wstring BasicTokenizer::tokenize_chinese_chars(
-  const wstring& text) const {
-  wstring output;
-  for (auto& ch : text) {
-    if (is_chinese_char(ch)) {
-      output.push_back(L' ');
-      output.push_back(ch);
-      output.push_back(L' ');
-    } else {
-      output.push_back(ch);
-    }
-  }
-  return output;
-}
-
 wstring BasicTokenizer::run_strip_accents(
   const wstring& text) const {
   // Strips accents from a piece of text.
-  wstring unicode_text;
-  try {
-    unicode_text = ConvertStrToWstr(NormalizeNfd(ConvertWstrToStr(text)));
-  }
-  catch (bad_cast& e) {
-    cerr << e.what() << endl;
-    return L"";
-  }
-
+  const wstring& unicode_text = NormalizeNfd(text);
   wstring output;
   for (auto& ch : unicode_text) {
     auto cat = utf8proc_category(ch);
@@ -244,54 +246,460 @@ wstring BasicTokenizer::run_strip_accents(
   return output;
 }
 
-vector<wstring> BasicTokenizer::run_split_on_punc(
-  const wstring& text) const {
+bool BasicTokenizer::run_split_on_punc(const wstring& text,
+                                       size_t begin,
+                                       size_t end,
+                                       WordVisitor* visitor) const {
+  wstring piece;
+  size_t piece_begin = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (!IsPunctuation(text[i])) continue;
+    if (i > piece_begin) {
+      piece.assign(text, piece_begin, i - piece_begin);
+      if (!visitor->OnWord(piece, begin, end)) return false;
+    }
+    piece.assign(1, text[i]);
+    if (!visitor->OnWord(piece, begin, end)) return false;
+    piece_begin = i + 1;
+  }
+  // No punctuation: the text is a single word.
+  if (piece_begin == 0) {
+    return text.empty() || visitor->OnWord(text, begin, end);
+  }
+  if (piece_begin == text.size()) return true;
+  piece.assign(text, piece_begin, text.size() - piece_begin);
+  return visitor->OnWord(piece, begin, end);
+}
+
+bool BasicTokenizer::emit_word(const wstring& word,
+                               bool normalize,
+                               bool fold,
+                               size_t begin,
+                               size_t end,
+                               WordVisitor* visitor) const {
+  if (!normalize) return visitor->OnWord(word, begin, end);
+  if (!fold) return run_split_on_punc(word, begin, end, visitor);
+  return run_split_on_punc(run_strip_accents(ToLower(word)), begin, end,
+                           visitor);
+}
+
+size_t BasicTokenizer::Tokenize(string_view text,
+                                WordVisitor* visitor) const {
+  return scan(text, false, visitor);
+}
+
+void BasicTokenizer::TokenizeNormalized(string_view text,
+                                        WordVisitor* visitor) const {
+  scan(text, true, visitor);
+}
+
+bool IsNormalizedChar(wchar_t ch, bool do_lower_case) {
+  if (ch == 0xfffd || IsControl(ch)) return false;
+  if (!do_lower_case) return true;
+  if (utf8proc_tolower(ch) != ch) return false;
+  const utf8proc_property_t* property = utf8proc_get_property(ch);
+  if (property->combining_class != 0 ||
+      property->category == UTF8PROC_CATEGORY_MN) {
+    return false;
+  }
+  utf8proc_int32_t decomposed[4];
+  const utf8proc_ssize_t n = utf8proc_decompose_char(
+    ch, decomposed, 4, UTF8PROC_DECOMPOSE, nullptr);
+  return n == 1 && decomposed[0] == ch;
+}
+
+// IsNormalizedChar of the BMP characters, one bit each, so that the check
+// of a text does no unicode lookups.
+class NormalizedCharTable {
+ public:
+  explicit NormalizedCharTable(bool do_lower_case) :
+    bits_(0x10000 / 64, 0) {
+    for (wchar_t ch = 0; ch < 0x10000; ++ch) {
+      if (IsNormalizedChar(ch, do_lower_case)) {
+        bits_[ch >> 6] |= 1ULL << (ch & 63);
+      }
+    }
+  }
+
+  bool Contains(wchar_t ch) const { return bits_[ch >> 6] >> (ch & 63) & 1; }
+
+ private:
+  vector<uint64_t> bits_;
+};
+
+// Built on the first use.
+const NormalizedCharTable& GetNormalizedCharTable(bool do_lower_case) {
+  if (do_lower_case) {
+    static const NormalizedCharTable kLowerCaseTable(true);
+    return kLowerCaseTable;
+  }
+  static const NormalizedCharTable kCasedTable(false);
+  return kCasedTable;
+}
+
+bool BasicTokenizer::IsNormalized(string_view text) const {
+  const char* data = text.data();
+  const size_t size = text.size();
+  const NormalizedCharTable& table = GetNormalizedCharTable(do_lower_case_);
+  NormalizedClassMasks masks;
+  // The bytes before i are checked; a character can end in the next block.
   size_t i = 0;
-  bool start_new_word = true;
-  vector<wstring> output;
-  while (i < text.size()) {
-    wchar_t ch = text[i];
-    if (IsPunctuation(ch)) {
-      output.push_back(wstring(&ch, 1));
-      start_new_word = true;
-    } else {
-      if (start_new_word) output.push_back(wstring());
-      start_new_word = false;
-      output[output.size() - 1] += ch;
+  for (size_t block = 0; block < size; block += kScanBlockSize) {
+    const size_t n = min(kScanBlockSize, size - block);
+    ClassifyNormalizedBytes(data + block, n, &masks);
+    if (masks.control || (do_lower_case_ && masks.upper)) return false;
+    const uint64_t checked = i > block ? (1ULL << (i - block)) - 1 : 0;
+    // Most blocks hold ASCII and characters of U+4000..U+9FFF, most of the
+    // CJK ideographs, which the normalization never changes. They pass if
+    // every lead byte of those is followed by two continuation bytes.
+    const uint64_t lead = masks.ideograph_lead;
+    const uint64_t expected = (lead << 1) | (lead << 2) | checked;
+    if (masks.continuation == expected &&
+        masks.non_ascii == (lead | expected)) {
+      // A lead byte at 62 or 63 leaves 1 or 2 bytes in the next block.
+      i = block + n + (lead >> (kScanBlockSize - 2));
+      if (i > size) return false;
+      for (size_t k = block + n; k < i; ++k) {
+        if ((data[k] & 0xC0) != 0x80) return false;
+      }
+      continue;
+    }
+    uint64_t pending = masks.non_ascii & ~checked;
+    while (pending) {
+      const size_t p = block + CountTrailingZeros(pending);
+      size_t len = 0;
+      const int32_t cp = DecodeUtf8(data + p, size - p, &len);
+      if (cp < 0) return false;
+      const wchar_t ch = static_cast<wchar_t>(cp);
+      if (ch < 0x10000 ? !table.Contains(ch)
+                       : !IsNormalizedChar(ch, do_lower_case_)) {
+        return false;
+      }
+      i = p + len;
+      if (i - block >= kScanBlockSize) break;
+      pending &= ~0ULL << (i - block);
     }
-    i++;
   }
-  return output;
+  return true;
 }
 
+size_t BasicTokenizer::scan(string_view text,
+                            bool normalized,
+                            WordVisitor* visitor) const {
+  // A single pass over the UTF-8 text that does the cleaning, the CJK
+  // splitting, the whitespace splitting and the ASCII punctuation splitting.
+  // ClassifyBytes finds the bytes which need a look in blocks of 64 bytes;
+  // the runs in between are plain ASCII characters which are appended to the
+  // current word directly. Words with non-ASCII characters are normalized
+  // and split on the (unicode) punctuation when they are complete. Both
+  // orders give the same words as cleaning and splitting the whole text
+  // first: the ASCII punctuation and the CJK characters are not changed by
+  // the normalization, and the normalization never merges characters.
+  // A normalized text has nothing to clean or fold, so its words are only
+  // split on the punctuation.
+  const char* data = text.data();
+  const size_t size = text.size();
+  wstring word;
+  wstring single(1, L' ');
+  size_t word_begin = 0;
+  size_t word_end = 0;
+  bool word_needs_normalize = false;
+  const bool fold = do_lower_case_ && !normalized;
+  size_t num_malformed = 0;
+  size_t i = 0;
+  ByteClassMasks masks;
+  while (i < size) {
+    const size_t block_begin = i;
+    const size_t block_end = i + min(kScanBlockSize, size - i);
+    ClassifyBytes(data + i, block_end - block_begin, &masks);
+    const uint64_t boundaries = BoundaryMask(masks);
+    while (i < block_end) {
+      const size_t offset = i - block_begin;
+      const uint64_t pending = boundaries >> offset;
+      if (!(pending & 1)) {
+        size_t run_end = block_end;
+        if (pending) run_end = min(block_end, i + CountTrailingZeros(pending));
+        if (word.empty()) word_begin = i;
+        for (; i < run_end; ++i) {
+          wchar_t ch = static_cast<unsigned char>(data[i]);
+          if (do_lower_case_ && ch >= L'A' && ch <= L'Z') ch += L'a' - L'A';
+          word.push_back(ch);
+        }
+        word_end = i;
+        continue;
+      }
+
+      const uint64_t bit = 1ULL << offset;
+      if (masks.control & bit) {
+        // Dropped without splitting the word.
+        i++;
+        continue;
+      }
+      if (masks.whitespace & bit || masks.punctuation & bit) {
+        if (!word.empty()) {
+          if (!emit_word(word, word_needs_normalize, fold, word_begin,
+                         word_end, visitor)) {
+            return num_malformed;
+          }
+          word.clear();
+          word_needs_normalize = false;
+        }
+        if (masks.punctuation & bit &&
+            !visitor->OnChar(static_cast<unsigned char>(data[i]), i, i + 1)) {
+          return num_malformed;
+        }
+        i++;
+        continue;
+      }
+
+      size_t len = 0;
+      const int32_t cp = DecodeUtf8(data + i, size - i, &len);
+      if (cp < 0) {
+        // A malformed sequence, or an unfinished last character, is read as
+        // U+FFFD, which the cleaning drops without splitting the word.
+        num_malformed++;
+        i += cp == kUtf8Incomplete ? size - i : len;
+        continue;
+      }
+      const wchar_t ch = static_cast<wchar_t>(cp);
+      // Most CJK characters start with a byte of cjk_lead; they skip the
+      // unicode category lookups.
+      const bool is_chinese = (masks.cjk_lead & bit || len == 3 || len == 4)
+                              && is_chinese_char(ch);
+      if (!normalized && !is_chinese &&
+          (ch == 0xfffd || IsControl(ch))) {
+        i += len;
+        continue;
+      }
+      const bool is_space = !is_chinese && IsWhiteSpace(ch);
+      if (!is_space && !is_chinese) {
+        if (word.empty()) word_begin = i;
+        word.push_back(ch);
+        word_needs_normalize = true;
+        i += len;
+        word_end = i;
+        continue;
+      }
+      if (!word.empty()) {
+        if (!emit_word(word, word_needs_normalize, fold, word_begin,
+                       word_end, visitor)) {
+          return num_malformed;
+        }
+        word.clear();
+        word_needs_normalize = false;
+      }
+      if (is_chinese) {
+        // The CJK compatibility ideographs change under NFD.
+        const bool compat = (ch >= 0xF900 && ch <= 0xFAFF) || ch >= 0x2F800;
+        if (compat) {
+          single[0] = ch;
+          if (!emit_word(single, true, fold, i, i + len, visitor)) {
+            return num_malformed;
+          }
+        } else if (!visitor->OnChar(ch, i, i + len)) {
+          return num_malformed;
+        }
+      }
+      i += len;
+    }
+  }
+  if (!word.empty()) {
+    emit_word(word, word_needs_normalize, fold, word_begin, word_end, visitor);
+  }
+  return num_malformed;
+}
+
+size_t BasicTokenizer::FindStableCut(string_view text,
+                                     size_t begin,
+                                     size_t end) const {
+  // The scan flushes the current word at these characters and starts the
+  // next one from scratch.
+  for (size_t p = end; p > begin; --p) {
+    const unsigned char c = static_cast<unsigned char>(text[p - 1]);
+    if (c < 0x80) {
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+          IsPunctuation(c)) {
+        return p;
+      }
+      continue;
+    }
+    if (p - begin < 3) continue;
+    const unsigned char lead = static_cast<unsigned char>(text[p - 3]);
+    if (lead >= 0xE3 && lead <= 0xE9) {
+      size_t len = 0;
+      const int32_t cp = DecodeUtf8(text.data() + p - 3, 3, &len);
+      if (cp >= 0 && is_chinese_char(static_cast<wchar_t>(cp))) return p;
+    }
+  }
+  return begin;
+}
+
+bool WordVisitor::OnChar(wchar_t ch, size_t begin, size_t end) {
+  return OnWord(wstring(1, ch), begin, end);
+}
+
+class WordCollector : public WordVisitor {
+ public:
+  explicit WordCollector(vector<wstring>* words) : words_(words) {}
+  bool OnWord(const wstring& word, size_t /*begin*/, size_t /*end*/) override {
+    words_->push_back(word);
+    return true;
+  }
+
+ private:
+  vector<wstring>* words_;
+};
+
 vector<wstring> BasicTokenizer::Tokenize(
   const string& text) const {
-  wstring unicode_text = ConvertStrToWstr(text);
-  unicode_text = clean_text(unicode_text);
+  vector<wstring> split_tokens;
+  WordCollector collector(&split_tokens);
+  Tokenize(text, &collector);
+  return split_tokens;
+}
 
-  unicode_text = tokenize_chinese_chars(unicode_text);
 
-  const vector<wstring>& original_tokens = WhiteSpaceTokenize(unicode_text);
-  vector<wstring> split_tokens;
-  for (wstring token : original_tokens) {
-    if (do_lower_case_) {
-      token = ToLower(token);
-      token = run_strip_accents(token);
+CharIdTable::CharIdTable(const Vocab& vocab) :
+  tables_(kAsciiSize + kCjkSize, kNotFound) {
+  ascii_ids_ = tables_.data();
+  cjk_ids_ = tables_.data() + kAsciiSize;
+  for (auto& v : vocab) {
+    if (v.first.size() != 1 || v.second >= kNotFound) continue;
+    const uint32_t c = static_cast<uint32_t>(v.first[0]);
+    const uint32_t id = static_cast<uint32_t>(v.second);
+    if (c < kAsciiSize) {
+      tables_[c] = id;
+    } else if (c - kCjkBegin < kCjkSize) {
+      tables_[kAsciiSize + c - kCjkBegin] = id;
+    } else {
+      other_ids_[v.first[0]] = id;
     }
-    const auto& tokens = run_split_on_punc(token);
-    split_tokens.insert(split_tokens.end(), tokens.begin(), tokens.end());
   }
-  return WhiteSpaceTokenize(boost::join(split_tokens, L" "));
+}
+
+CharIdTable::CharIdTable(const StaticVocab& vocab) :
+  ascii_ids_(vocab.data().ascii_ids),
+  cjk_ids_(vocab.data().cjk_ids),
+  static_vocab_(&vocab) {}
+
+uint32_t CharIdTable::find_other(wchar_t ch) const {
+  if (static_vocab_) {
+    const size_t id = static_vocab_->Find(std::wstring_view(&ch, 1));
+    return id < kNotFound ? static_cast<uint32_t>(id) : kNotFound;
+  }
+  auto iter = other_ids_.find(ch);
+  return iter != other_ids_.end() ? iter->second : kNotFound;
+}
+
+// The tables of a StaticVocab are not counted: they are shared pages of
+// the binary.
+size_t CharIdTable::EstimateMemoryUsage() const {
+  size_t node_bytes = sizeof(void*) + sizeof(wchar_t) + 2 * sizeof(uint32_t);
+  return tables_.size() * sizeof(uint32_t) +
+         other_ids_.bucket_count() * sizeof(void*) +
+         other_ids_.size() * node_bytes;
 }
 
 
 WordPieceTokenizer::WordPieceTokenizer(
-  const shared_ptr<Vocab>& vocab,
+  const shared_ptr<const Vocab>& vocab,
   const wstring& unk_token /* = L"[UNK]"*/,
   const size_t max_input_chars_per_word /* = 100 */) :
   vocab_(vocab),
   unk_token_(unk_token),
-  max_input_chars_per_word_(max_input_chars_per_word) {}
+  max_input_chars_per_word_(max_input_chars_per_word) {
+    for (auto& v : *vocab_) {
+      max_token_chars_ = max(max_token_chars_, v.first.size());
+    }
+  }
+
+WordPieceTokenizer::WordPieceTokenizer(
+  const StaticVocab* vocab,
+  const wstring& unk_token /* = L"[UNK]"*/,
+  const size_t max_input_chars_per_word /* = 100 */) :
+  static_vocab_(vocab),
+  unk_token_(unk_token),
+  max_input_chars_per_word_(max_input_chars_per_word),
+  max_token_chars_(vocab->data().max_token_chars) {}
+
+inline size_t WordPieceTokenizer::find_id(const wstring& token) const {
+  if (static_vocab_) {
+    const size_t id = static_vocab_->Find(token);
+    return id != StaticVocab::kNotFound ? id : kUnknownId;
+  }
+  auto iter = vocab_->find(token);
+  return iter != vocab_->end() ? iter->second : kUnknownId;
+}
+
+size_t WordPieceTokenizer::CountTokens(const wstring& text,
+                                       wstring* buffer) const {
+  // The words of BasicTokenizer have no whitespace.
+  if (text.find_first_of(kStripChars) != wstring::npos) {
+    return Tokenize(text).size();
+  }
+  if (text.size() > max_input_chars_per_word_) return 1;
+  size_t num_pieces = 0;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = min(text.size(), start + max_token_chars_);
+    bool found = false;
+    while (start < end) {
+      buffer->clear();
+      if (start > 0) buffer->append(L"##");
+      buffer->append(text, start, end - start);
+      if (find_id(*buffer) != kUnknownId) {
+        found = true;
+        break;
+      }
+      end--;
+    }
+    // The whole word becomes a single unknown token.
+    if (!found) return 1;
+    num_pieces++;
+    start = end;
+  }
+  return num_pieces;
+}
+
+void WordPieceTokenizer::TokenizePieces(const wstring& text,
+                                        wstring* buffer,
+                                        vector<Piece>* pieces) const {
+  pieces->clear();
+  // The words of BasicTokenizer have no whitespace; the pieces of other
+  // texts span the whole text.
+  if (text.find_first_of(kStripChars) != wstring::npos) {
+    for (auto& token : Tokenize(text)) {
+      const size_t id = token != unk_token_ ? find_id(token) : kUnknownId;
+      pieces->push_back({0, text.size(), id});
+    }
+    return;
+  }
+  if (text.size() > max_input_chars_per_word_) {
+    pieces->push_back({0, text.size(), kUnknownId});
+    return;
+  }
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = min(text.size(), start + max_token_chars_);
+    size_t id = kUnknownId;
+    while (start < end) {
+      buffer->clear();
+      if (start > 0) buffer->append(L"##");
+      buffer->append(text, start, end - start);
+      id = find_id(*buffer);
+      if (id != kUnknownId) break;
+      end--;
+    }
+    // The whole word becomes a single unknown token.
+    if (id == kUnknownId) {
+      pieces->clear();
+      pieces->push_back({0, text.size(), kUnknownId});
+      return;
+    }
+    pieces->push_back({start, end, id});
+    start = end;
+  }
+}
 
 vector<wstring> WordPieceTokenizer::Tokenize(
   const wstring& text) const {
@@ -299,18 +707,20 @@ vector<wstring> WordPieceTokenizer::Tokenize(
   for (auto& token : WhiteSpaceTokenize(text)) {
     if (token.size() > max_input_chars_per_word_) {
       output_tokens.push_back(unk_token_);
+      continue;
     }
     bool is_bad = false;
     size_t start = 0;
     vector<wstring> sub_tokens;
     while (start < token.size()) {
-      size_t end = token.size();
+      // No piece is longer than the longest token of the vocab.
+      size_t end = min(token.size(), start + max_token_chars_);
       wstring cur_sub_str;
       bool has_cur_sub_str = false;
       while (start < end) {
         wstring substr = token.substr(start, end - start);
         if (start > 0) substr = L"##" + substr;
-        if (vocab_->find(substr) != vocab_->end()) {
+        if (find_id(substr) != kUnknownId) {
           cur_sub_str = substr;
           has_cur_sub_str = true;
           break;
@@ -334,10 +744,12 @@ vector<wstring> WordPieceTokenizer::Tokenize(
 }
 
 FullTokenizer::FullTokenizer(const string& vocab_file, bool do_lower_case):
-  vocab_(LoadVocab(vocab_file)),
+  vocab_(VocabRegistry::Instance().GetVocab(vocab_file)),
+  inv_vocab_(VocabRegistry::Instance().GetInvVocab(vocab_)),
   basic_tokenizer_(BasicTokenizer(do_lower_case)),
   word_piece_tokenizer_(WordPieceTokenizer(vocab_)) {
-    for (auto& v : *vocab_) inv_vocab_[v.second] = v.first;
+    auto iter = vocab_->find(L"[UNK]");
+    if (iter != vocab_->end()) unk_token_id_ = iter->second;
 }
 
 vector<wstring> FullTokenizer::Tokenize(const string& text) const {
@@ -352,7 +764,8 @@ vector<size_t> FullTokenizer::ConvertTokensToIds(
     const vector<wstring>& text) const {
   vector<size_t> ret(text.size());
   for (size_t i = 0; i < text.size(); i++) {
-    ret[i] = (*vocab_)[text[i]];
+    auto iter = vocab_->find(text[i]);
+    ret[i] = iter != vocab_->end() ? iter->second : unk_token_id_;
   }
   return ret;
 }
@@ -368,8 +781,13 @@ BertTokenizer::BertTokenizer(
   const string& padding_site /* = "right" */) :
   do_lower_case_(do_lower_case),
   vocab_file_(vocab_file),
-  // vocab_: the map token_str to token_id
-  vocab_(LoadVocab(vocab_file)),
+  // vocab_: the map token_str to token_id, shared by all the tokenizers
+  // over the same vocab file.
+  vocab_(VocabRegistry::Instance().GetVocab(vocab_file)),
+  // inv_vocab_: the map token_id to token_str
+  inv_vocab_(VocabRegistry::Instance().GetInvVocab(vocab_)),
+  // char_ids_: the ids of the single character tokens
+  char_ids_(VocabRegistry::Instance().GetCharIdTable(vocab_)),
   unk_token_(unk_token),
   pad_token_(pad_token),
   cls_token_(cls_token),
@@ -378,45 +796,149 @@ BertTokenizer::BertTokenizer(
   padding_site_(padding_site),
   basic_tokenizer_(BasicTokenizer(do_lower_case_)),
   word_piece_tokenizer_(vocab_, unk_token) {
-    unk_token_id_ = (*vocab_)[unk_token_];
-    pad_token_id_ = (*vocab_)[pad_token_];
-    cls_token_id_ = (*vocab_)[cls_token_];
-    mask_token_id_ = (*vocab_)[mask_token_];
-    sep_token_id_ = (*vocab_)[sep_token_];
+    // A vocab file which repeats a token has ids past vocab_->size() - 1.
+    for (auto& entry : *vocab_) {
+      next_added_id_ = max(next_added_id_, entry.second + 1);
+    }
+    // The special tokens must not be split when they occur in the raw text.
+    // The ones missing from the vocab get ids after the last vocab id
+    // instead of being inserted into the shared vocab.
+    AddTokens({unk_token_, pad_token_, cls_token_, mask_token_, sep_token_},
+              true);
+    unk_token_id_ = token_to_id(unk_token_);
+    pad_token_id_ = token_to_id(pad_token_);
+    cls_token_id_ = token_to_id(cls_token_);
+    mask_token_id_ = token_to_id(mask_token_);
+    sep_token_id_ = token_to_id(sep_token_);
+  }
 
-    all_special_tokens_ = vector<wstring>(
-      {unk_token_, pad_token_, cls_token_, mask_token_, sep_token_});
-    all_special_token_ids_ = unordered_set<size_t>(
-      {unk_token_id_,
-      pad_token_id_,
-      cls_token_id_,
-      mask_token_id_,
-      sep_token_id_});
+BertTokenizer::BertTokenizer(
+  const StaticVocab& vocab,
+  bool do_lower_case /* = true */,
+  const wstring& unk_token /* = L"[UNK]" */,
+  const wstring& pad_token /* = L"[PAD]" */,
+  const wstring& cls_token /* = L"[CLS]" */,
+  const wstring& mask_token /* = L"[MASK]" */,
+  const wstring& sep_token /* = L"[SEP]" */,
+  const string& padding_site /* = "right" */) :
+  static_vocab_(&vocab),
+  char_ids_(std::make_shared<CharIdTable>(vocab)),
+  do_lower_case_(do_lower_case),
+  basic_tokenizer_(BasicTokenizer(do_lower_case_)),
+  word_piece_tokenizer_(&vocab, unk_token),
+  unk_token_(unk_token),
+  cls_token_(cls_token),
+  mask_token_(mask_token),
+  pad_token_(pad_token),
+  sep_token_(sep_token),
+  padding_site_(padding_site) {
+    next_added_id_ = vocab.NumIds();
+    AddTokens({unk_token_, pad_token_, cls_token_, mask_token_, sep_token_},
+              true);
+    unk_token_id_ = token_to_id(unk_token_);
+    pad_token_id_ = token_to_id(pad_token_);
+    cls_token_id_ = token_to_id(cls_token_);
+    mask_token_id_ = token_to_id(mask_token_);
+    sep_token_id_ = token_to_id(sep_token_);
+  }
+
+size_t BertTokenizer::vocab_id(const wstring& token) const {
+  if (static_vocab_) {
+    const size_t id = static_vocab_->Find(token);
+    return id != StaticVocab::kNotFound ? id : WordPieceTokenizer::kUnknownId;
+  }
+  auto iter = vocab_->find(token);
+  return iter != vocab_->end() ? iter->second : WordPieceTokenizer::kUnknownId;
+}
+
+size_t BertTokenizer::vocab_size() const {
+  return static_vocab_ ? static_vocab_->size() : vocab_->size();
+}
+
+bool BertTokenizer::vocab_token(size_t id, wstring* token) const {
+  if (static_vocab_) {
+    if (!static_vocab_->HasId(id)) return false;
+    *token = ConvertStrToWstr(string(static_vocab_->Token(id)));
+    return true;
+  }
+  auto iter = inv_vocab_->find(id);
+  if (iter == inv_vocab_->end()) return false;
+  *token = iter->second;
+  return true;
+}
 
-    // inv_vocab_: the map token_id to token_str
-    for (auto& v : *vocab_) inv_vocab_[v.second] = v.first;
+size_t BertTokenizer::AddTokens(
+  const vector<wstring>& tokens,
+  bool special_tokens /* = false */) {
+    size_t num_added = 0;
+    for (auto& token : tokens) {
+      if (token.empty()) continue;
+      size_t token_id = vocab_id(token);
+      auto added_iter = added_vocab_.find(token);
+      if (token_id != WordPieceTokenizer::kUnknownId) {
+        // A vocab token keeps its id.
+      } else if (added_iter != added_vocab_.end()) {
+        token_id = added_iter->second;
+      } else {
+        token_id = next_added_id_++;
+        added_vocab_[token] = token_id;
+        added_inv_vocab_[token_id] = token;
+        num_added++;
+      }
+      if (special_tokens &&
+          all_special_token_ids_.find(token_id) ==
+          all_special_token_ids_.end()) {
+        all_special_tokens_.push_back(token);
+        all_special_token_ids_.insert(token_id);
+      }
+      if (std::find(added_tokens_.begin(), added_tokens_.end(), token) ==
+          added_tokens_.end()) {
+        added_tokens_.push_back(token);
+        added_token_ids_.push_back(token_id);
+      }
+    }
+    rebuild_added_tokens_matcher();
+    return num_added;
   }
 
+void BertTokenizer::SetNormalizedFastPath(bool enable) {
+  normalized_fast_path_ = enable;
+}
+
+void BertTokenizer::rebuild_added_tokens_matcher() {
+  vector<string> patterns;
+  patterns.reserve(added_tokens_.size());
+  for (auto& token : added_tokens_) {
+    patterns.push_back(ConvertWstrToStr(token));
+  }
+  added_tokens_matcher_.Build(patterns);
+}
+
+size_t BertTokenizer::token_to_id(const wstring& token) const {
+  const size_t id = vocab_id(token);
+  if (id != WordPieceTokenizer::kUnknownId) return id;
+  auto added_iter = added_vocab_.find(token);
+  if (added_iter != added_vocab_.end()) return added_iter->second;
+  return unk_token_id_;
+}
+
 vector<size_t> BertTokenizer::ConvertTokensToIds(
   const vector<wstring>& tokens) const {
     vector<size_t> token_ids(tokens.size());
     for (size_t i = 0; i < token_ids.size(); ++i) {
-      auto iter = (*vocab_).find(tokens[i]);
-      if (iter != (*vocab_).end()) {
-        token_ids[i] = iter->second;
-      } else {
-        token_ids[i] = unk_token_id_;
-      }
+      token_ids[i] = token_to_id(tokens[i]);
     }
     return token_ids;
   }
 
 vector<wstring> BertTokenizer::ConvertIdsToTokens(
-  const vector<size_t>& token_ids) {
+  const vector<size_t>& token_ids) const {
     vector<wstring> text(token_ids.size());
     for (size_t i = 0; i < token_ids.size(); ++i) {
-      const size_t id = token_ids[i];
-      text[i] = inv_vocab_[id];
+      if (vocab_token(token_ids[i], &text[i])) continue;
+      auto added_iter = added_inv_vocab_.find(token_ids[i]);
+      text[i] = added_iter != added_inv_vocab_.end() ? added_iter->second :
+                                                       unk_token_;
     }
     return text;
   }
@@ -427,15 +949,279 @@ string BertTokenizer::ConvertTokensToString(
     return text;
   }
 
-vector<wstring> BertTokenizer::Tokenize(
+vector<wstring> BertTokenizer::tokenize_segment(
   const string& text) const {
+    vector<wstring> words;
+    WordCollector collector(&words);
+    basic_tokenize(text, &collector);
     vector<wstring> split_tokens;
-    for (auto& token : basic_tokenizer_.Tokenize(text))
+    for (auto& token : words)
       for (auto& sub_token : word_piece_tokenizer_.Tokenize(token))
         split_tokens.push_back(sub_token);
     return split_tokens;
   }
 
+class BertTokenizer::IdCollector : public WordVisitor {
+ public:
+  // With ids == nullptr, the tokens are only counted. word_starts, if not
+  // null, receives the index of the first id of every word.
+  IdCollector(const BertTokenizer* tokenizer,
+              vector<size_t>* ids,
+              size_t max_tokens,
+              vector<size_t>* word_starts = nullptr) :
+    tokenizer_(tokenizer), ids_(ids), max_tokens_(max_tokens),
+    word_starts_(word_starts) {
+      if (word_starts_) word_starts_->clear();
+    }
+
+  // The count may go past max_tokens by the pieces of the last word.
+  bool Full() const { return num_tokens_ >= max_tokens_; }
+  size_t NumTokens() const { return num_tokens_; }
+
+  // The stats the tokenization adds to, or nullptr.
+  NormalizedStats* Stats() const { return stats_; }
+  void SetStats(NormalizedStats* stats) { stats_ = stats; }
+
+  void AddId(size_t id) {
+    if (ids_) ids_->push_back(id);
+    num_tokens_++;
+  }
+
+  // Adds an added token, which is a word of its own.
+  void AddWord(size_t id) {
+    start_word();
+    AddId(id);
+  }
+
+  bool OnWord(const wstring& word, size_t /*begin*/, size_t /*end*/) override {
+    if (!ids_) {
+      num_tokens_ += tokenizer_->word_piece_tokenizer_.CountTokens(
+        word, &piece_buffer_);
+      return !Full();
+    }
+    start_word();
+    // The vocab lookup of every piece gives its id; no token is built.
+    tokenizer_->word_piece_tokenizer_.TokenizePieces(word, &piece_buffer_,
+                                                     &pieces_);
+    for (auto& piece : pieces_) {
+      AddId(piece.id != WordPieceTokenizer::kUnknownId ?
+            piece.id : tokenizer_->unk_token_id_);
+    }
+    return !Full();
+  }
+
+  // A single character word is a vocab token or unknown; it never needs
+  // WordPiece.
+  bool OnChar(wchar_t ch, size_t /*begin*/, size_t /*end*/) override {
+    if (!ids_) {
+      num_tokens_++;
+      return !Full();
+    }
+    start_word();
+    const uint32_t id = tokenizer_->char_ids_->Find(ch);
+    AddId(id != CharIdTable::kNotFound ? id : tokenizer_->unk_token_id_);
+    return !Full();
+  }
+
+ private:
+  void start_word() {
+    if (word_starts_) word_starts_->push_back(num_tokens_);
+  }
+
+  const BertTokenizer* tokenizer_;
+  vector<size_t>* ids_;
+  size_t max_tokens_;
+  vector<size_t>* word_starts_;
+  NormalizedStats* stats_{nullptr};
+  size_t num_tokens_{0};
+  wstring piece_buffer_;
+  vector<WordPieceTokenizer::Piece> pieces_;
+};
+
+class BertTokenizer::SpanCollector : public WordVisitor {
+ public:
+  SpanCollector(const BertTokenizer* tokenizer,
+                string_view text,
+                TokenSpans* output) :
+    tokenizer_(tokenizer), text_(text), output_(output) {}
+
+  // The words of the next segment come with offsets from base.
+  void SetBase(size_t base) { base_ = base; }
+
+  void AddSpan(size_t begin, size_t end, size_t id, uint32_t flags) {
+    output_->spans.push_back({static_cast<uint32_t>(begin),
+                              static_cast<uint32_t>(end),
+                              static_cast<uint32_t>(id), flags});
+  }
+
+  bool OnWord(const wstring& word, size_t begin, size_t end) override {
+    // The pieces point into the text if the word is the text unchanged.
+    utf8_.clear();
+    char_ends_.clear();
+    for (auto& ch : word) {
+      AppendUtf8(static_cast<uint32_t>(ch), &utf8_);
+      char_ends_.push_back(utf8_.size());
+    }
+    size_t origin = base_ + begin;
+    uint32_t flags = 0;
+    if (text_.substr(base_ + begin, end - begin) != utf8_) {
+      origin = output_->normalized.size();
+      output_->normalized += utf8_;
+      flags = TokenSpan::kNormalized;
+    }
+    tokenizer_->word_piece_tokenizer_.TokenizePieces(word, &piece_buffer_,
+                                                     &pieces_);
+    for (auto& piece : pieces_) {
+      const size_t piece_begin =
+        piece.begin > 0 ? char_ends_[piece.begin - 1] : 0;
+      const size_t piece_end = piece.end > 0 ? char_ends_[piece.end - 1] : 0;
+      uint32_t piece_flags = flags;
+      if (piece.begin > 0) piece_flags |= TokenSpan::kContinuation;
+      size_t id = piece.id;
+      if (id == WordPieceTokenizer::kUnknownId) {
+        id = tokenizer_->unk_token_id_;
+        piece_flags |= TokenSpan::kUnknown;
+      }
+      AddSpan(origin + piece_begin, origin + piece_end, id, piece_flags);
+    }
+    return true;
+  }
+
+  bool OnChar(wchar_t ch, size_t begin, size_t end) override {
+    const uint32_t id = tokenizer_->char_ids_->Find(ch);
+    if (id == CharIdTable::kNotFound) {
+      AddSpan(base_ + begin, base_ + end, tokenizer_->unk_token_id_,
+              TokenSpan::kUnknown);
+    } else {
+      AddSpan(base_ + begin, base_ + end, id, 0);
+    }
+    return true;
+  }
+
+ private:
+  const BertTokenizer* tokenizer_;
+  string_view text_;
+  TokenSpans* output_;
+  size_t base_{0};
+  string utf8_;
+  // The byte offset in utf8_ after every character of the word.
+  vector<size_t> char_ends_;
+  wstring piece_buffer_;
+  vector<WordPieceTokenizer::Piece> pieces_;
+};
+
+void BertTokenizer::tokenize_segment_ids(
+  string_view text, IdCollector* collector) const {
+    if (collector->Full()) return;
+    basic_tokenize(text, collector, collector->Stats());
+  }
+
+void BertTokenizer::count_malformed(size_t num_malformed) const {
+  if (num_malformed > 0) {
+    num_malformed_utf8_.fetch_add(num_malformed, std::memory_order_relaxed);
+  }
+}
+
+void BertTokenizer::basic_tokenize(
+  string_view text,
+  WordVisitor* visitor,
+  NormalizedStats* stats /* = nullptr */) const {
+  if (normalized_fast_path_ && !text.empty()) {
+    if (stats) stats->checks++;
+    if (basic_tokenizer_.IsNormalized(text)) {
+      if (stats) stats->fast_paths++;
+      basic_tokenizer_.TokenizeNormalized(text, visitor);
+      return;
+    }
+  }
+  count_malformed(basic_tokenizer_.Tokenize(text, visitor));
+}
+
+BertTokenizer::Diagnostics BertTokenizer::GetDiagnostics() const {
+  Diagnostics diagnostics;
+  diagnostics.malformed_utf8_sequences =
+    num_malformed_utf8_.load(std::memory_order_relaxed);
+  diagnostics.failed_truncations =
+    num_failed_truncations_.load(std::memory_order_relaxed);
+  return diagnostics;
+}
+
+vector<wstring> BertTokenizer::Tokenize(
+  const string& text) const {
+    // Locate the added tokens in the raw text first, so that only the text
+    // between them goes through the basic and wordpiece tokenizers.
+    vector<AhoCorasick::Match> matches;
+    added_tokens_matcher_.FindAll(text, &matches);
+    if (matches.empty()) return tokenize_segment(text);
+
+    vector<wstring> split_tokens;
+    size_t pos = 0;
+    for (auto& match : matches) {
+      const auto& tokens = tokenize_segment(
+        text.substr(pos, match.begin - pos));
+      split_tokens.insert(split_tokens.end(), tokens.begin(), tokens.end());
+      split_tokens.push_back(added_tokens_[match.pattern_id]);
+      pos = match.end;
+    }
+    const auto& tokens = tokenize_segment(text.substr(pos));
+    split_tokens.insert(split_tokens.end(), tokens.begin(), tokens.end());
+    return split_tokens;
+  }
+
+void BertTokenizer::TokenizeSpans(string_view text,
+                                  TokenSpans* output) const {
+    if (text.size() > std::numeric_limits<uint32_t>::max()) {
+      throw runtime_error("TokenizeSpans takes texts of less than 4GB.");
+    }
+    output->spans.clear();
+    output->normalized.clear();
+    SpanCollector collector(this, text, output);
+    vector<AhoCorasick::Match> matches;
+    added_tokens_matcher_.FindAll(text.data(), text.size(), &matches);
+    size_t pos = 0;
+    for (auto& match : matches) {
+      collector.SetBase(pos);
+      basic_tokenize(text.substr(pos, match.begin - pos), &collector);
+      collector.AddSpan(match.begin, match.end,
+                        added_token_ids_[match.pattern_id],
+                        TokenSpan::kAddedToken);
+      pos = match.end;
+    }
+    collector.SetBase(pos);
+    basic_tokenize(text.substr(pos), &collector);
+  }
+
+size_t BertTokenizer::FindStableCut(string_view text,
+                                    size_t begin,
+                                    size_t end) const {
+    // An added token starting before the cut must be complete in text,
+    // otherwise appending to text could extend it across the cut.
+    const size_t max_pattern_size = added_tokens_matcher_.MaxPatternSize();
+    if (max_pattern_size > 0) {
+      if (text.size() + 1 < begin + max_pattern_size) return begin;
+      end = min(end, text.size() + 1 - max_pattern_size);
+    }
+    if (end <= begin) return begin;
+    size_t cut = basic_tokenizer_.FindStableCut(text, begin, end);
+    if (max_pattern_size == 0 || cut == begin) return cut;
+
+    // The cut can not be inside an added token either. The matches are
+    // ordered and do not overlap, so walking them backwards only moves the
+    // cut to the left.
+    vector<AhoCorasick::Match> matches;
+    const size_t scan_end = min(text.size(), end - 1 + max_pattern_size);
+    added_tokens_matcher_.FindAll(text.data() + begin, scan_end - begin,
+                                  &matches);
+    for (size_t i = matches.size(); i > 0 && cut > begin; --i) {
+      const size_t match_begin = begin + matches[i - 1].begin;
+      const size_t match_end = begin + matches[i - 1].end;
+      if (match_begin < cut && cut < match_end) {
+        cut = basic_tokenizer_.FindStableCut(text, begin, match_begin);
+      }
+    }
+    return cut;
+  }
+
 
 vector<size_t> BertTokenizer::BuildInputsWithSpecialTokens(
   const vector<size_t>& token_ids_0,
@@ -463,6 +1249,10 @@ vector<size_t> BertTokenizer::BuildInputsWithSpecialTokens(
     }
   }
 
+size_t BertTokenizer::GetVocabSize() const {
+  return next_added_id_;
+}
+
 size_t BertTokenizer::GetNumSpecialTokensToAdd(const bool pair) const {
     if (pair) {
       return 3;
@@ -503,7 +1293,11 @@ unordered_map<string, vector<size_t>> BertTokenizer::TruncateSequence(
     }
 
     size_t window_len;
-    if (truncation_strategy == "longest_first") {
+    if (truncation_strategy == "longest_first" &&
+        ids->size() + pair_ids->size() <
+        static_cast<size_t>(num_tokens_to_remove)) {
+      num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
+    } else if (truncation_strategy == "longest_first") {
       for (size_t i = 0; i < num_tokens_to_remove; i++) {
         if ((pair_ids->size() == 0) || (ids->size() > pair_ids->size())) {
           if (overflowing_token_ids.size() == 0) {
@@ -543,16 +1337,10 @@ unordered_map<string, vector<size_t>> BertTokenizer::TruncateSequence(
           ids->pop_back();
         }
       } else {
-        cerr << "We need to remove {num_tokens_to_remove} "
-          "to truncate the input but the first sequence has a length "
-          << ids->size()
-          << ". Please select another truncation strategy than "
-          << truncation_strategy
-          <<", for instance \'longest_first\' or \'only_second\'."
-          << endl;
+        num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
       }
     } else if (
-      truncation_strategy == "only_second" && pair_ids->size()== 0) {
+      truncation_strategy == "only_second" && pair_ids->size() != 0) {
         if (pair_ids->size() > num_tokens_to_remove) {
           window_len = min(pair_ids->size(), stride + num_tokens_to_remove);
           for (size_t i = pair_ids->size()-1;
@@ -564,13 +1352,7 @@ unordered_map<string, vector<size_t>> BertTokenizer::TruncateSequence(
             pair_ids->pop_back();
           }
         } else {
-          cerr << "We need to remove " << num_tokens_to_remove
-            << " to truncate the input but the first sequence has a length "
-            << ids->size()
-            << ". Please select another truncation strategy than "
-            << truncation_strategy
-            << ", for instance \'longest_first\' or \'only_first\'."
-            << endl;
+          num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
         }
       }
     res["ids"] = (*ids);
@@ -596,7 +1378,11 @@ void BertTokenizer::TruncateSequence(
   }
 
   size_t window_len;
-  if (truncation_strategy == "longest_first") {
+  if (truncation_strategy == "longest_first" &&
+      ids->size() + pair_ids->size() <
+      static_cast<size_t>(num_tokens_to_remove)) {
+    num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
+  } else if (truncation_strategy == "longest_first") {
     for (size_t i = 0; i < num_tokens_to_remove; i++) {
       if ((pair_ids->size() == 0) || (ids->size() > pair_ids->size())) {
         if (overflowing_token_ids.size() == 0) {
@@ -636,16 +1422,10 @@ void BertTokenizer::TruncateSequence(
         ids->pop_back();
       }
     } else {
-      cerr << "We need to remove {num_tokens_to_remove} "
-        "to truncate the input but the first sequence has a length "
-        << ids->size()
-        << ". Please select another truncation strategy than "
-        << truncation_strategy
-        <<", for instance \'longest_first\' or \'only_second\'."
-        << endl;
+      num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
     }
   } else if (
-    truncation_strategy == "only_second" && pair_ids->size()== 0) {
+    truncation_strategy == "only_second" && pair_ids->size() != 0) {
       if (pair_ids->size() > num_tokens_to_remove) {
         window_len = min(pair_ids->size(), stride + num_tokens_to_remove);
         for (size_t i = pair_ids->size()-1;
@@ -657,13 +1437,7 @@ void BertTokenizer::TruncateSequence(
           pair_ids->pop_back();
         }
       } else {
-        cerr << "We need to remove " << num_tokens_to_remove
-          << " to truncate the input but the first sequence has a length "
-          << ids->size()
-          << ". Please select another truncation strategy than "
-          << truncation_strategy
-          << ", for instance \'longest_first\' or \'only_first\'."
-          << endl;
+        num_failed_truncations_.fetch_add(1, std::memory_order_relaxed);
       }
     }
   (*res)["ids"] = *ids;
@@ -684,7 +1458,7 @@ vector<size_t> BertTokenizer::GetSpecialTokensMask(
       }
       vector<size_t> res(token_ids_0.size());
       for (size_t i = 0; i < res.size(); i++) {
-        auto&& iter = find(all_special_token_ids_.begin(),
+        auto&& iter = std::find(all_special_token_ids_.begin(),
                         all_special_token_ids_.end(),
                         token_ids_0[i]);
         if (iter != all_special_token_ids_.end()) {
@@ -711,12 +1485,265 @@ vector<size_t> BertTokenizer::GetSpecialTokensMask(
     }
   }
 
-vector<size_t> BertTokenizer::get_input_ids(const string& text) const {
-  vector<wstring> tokens = Tokenize(text);
-  vector<size_t> token_ids = ConvertTokensToIds(tokens);
+size_t BertTokenizer::CountTokens(
+  const string& text,
+  size_t max_count /* = kNoTokenLimit */) const {
+  IdCollector counter(this, nullptr, max_count);
+  collect_ids(text, max_count, &counter);
+  return min(counter.NumTokens(), max_count);
+}
+
+vector<size_t> BertTokenizer::CountTokens(
+  const vector<string>& texts,
+  size_t max_count /* = kNoTokenLimit */) const {
+    vector<size_t> counts(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i) {
+      counts[i] = CountTokens(texts[i], max_count);
+    }
+    return counts;
+  }
+
+vector<size_t> BertTokenizer::TokenizeToIds(string_view text) const {
+  return get_input_ids(text);
+}
+
+vector<size_t> BertTokenizer::TokenizeToIds(
+  string_view text, const TokenizeLimits& limits) const {
+    if (text.size() > limits.max_bytes) {
+      throw runtime_error("The text has " + std::to_string(text.size()) +
+                          " bytes, more than the limit of " +
+                          std::to_string(limits.max_bytes) + ".");
+    }
+    return get_input_ids(text, limits.max_tokens);
+  }
+
+vector<size_t> BertTokenizer::TokenizeToIds(string_view text,
+                                            NormalizedStats* stats) const {
+  *stats = NormalizedStats();
+  vector<size_t> token_ids;
+  IdCollector collector(this, &token_ids, kNoTokenLimit);
+  collector.SetStats(stats);
+  collect_ids(text, kNoTokenLimit, &collector);
   return token_ids;
 }
 
+class PreTokenizedCollector : public WordVisitor {
+ public:
+  // The tokenization stops once there are min_words words.
+  PreTokenizedCollector(PreTokenizedText* output, size_t min_words) :
+    output_(output), min_words_(min_words) {}
+
+  bool Full() const { return output_->words.size() >= min_words_; }
+
+  // The words of the next segment come with offsets from base.
+  void SetBase(size_t base) { base_ = base; }
+
+  void AddWord(PreTokenizedText::Kind kind, size_t char_begin,
+               size_t char_end, size_t byte_begin, size_t byte_end) {
+    output_->words.push_back({kind, char_begin, char_end,
+                              base_ + byte_begin, base_ + byte_end});
+  }
+
+  bool OnWord(const wstring& word, size_t begin, size_t end) override {
+    const size_t char_begin = output_->chars.size();
+    output_->chars += word;
+    AddWord(PreTokenizedText::kWord, char_begin, output_->chars.size(),
+            begin, end);
+    return !Full();
+  }
+
+  bool OnChar(wchar_t ch, size_t begin, size_t end) override {
+    output_->chars.push_back(ch);
+    AddWord(PreTokenizedText::kChar, output_->chars.size() - 1,
+            output_->chars.size(), begin, end);
+    return !Full();
+  }
+
+ private:
+  PreTokenizedText* output_;
+  size_t min_words_;
+  size_t base_{0};
+};
+
+void BertTokenizer::PreTokenize(string_view text,
+                                PreTokenizedText* output) const {
+  PreTokenize(text, kNoTokenLimit, output);
+}
+
+void BertTokenizer::PreTokenize(string_view text,
+                                size_t min_words,
+                                PreTokenizedText* output) const {
+  output->words.clear();
+  output->chars.clear();
+  PreTokenizedCollector collector(output, min_words);
+  vector<AhoCorasick::Match> matches;
+  // Growing windows cut at stable cuts, as in collect_ids.
+  size_t window = 1024;
+  size_t pos = 0;
+  while (pos < text.size() && !collector.Full()) {
+    size_t end = text.size();
+    if (min_words != kNoTokenLimit && end - pos > window) {
+      end = FindStableCut(text, pos, pos + window);
+      window *= 2;
+      if (end == pos) continue;
+    }
+    const string_view segment = text.substr(pos, end - pos);
+    added_tokens_matcher_.FindAll(segment.data(), segment.size(), &matches);
+    size_t begin = 0;
+    for (auto& match : matches) {
+      collector.SetBase(pos + begin);
+      basic_tokenize(segment.substr(begin, match.begin - begin), &collector);
+      if (collector.Full()) return;
+      collector.SetBase(pos);
+      collector.AddWord(PreTokenizedText::kAddedToken, match.pattern_id,
+                        match.pattern_id, match.begin, match.end);
+      begin = match.end;
+    }
+    collector.SetBase(pos + begin);
+    basic_tokenize(segment.substr(begin), &collector);
+    pos = end;
+  }
+}
+
+void BertTokenizer::ConvertPreTokenizedToIds(const PreTokenizedText& text,
+                                             vector<size_t>* ids) const {
+  ids->clear();
+  ids->reserve(text.words.size());
+  wstring word;
+  wstring piece_buffer;
+  vector<WordPieceTokenizer::Piece> pieces;
+  for (auto& w : text.words) {
+    if (w.kind == PreTokenizedText::kAddedToken) {
+      ids->push_back(added_token_ids_[w.char_begin]);
+    } else if (w.kind == PreTokenizedText::kChar) {
+      const uint32_t id = char_ids_->Find(text.chars[w.char_begin]);
+      ids->push_back(id != CharIdTable::kNotFound ? id : unk_token_id_);
+    } else {
+      word.assign(text.chars, w.char_begin, w.char_end - w.char_begin);
+      word_piece_tokenizer_.TokenizePieces(word, &piece_buffer, &pieces);
+      for (auto& piece : pieces) {
+        ids->push_back(piece.id != WordPieceTokenizer::kUnknownId ?
+                       piece.id : unk_token_id_);
+      }
+    }
+  }
+}
+
+bool BertTokenizer::SharesPreTokenization(const BertTokenizer& other) const {
+  return do_lower_case_ == other.do_lower_case_ &&
+         added_tokens_ == other.added_tokens_;
+}
+
+vector<size_t> BertTokenizer::get_input_ids(
+  string_view text,
+  size_t max_tokens,
+  vector<size_t>* word_starts /* = nullptr */) const {
+    vector<size_t> token_ids;
+    IdCollector collector(this, &token_ids, max_tokens, word_starts);
+    collect_ids(text, max_tokens, &collector);
+    if (token_ids.size() > max_tokens) {
+      token_ids.resize(max_tokens);
+      if (word_starts) {
+        while (!word_starts->empty() && word_starts->back() >= max_tokens) {
+          word_starts->pop_back();
+        }
+      }
+    }
+    return token_ids;
+  }
+
+void BertTokenizer::collect_ids(string_view text,
+                                size_t max_tokens,
+                                IdCollector* collector) const {
+  // The first window of a limited tokenization; it doubles every step, so
+  // the text scanned stays proportional to the text tokenized.
+  const size_t kFirstWindowBytes = 1024;
+  vector<AhoCorasick::Match> matches;
+  size_t pos = 0;
+  size_t window = kFirstWindowBytes;
+  while (pos < text.size() && !collector->Full()) {
+    size_t end = text.size();
+    if (max_tokens != kNoTokenLimit && end - pos > window) {
+      end = basic_tokenizer_.FindStableCut(text, pos, pos + window);
+      window *= 2;
+      if (end == pos) continue;
+    }
+    // Every added token starting before end is complete in the scanned
+    // bytes, so the matches before end are the ones of the whole text.
+    size_t scan_end = text.size();
+    if (end < text.size() && added_tokens_matcher_.MaxPatternSize() > 0) {
+      scan_end = min(scan_end, end + added_tokens_matcher_.MaxPatternSize());
+    }
+    added_tokens_matcher_.FindAll(text.data() + pos, scan_end - pos, &matches);
+
+    // The added tokens map to their ids directly.
+    const size_t base = pos;
+    for (auto& match : matches) {
+      if (base + match.begin >= end) break;
+      tokenize_segment_ids(text.substr(pos, base + match.begin - pos),
+                           collector);
+      if (collector->Full()) break;
+      collector->AddWord(added_token_ids_[match.pattern_id]);
+      pos = base + match.end;
+      end = max(end, pos);
+    }
+    tokenize_segment_ids(text.substr(pos, end - pos), collector);
+    pos = end;
+  }
+}
+
+void BertTokenizer::get_bounded_input_ids(
+  const string& text,
+  const string& text_pair,
+  const int max_seq_len,
+  const string& truncation_strategy,
+  bool return_overflowing_tokens,
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids,
+  vector<size_t>* word_starts /* = nullptr */,
+  vector<size_t>* pair_word_starts /* = nullptr */) const {
+    auto text_ids = [&](size_t max_tokens) {
+      *ids = get_input_ids(text, max_tokens, word_starts);
+    };
+    auto pair_text_ids = [&](size_t max_tokens) {
+      if (text_pair != "") {
+        *pair_ids = get_input_ids(text_pair, max_tokens, pair_word_starts);
+      }
+    };
+    ids->clear();
+    pair_ids->clear();
+    if (pair_word_starts) pair_word_starts->clear();
+    // The budgets below are the lengths TruncateSequence leaves, which
+    // only depend on the lengths of the sequences up to these budgets.
+    // The degenerate cases, where the special tokens alone do not fit, go
+    // through the full path.
+    const size_t max_len = max_seq_len > 0 ? max_seq_len : 0;
+    const bool bounded = max_seq_len > 0 && !return_overflowing_tokens;
+    if (bounded && truncation_strategy == "longest_first" &&
+        max_len > GetNumSpecialTokensToAdd(true)) {
+      // Neither sequence keeps more than the whole budget.
+      pair_text_ids(max_len - GetNumSpecialTokensToAdd(true));
+      text_ids(max_len - GetNumSpecialTokensToAdd(!pair_ids->empty()));
+      return;
+    }
+    if (bounded && truncation_strategy == "only_first") {
+      pair_text_ids(kNoTokenLimit);
+      const size_t fixed_len =
+        pair_ids->size() + GetNumSpecialTokensToAdd(!pair_ids->empty());
+      text_ids(max_len > fixed_len ? max_len - fixed_len : kNoTokenLimit);
+      return;
+    }
+    if (bounded && truncation_strategy == "only_second" && text_pair != "") {
+      text_ids(kNoTokenLimit);
+      const size_t fixed_len = ids->size() + GetNumSpecialTokensToAdd(true);
+      pair_text_ids(
+        max_len > fixed_len ? max_len - fixed_len : kNoTokenLimit);
+      return;
+    }
+    text_ids(kNoTokenLimit);
+    pair_text_ids(kNoTokenLimit);
+  }
+
 unordered_map<string, vector<size_t>> BertTokenizer::Encode(
   const string& text,
   const string& text_pair /* = "" */,
@@ -729,12 +1756,10 @@ unordered_map<string, vector<size_t>> BertTokenizer::Encode(
   const string&  truncation_strategy /* = "longest_first" */,
   bool return_overflowing_tokens /* = false */,
   bool return_special_tokens_mask /* = false */) const {
-    vector<size_t> ids = get_input_ids(text);
+    vector<size_t> ids;
     vector<size_t> pair_ids;
-    if (text_pair != "") {
-      vector<size_t> res = get_input_ids(text_pair);
-      pair_ids.swap(res);
-    }
+    get_bounded_input_ids(text, text_pair, max_seq_len, truncation_strategy,
+                          return_overflowing_tokens, &ids, &pair_ids);
 
     bool pair = false;
     if (pair_ids.size() != 0) {
@@ -754,7 +1779,8 @@ unordered_map<string, vector<size_t>> BertTokenizer::Encode(
     if (max_seq_len > 0  && total_len > max_seq_len) {
       auto&& res = TruncateSequence(
         &ids, &pair_ids, total_len - max_seq_len, truncation_strategy);
-      if (res.find("overflowing_token_ids") != res.end()) {
+      if (return_overflowing_tokens &&
+          res.find("overflowing_token_ids") != res.end()) {
         encoded_inputs["overflowing_token_ids"] = res["overflowing_token_ids"];
         encoded_inputs["num_truncated_tokens"] = vector<size_t>(
           1, total_len - max_seq_len);
@@ -887,12 +1913,10 @@ void BertTokenizer::Encode(
   const string&  truncation_strategy /* = "longest_first" */,
   bool return_overflowing_tokens /* = false */,
   bool return_special_tokens_mask /* = false */) const {
-  vector<size_t> ids = get_input_ids(text);
+  vector<size_t> ids;
   vector<size_t> pair_ids;
-  if (text_pair != "") {
-    vector<size_t> res = get_input_ids(text_pair);
-    pair_ids.swap(res);
-  }
+  get_bounded_input_ids(text, text_pair, max_seq_len, truncation_strategy,
+                        return_overflowing_tokens, &ids, &pair_ids);
 
   bool pair = false;
   if (pair_ids.size() != 0) {
@@ -909,11 +1933,12 @@ void BertTokenizer::Encode(
   // then we truncate it.
   size_t total_len = len_ids + len_pair_ids + GetNumSpecialTokensToAdd(pair);
   if (max_seq_len > 0  && total_len > max_seq_len) {
-    unordered_map<string, vector<size_t>>* res;
+    unordered_map<string, vector<size_t>> res;
     TruncateSequence(
-      res, &ids, &pair_ids, total_len - max_seq_len, truncation_strategy);
-    if (res->find("overflowing_token_ids") != res->end()) {
-      (*output)["overflowing_token_ids"] = (*res)["overflowing_token_ids"];
+      &res, &ids, &pair_ids, total_len - max_seq_len, truncation_strategy);
+    if (return_overflowing_tokens &&
+        res.find("overflowing_token_ids") != res.end()) {
+      (*output)["overflowing_token_ids"] = res["overflowing_token_ids"];
       (*output)["num_truncated_tokens"] = vector<size_t>(
         1, total_len - max_seq_len);
     }
@@ -1030,6 +2055,465 @@ void BertTokenizer::Encode(
   }
 }
 
+void BertTokenizer::EncodeInto(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<int64_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    encode_into(texts, text_pairs, max_seq_len, buffers, seq_lens,
+                truncation_strategy);
+  }
+
+void BertTokenizer::EncodeInto(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<int32_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    encode_into(texts, text_pairs, max_seq_len, buffers, seq_lens,
+                truncation_strategy);
+  }
+
+template <typename T>
+void BertTokenizer::encode_into(
+  const vector<string>& texts,
+  const vector<string>& text_pairs,
+  const int max_seq_len,
+  const EncodeBuffers<T>& buffers,
+  vector<size_t>* seq_lens,
+  const string& truncation_strategy) const {
+    if (max_seq_len <= 0) {
+      throw runtime_error("EncodeInto needs a positive max_seq_len.");
+    }
+    if (!text_pairs.empty() && text_pairs.size() != texts.size()) {
+      throw runtime_error(
+        "The number of text pairs should be the same as the texts.");
+    }
+    if (seq_lens) seq_lens->resize(texts.size());
+
+    const string no_pair;
+    vector<size_t> ids;
+    vector<size_t> pair_ids;
+    for (size_t i = 0; i < texts.size(); ++i) {
+      const string& text_pair = text_pairs.empty() ? no_pair : text_pairs[i];
+      get_bounded_input_ids(texts[i], text_pair, max_seq_len,
+                            truncation_strategy, false, &ids, &pair_ids);
+      const size_t total_len =
+        truncate_ids(max_seq_len, truncation_strategy, &ids, &pair_ids);
+      if (seq_lens) (*seq_lens)[i] = total_len;
+      write_padded_row(ids, pair_ids, max_seq_len, buffers, i);
+    }
+  }
+
+size_t BertTokenizer::EncodeIdsInto(
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids,
+  const int max_seq_len,
+  const EncodeBuffers<int64_t>& buffers,
+  size_t i,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    return encode_ids_into(ids, pair_ids, max_seq_len, buffers, i,
+                           truncation_strategy);
+  }
+
+size_t BertTokenizer::EncodeIdsInto(
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids,
+  const int max_seq_len,
+  const EncodeBuffers<int32_t>& buffers,
+  size_t i,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    return encode_ids_into(ids, pair_ids, max_seq_len, buffers, i,
+                           truncation_strategy);
+  }
+
+template <typename T>
+size_t BertTokenizer::encode_ids_into(
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids,
+  const int max_seq_len,
+  const EncodeBuffers<T>& buffers,
+  size_t i,
+  const string& truncation_strategy) const {
+    if (max_seq_len <= 0) {
+      throw runtime_error("EncodeIdsInto needs a positive max_seq_len.");
+    }
+    const size_t total_len =
+      truncate_ids(max_seq_len, truncation_strategy, ids, pair_ids);
+    write_padded_row(*ids, *pair_ids, max_seq_len, buffers, i);
+    return total_len;
+  }
+
+size_t BertTokenizer::truncate_ids(
+  const int max_seq_len,
+  const string& truncation_strategy,
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids) const {
+    size_t total_len = ids->size() + pair_ids->size() +
+                       GetNumSpecialTokensToAdd(!pair_ids->empty());
+    if (max_seq_len <= 0) return total_len;
+    const size_t max_len = max_seq_len;
+    if (total_len > max_len) {
+      unordered_map<string, vector<size_t>> res;
+      TruncateSequence(&res, ids, pair_ids, total_len - max_len,
+                       truncation_strategy);
+      // Like BuildInputsWithSpecialTokens, a pair truncated to nothing is
+      // left out with its separator.
+      total_len = ids->size() + pair_ids->size() +
+                  GetNumSpecialTokensToAdd(!pair_ids->empty());
+    }
+    if (total_len > max_len) {
+      throw runtime_error(
+        "There is something wrong with the input sequence length."
+        " Please check it.");
+    }
+    return total_len;
+  }
+
+template <typename T>
+void BertTokenizer::write_padded_row(
+  const vector<size_t>& ids,
+  const vector<size_t>& pair_ids,
+  size_t width,
+  const EncodeBuffers<T>& buffers,
+  size_t i) const {
+    auto row = [width, i](T* data, size_t stride) {
+      return data + i * (stride != 0 ? stride : width);
+    };
+    const T pad_id = static_cast<T>(pad_token_id_);
+    const size_t total_len = ids.size() + pair_ids.size() +
+                             GetNumSpecialTokensToAdd(!pair_ids.empty());
+    // The tokens take the columns [begin, end) of the row.
+    const size_t begin = padding_site_ == "left" ? width - total_len : 0;
+    const size_t end = begin + total_len;
+    const size_t first_len = ids.size() + 2;
+    if (buffers.input_ids) {
+      T* out = row(buffers.input_ids, buffers.input_ids_stride);
+      std::fill(out, out + begin, pad_id);
+      T* p = out + begin;
+      *p++ = static_cast<T>(cls_token_id_);
+      for (auto& id : ids) *p++ = static_cast<T>(id);
+      *p++ = static_cast<T>(sep_token_id_);
+      if (!pair_ids.empty()) {
+        for (auto& id : pair_ids) *p++ = static_cast<T>(id);
+        *p++ = static_cast<T>(sep_token_id_);
+      }
+      std::fill(out + end, out + width, pad_id);
+    }
+    if (buffers.token_type_ids) {
+      T* out = row(buffers.token_type_ids, buffers.token_type_ids_stride);
+      std::fill(out, out + begin, pad_id);
+      std::fill(out + begin, out + begin + first_len, 0);
+      std::fill(out + begin + first_len, out + end, 1);
+      std::fill(out + end, out + width, pad_id);
+    }
+    if (buffers.attention_mask) {
+      T* out = row(buffers.attention_mask, buffers.attention_mask_stride);
+      std::fill(out, out + begin, 0);
+      std::fill(out + begin, out + end, 1);
+      std::fill(out + end, out + width, 0);
+    }
+    if (buffers.position_ids) {
+      T* out = row(buffers.position_ids, buffers.position_ids_stride);
+      for (size_t k = 0; k < width; ++k) out[k] = static_cast<T>(k);
+    }
+  }
+
+
+void BertTokenizer::get_bounded_pair_ids(
+  const vector<size_t>& text_ids,
+  const string& text_pair,
+  const int max_seq_len,
+  const string& truncation_strategy,
+  vector<size_t>* ids,
+  vector<size_t>* pair_ids) const {
+    // Mirrors get_bounded_input_ids: the prefix of text_ids stands in for
+    // get_input_ids(text, limit).
+    auto prefix = [&text_ids, ids](size_t limit) {
+      ids->assign(text_ids.begin(),
+                  text_ids.begin() + min(limit, text_ids.size()));
+    };
+    ids->clear();
+    pair_ids->clear();
+    const size_t max_len = max_seq_len > 0 ? max_seq_len : 0;
+    const bool bounded = max_seq_len > 0;
+    if (bounded && truncation_strategy == "longest_first" &&
+        max_len > GetNumSpecialTokensToAdd(true)) {
+      if (text_pair != "") {
+        *pair_ids = get_input_ids(
+          text_pair, max_len - GetNumSpecialTokensToAdd(true));
+      }
+      prefix(max_len - GetNumSpecialTokensToAdd(!pair_ids->empty()));
+      return;
+    }
+    if (bounded && truncation_strategy == "only_first") {
+      if (text_pair != "") *pair_ids = get_input_ids(text_pair);
+      const size_t fixed_len =
+        pair_ids->size() + GetNumSpecialTokensToAdd(!pair_ids->empty());
+      prefix(max_len > fixed_len ? max_len - fixed_len : kNoTokenLimit);
+      return;
+    }
+    if (bounded && truncation_strategy == "only_second" && text_pair != "") {
+      *ids = text_ids;
+      const size_t fixed_len = ids->size() + GetNumSpecialTokensToAdd(true);
+      *pair_ids = get_input_ids(
+        text_pair, max_len > fixed_len ? max_len - fixed_len : kNoTokenLimit);
+      return;
+    }
+    *ids = text_ids;
+    if (text_pair != "") *pair_ids = get_input_ids(text_pair);
+  }
+
+void BertTokenizer::encode_pair_ids(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  const string& truncation_strategy,
+  size_t num_threads,
+  vector<vector<size_t>>* ids,
+  vector<vector<size_t>>* pair_ids) const {
+    const vector<size_t>& query_ids = get_input_ids(query);
+    ids->assign(passages.size(), vector<size_t>());
+    pair_ids->assign(passages.size(), vector<size_t>());
+    if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+    num_threads = max<size_t>(1, min(num_threads, passages.size()));
+
+    // The passages are handed out one at a time, so a few long ones do
+    // not hold up a thread with a fixed share. The first failing pair
+    // decides the exception, as in a loop over Encode.
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    size_t error_index = passages.size();
+    std::exception_ptr error;
+    auto work = [&]() {
+      for (size_t i = next++; i < passages.size(); i = next++) {
+        try {
+          get_bounded_pair_ids(query_ids, passages[i], max_seq_len,
+                               truncation_strategy, &(*ids)[i],
+                               &(*pair_ids)[i]);
+          truncate_ids(max_seq_len, truncation_strategy, &(*ids)[i],
+                       &(*pair_ids)[i]);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (i < error_index) {
+            error_index = i;
+            error = std::current_exception();
+          }
+        }
+      }
+    };
+    vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; ++t) threads.emplace_back(work);
+    work();
+    for (auto& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+  }
+
+template <typename T>
+void BertTokenizer::encode_pairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  const EncodeBuffers<T>& buffers,
+  vector<size_t>* seq_lens,
+  const string& truncation_strategy,
+  size_t num_threads) const {
+    if (max_seq_len <= 0) {
+      throw runtime_error("EncodePairs needs a positive max_seq_len.");
+    }
+    vector<vector<size_t>> ids;
+    vector<vector<size_t>> pair_ids;
+    encode_pair_ids(query, passages, max_seq_len, truncation_strategy,
+                    num_threads, &ids, &pair_ids);
+    if (seq_lens) seq_lens->resize(passages.size());
+    for (size_t i = 0; i < passages.size(); ++i) {
+      if (seq_lens) {
+        (*seq_lens)[i] = ids[i].size() + pair_ids[i].size() +
+                         GetNumSpecialTokensToAdd(!pair_ids[i].empty());
+      }
+      write_padded_row(ids[i], pair_ids[i], max_seq_len, buffers, i);
+    }
+  }
+
+template <typename T>
+void BertTokenizer::encode_pairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  RaggedEncoding<T>* output,
+  const string& truncation_strategy,
+  size_t num_threads) const {
+    vector<vector<size_t>> ids;
+    vector<vector<size_t>> pair_ids;
+    encode_pair_ids(query, passages, max_seq_len, truncation_strategy,
+                    num_threads, &ids, &pair_ids);
+    output->row_offsets.assign(1, 0);
+    for (size_t i = 0; i < passages.size(); ++i) {
+      output->row_offsets.push_back(
+        output->row_offsets.back() + ids[i].size() + pair_ids[i].size() +
+        GetNumSpecialTokensToAdd(!pair_ids[i].empty()));
+    }
+    output->input_ids.resize(output->row_offsets.back());
+    output->token_type_ids.resize(output->row_offsets.back());
+    for (size_t i = 0; i < passages.size(); ++i) {
+      T* p = output->input_ids.data() + output->row_offsets[i];
+      *p++ = static_cast<T>(cls_token_id_);
+      for (auto& id : ids[i]) *p++ = static_cast<T>(id);
+      *p++ = static_cast<T>(sep_token_id_);
+      if (!pair_ids[i].empty()) {
+        for (auto& id : pair_ids[i]) *p++ = static_cast<T>(id);
+        *p++ = static_cast<T>(sep_token_id_);
+      }
+      T* types = output->token_type_ids.data() + output->row_offsets[i];
+      const size_t first_len = ids[i].size() + 2;
+      const size_t row_len =
+        output->row_offsets[i + 1] - output->row_offsets[i];
+      std::fill(types, types + first_len, 0);
+      std::fill(types + first_len, types + row_len, 1);
+    }
+  }
+
+void BertTokenizer::EncodePairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  const EncodeBuffers<int64_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */,
+  size_t num_threads /* = 0 */) const {
+    encode_pairs(query, passages, max_seq_len, buffers, seq_lens,
+                 truncation_strategy, num_threads);
+  }
+
+void BertTokenizer::EncodePairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  const EncodeBuffers<int32_t>& buffers,
+  vector<size_t>* seq_lens /* = nullptr */,
+  const string& truncation_strategy /* = "longest_first" */,
+  size_t num_threads /* = 0 */) const {
+    encode_pairs(query, passages, max_seq_len, buffers, seq_lens,
+                 truncation_strategy, num_threads);
+  }
+
+void BertTokenizer::EncodePairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  RaggedEncoding<int64_t>* output,
+  const string& truncation_strategy /* = "longest_first" */,
+  size_t num_threads /* = 0 */) const {
+    encode_pairs(query, passages, max_seq_len, output, truncation_strategy,
+                 num_threads);
+  }
+
+void BertTokenizer::EncodePairs(
+  const string& query,
+  const vector<string>& passages,
+  const int max_seq_len,
+  RaggedEncoding<int32_t>* output,
+  const string& truncation_strategy /* = "longest_first" */,
+  size_t num_threads /* = 0 */) const {
+    encode_pairs(query, passages, max_seq_len, output, truncation_strategy,
+                 num_threads);
+  }
+
+void BertTokenizer::EncodeMasked(
+  const string& text,
+  const string& text_pair,
+  const int max_seq_len,
+  const MaskingOptions& options,
+  uint64_t seed,
+  MaskedEncoding* output,
+  const string& truncation_strategy /* = "longest_first" */) const {
+    vector<size_t> ids;
+    vector<size_t> pair_ids;
+    vector<size_t> word_starts;
+    vector<size_t> pair_word_starts;
+    get_bounded_input_ids(text, text_pair, max_seq_len, truncation_strategy,
+                          false, &ids, &pair_ids, &word_starts,
+                          &pair_word_starts);
+    truncate_ids(max_seq_len, truncation_strategy, &ids, &pair_ids);
+
+    vector<size_t>& input_ids = output->input_ids;
+    input_ids.clear();
+    input_ids.push_back(cls_token_id_);
+    input_ids.insert(input_ids.end(), ids.begin(), ids.end());
+    input_ids.push_back(sep_token_id_);
+    output->token_type_ids.assign(input_ids.size(), 0);
+    if (!pair_ids.empty()) {
+      input_ids.insert(input_ids.end(), pair_ids.begin(), pair_ids.end());
+      input_ids.push_back(sep_token_id_);
+      output->token_type_ids.resize(input_ids.size(), 1);
+    }
+
+    // The words as [begin, end) of input_ids. The truncation may have cut
+    // the last words of a sequence short.
+    vector<std::pair<size_t, size_t>> words;
+    size_t num_candidates = 0;
+    auto add_words = [&](const vector<size_t>& starts, size_t num_ids,
+                         size_t offset) {
+      for (size_t k = 0; k < starts.size() && starts[k] < num_ids; ++k) {
+        const size_t end =
+          k + 1 < starts.size() ? min(starts[k + 1], num_ids) : num_ids;
+        if (end == starts[k]) continue;
+        if (end - starts[k] == 1 &&
+            all_special_token_ids_.count(input_ids[offset + starts[k]])) {
+          continue;
+        }
+        words.emplace_back(offset + starts[k], offset + end);
+        num_candidates += end - starts[k];
+      }
+    };
+    add_words(word_starts, ids.size(), 1);
+    if (!pair_ids.empty()) {
+      add_words(pair_word_starts, pair_ids.size(), ids.size() + 2);
+    }
+
+    // Only the raw output of mt19937_64 is fixed by the standard, so the
+    // draws below do not use the std distributions.
+    std::mt19937_64 rng(seed);
+    auto uniform = [&rng]() {
+      return (rng() >> 11) * (1.0 / 9007199254740992.0);
+    };
+    for (size_t k = words.size(); k > 1; --k) {
+      std::swap(words[k - 1], words[rng() % k]);
+    }
+    size_t num_to_predict = 0;
+    if (num_candidates > 0 && options.masking_rate > 0) {
+      num_to_predict = std::llround(num_candidates * options.masking_rate);
+      num_to_predict = min(options.max_predictions,
+                           max<size_t>(1, num_to_predict));
+    }
+    vector<size_t>& positions = output->masked_positions;
+    positions.clear();
+    for (auto& word : words) {
+      if (positions.size() >= num_to_predict) break;
+      if (positions.size() + word.second - word.first > num_to_predict) {
+        continue;
+      }
+      for (size_t pos = word.first; pos < word.second; ++pos) {
+        positions.push_back(pos);
+      }
+    }
+    std::sort(positions.begin(), positions.end());
+
+    output->labels.clear();
+    for (auto& pos : positions) {
+      output->labels.push_back(input_ids[pos]);
+      const double r = uniform();
+      if (r < options.mask_prob) {
+        input_ids[pos] = mask_token_id_;
+      } else if (r < options.mask_prob + options.random_prob) {
+        input_ids[pos] = rng() % vocab_size();
+      }
+    }
+  }
 
 int main() {
   BertTokenizer* tokenizer_ptr = nullptr;
@@ -1071,6 +2555,11 @@ int main() {
   string pair = "梁思成问林徽因：“你上看这座教堂，有什么感觉？” ";
   cout << "line " << line.size() << endl;
   cout << "pair " << pair.size() << endl;
+  const VocabRegistry::Stats stats = VocabRegistry::Instance().GetStats();
+  cout << "vocabs " << stats.num_vocabs << " loads " << stats.num_loads
+       << " hits " << stats.num_hits << " vocab bytes " << stats.vocab_bytes
+       << " inv vocab bytes " << stats.inv_vocab_bytes
+       << " char ids bytes " << stats.char_ids_bytes << endl;
   int idx = 0;
   auto start = std::chrono::system_clock::now();
   while (idx < 10000) {
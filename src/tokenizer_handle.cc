@@ -0,0 +1,165 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "paddlenlp/tokenizer_handle.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::wstring;
+
+
+namespace {
+
+struct CachedSnapshot {
+  uint64_t handle_id = 0;
+  uint64_t version = 0;
+  shared_ptr<const BertTokenizer> tokenizer;
+};
+
+// Each thread caches the snapshot of a few handles, picked by handle id.
+// Handles which share a slot just reload more often.
+constexpr size_t kNumCachedSnapshots = 8;
+thread_local CachedSnapshot cached_snapshots[kNumCachedSnapshots];
+
+std::atomic<uint64_t> next_handle_id(1);
+
+}  // namespace
+
+
+TokenizerHandle::TokenizerHandle(shared_ptr<const BertTokenizer> tokenizer) :
+  id_(next_handle_id.fetch_add(1, std::memory_order_relaxed)),
+  tokenizer_(std::move(tokenizer)) {
+  if (!tokenizer_) {
+    throw runtime_error("TokenizerHandle needs a tokenizer to start with.");
+  }
+}
+
+const shared_ptr<const BertTokenizer>& TokenizerHandle::cached() const {
+  CachedSnapshot& cached = cached_snapshots[id_ % kNumCachedSnapshots];
+  // The version is read before the pointer: if a Publish slips in between,
+  // the newer pointer is cached with the older version and reloaded by the
+  // next call.
+  const uint64_t version = version_.load(std::memory_order_acquire);
+  if (cached.handle_id != id_ || cached.version != version) {
+    cached.tokenizer =
+      std::atomic_load_explicit(&tokenizer_, std::memory_order_acquire);
+    cached.handle_id = id_;
+    cached.version = version;
+  }
+  return cached.tokenizer;
+}
+
+shared_ptr<const BertTokenizer> TokenizerHandle::Get() const {
+  return cached();
+}
+
+void TokenizerHandle::Publish(shared_ptr<const BertTokenizer> tokenizer) {
+  if (!tokenizer) {
+    throw runtime_error("Can not publish an empty tokenizer.");
+  }
+  auto previous = std::atomic_exchange_explicit(
+    &tokenizer_, std::move(tokenizer), std::memory_order_acq_rel);
+  version_.fetch_add(1, std::memory_order_release);
+  {
+    lock_guard<mutex> lock(retired_mutex_);
+    retired_.push_back(std::move(previous));
+  }
+  Reclaim();
+}
+
+size_t TokenizerHandle::Reclaim() {
+  // The drained snapshots are destroyed after the lock is released.
+  vector<shared_ptr<const BertTokenizer>> drained;
+  lock_guard<mutex> lock(retired_mutex_);
+  // A retired snapshot can not be acquired again, so once its use count
+  // drops to one, retired_ holds the last reference.
+  for (size_t i = 0; i < retired_.size();) {
+    if (retired_[i].use_count() == 1) {
+      drained.push_back(std::move(retired_[i]));
+      retired_[i] = std::move(retired_.back());
+      retired_.pop_back();
+    } else {
+      ++i;
+    }
+  }
+  return retired_.size();
+}
+
+std::future<void> TokenizerHandle::ReloadAsync(Factory factory) {
+  return std::async(std::launch::async, [this, factory]() {
+    Publish(factory());
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::seconds(1);
+    while (Reclaim() > 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+}
+
+std::future<void> TokenizerHandle::ReloadAsync(
+  const string& vocab_file,
+  bool do_lower_case /* = true */,
+  const wstring& unk_token /* = L"[UNK]" */,
+  const wstring& pad_token /* = L"[PAD]" */,
+  const wstring& cls_token /* = L"[CLS]" */,
+  const wstring& mask_token /* = L"[MASK]" */,
+  const wstring& sep_token /* = L"[SEP]" */,
+  const string& padding_site /* = "right" */) {
+  return ReloadAsync([=]() {
+    return std::make_shared<const BertTokenizer>(
+      vocab_file, do_lower_case, unk_token, pad_token, cls_token, mask_token,
+      sep_token, padding_site);
+  });
+}
+
+uint64_t TokenizerHandle::Version() const {
+  return version_.load(std::memory_order_relaxed);
+}
+
+vector<wstring> TokenizerHandle::Tokenize(const string& text) const {
+  return cached()->Tokenize(text);
+}
+
+unordered_map<string, vector<size_t>> TokenizerHandle::Encode(
+  const string& text,
+  const string& text_pair /* = "" */,
+  const int max_seq_len /* = -1 */,
+  bool pad_to_max_seq_len /* = false */,
+  bool return_length /* = false */,
+  bool return_token_type_ids /* = true */,
+  bool return_position_ids /* = false */,
+  bool return_attention_mask /* = false */,
+  const string&  truncation_strategy /* = "longest_first" */,
+  bool return_overflowing_tokens /* = false */,
+  bool return_special_tokens_mask /* = false */) const {
+  return cached()->Encode(text, text_pair, max_seq_len, pad_to_max_seq_len,
+                          return_length, return_token_type_ids,
+                          return_position_ids, return_attention_mask,
+                          truncation_strategy, return_overflowing_tokens,
+                          return_special_tokens_mask);
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddlenlp/tokenizer_session.h"
+
+
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::wstring;
+
+
+TokenizerSession::TokenizerSession(shared_ptr<const BertTokenizer> tokenizer) :
+  tokenizer_(std::move(tokenizer)) {
+  if (!tokenizer_) {
+    throw runtime_error("TokenizerSession needs a tokenizer.");
+  }
+}
+
+void TokenizerSession::Append(const string& chunk, Delta* delta) {
+  const size_t old_size = text_.size();
+  text_ += chunk;
+  // The tail is tokenized in two parts split at its last stable cut, which
+  // gives the same tokens and tells how many of them become final.
+  size_t cut = stable_end_;
+  vector<wstring> tail;
+  vector<wstring> rest;
+  try {
+    cut = tokenizer_->FindStableCut(text_, stable_end_, text_.size());
+    tail = tokenizer_->Tokenize(text_.substr(stable_end_, cut - stable_end_));
+    rest = tokenizer_->Tokenize(text_.substr(cut));
+  }
+  catch (...) {
+    text_.resize(old_size);
+    throw;
+  }
+  const size_t num_final = tail.size();
+  tail.insert(tail.end(), rest.begin(), rest.end());
+
+  // Only the tokens after the common prefix of the old and new tail change.
+  size_t same = 0;
+  while (num_stable_tokens_ + same < tokens_.size() && same < tail.size() &&
+         tokens_[num_stable_tokens_ + same] == tail[same]) {
+    same++;
+  }
+  const size_t keep = num_stable_tokens_ + same;
+  const vector<wstring> added(tail.begin() + same, tail.end());
+  const vector<size_t>& added_ids = tokenizer_->ConvertTokensToIds(added);
+  if (delta) {
+    delta->num_removed = tokens_.size() - keep;
+    delta->tokens = added;
+    delta->ids = added_ids;
+  }
+  tokens_.resize(keep);
+  tokens_.insert(tokens_.end(), added.begin(), added.end());
+  ids_.resize(keep);
+  ids_.insert(ids_.end(), added_ids.begin(), added_ids.end());
+  stable_end_ = cut;
+  num_stable_tokens_ += num_final;
+}
+
+void TokenizerSession::Reset() {
+  text_.clear();
+  tokens_.clear();
+  ids_.clear();
+  stable_end_ = 0;
+  num_stable_tokens_ = 0;
+}
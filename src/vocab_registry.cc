@@ -0,0 +1,186 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "paddlenlp/vocab_registry.h"
+
+
+using std::ifstream;
+using std::istringstream;
+using std::lock_guard;
+using std::mutex;
+using std::ostringstream;
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+
+
+namespace {
+
+// 64-bit FNV-1a.
+uint64_t HashContent(const string& content) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char& c : content) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// The heap bytes used by a string beyond the string object itself.
+size_t HeapBytes(const wstring& s) {
+  static const size_t kInlineCapacity = wstring().capacity();
+  if (s.capacity() <= kInlineCapacity) return 0;
+  return (s.capacity() + 1) * sizeof(wchar_t);
+}
+
+// The node layout of libstdc++ and libc++: the next pointer, the value and
+// the cached hash code.
+template <typename Map>
+size_t TableBytes(const Map& map) {
+  size_t node_bytes = sizeof(void*) + sizeof(typename Map::value_type) +
+                      sizeof(size_t);
+  return map.bucket_count() * sizeof(void*) + map.size() * node_bytes;
+}
+
+}  // namespace
+
+
+VocabRegistry& VocabRegistry::Instance() {
+  static VocabRegistry registry;
+  return registry;
+}
+
+size_t VocabRegistry::EstimateMemoryUsage(const Vocab& vocab) {
+  size_t bytes = TableBytes(vocab);
+  for (auto& v : vocab) bytes += HeapBytes(v.first);
+  return bytes;
+}
+
+size_t VocabRegistry::EstimateMemoryUsage(const InvVocab& inv_vocab) {
+  size_t bytes = TableBytes(inv_vocab);
+  for (auto& v : inv_vocab) bytes += HeapBytes(v.second);
+  return bytes;
+}
+
+shared_ptr<const Vocab> VocabRegistry::GetVocab(const string& vocab_file) {
+  ifstream ifs(vocab_file, ifstream::in | ifstream::binary);
+  if (!ifs) {
+    throw runtime_error(
+      "Open the vocab file failly, please check the file " + vocab_file + ".");
+  }
+  ostringstream content;
+  content << ifs.rdbuf();
+  ifs.close();
+  const string& data = content.str();
+  const string key = vocab_file + '\0' + std::to_string(HashContent(data));
+
+  // Parse under the lock, so that the tokenizers created concurrently over
+  // the same file do not parse it twice.
+  lock_guard<mutex> lock(mutex_);
+  Entry& entry = entries_[key];
+  shared_ptr<const Vocab> vocab = entry.vocab.lock();
+  if (vocab) {
+    num_hits_++;
+    return vocab;
+  }
+  istringstream is(data);
+  vocab = ParseVocab(&is);
+  entry.vocab = vocab;
+  entry.inv_vocab.reset();
+  entry.char_ids.reset();
+  entry.num_tokens = vocab->size();
+  entry.vocab_bytes = EstimateMemoryUsage(*vocab);
+  entry.inv_vocab_bytes = 0;
+  entry.char_ids_bytes = 0;
+  num_loads_++;
+  prune_entries();
+  return vocab;
+}
+
+shared_ptr<const InvVocab> VocabRegistry::GetInvVocab(
+  const shared_ptr<const Vocab>& vocab) {
+  lock_guard<mutex> lock(mutex_);
+  Entry* owner = find_entry(vocab);
+  shared_ptr<const InvVocab> inv_vocab;
+  if (owner) inv_vocab = owner->inv_vocab.lock();
+  if (inv_vocab) return inv_vocab;
+
+  shared_ptr<InvVocab> built(new InvVocab);
+  built->reserve(vocab->size());
+  for (auto& v : *vocab) (*built)[v.second] = v.first;
+  if (owner) {
+    owner->inv_vocab = built;
+    owner->inv_vocab_bytes = EstimateMemoryUsage(*built);
+  }
+  return built;
+}
+
+shared_ptr<const CharIdTable> VocabRegistry::GetCharIdTable(
+  const shared_ptr<const Vocab>& vocab) {
+  lock_guard<mutex> lock(mutex_);
+  Entry* owner = find_entry(vocab);
+  shared_ptr<const CharIdTable> char_ids;
+  if (owner) char_ids = owner->char_ids.lock();
+  if (char_ids) return char_ids;
+
+  char_ids.reset(new CharIdTable(*vocab));
+  if (owner) {
+    owner->char_ids = char_ids;
+    owner->char_ids_bytes = char_ids->EstimateMemoryUsage();
+  }
+  return char_ids;
+}
+
+VocabRegistry::Stats VocabRegistry::GetStats() const {
+  lock_guard<mutex> lock(mutex_);
+  Stats stats;
+  for (auto& entry : entries_) {
+    if (entry.second.vocab.expired()) continue;
+    stats.num_vocabs++;
+    stats.num_tokens += entry.second.num_tokens;
+    stats.vocab_bytes += entry.second.vocab_bytes;
+    if (!entry.second.inv_vocab.expired()) {
+      stats.inv_vocab_bytes += entry.second.inv_vocab_bytes;
+    }
+    if (!entry.second.char_ids.expired()) {
+      stats.char_ids_bytes += entry.second.char_ids_bytes;
+    }
+  }
+  stats.num_loads = num_loads_;
+  stats.num_hits = num_hits_;
+  return stats;
+}
+
+VocabRegistry::Entry* VocabRegistry::find_entry(
+  const shared_ptr<const Vocab>& vocab) {
+  for (auto& entry : entries_) {
+    if (entry.second.vocab.lock() == vocab) return &entry.second;
+  }
+  return nullptr;
+}
+
+void VocabRegistry::prune_entries() {
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    if (iter->second.vocab.expired()) {
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
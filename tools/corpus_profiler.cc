@@ -0,0 +1,569 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Profiles corpora with one text (or, with --pairs, a tab separated text
+// and pair) per line, to pick max_seq_len, bucket boundaries and cache
+// sizes. Prints JSON with the token length histograms of the texts, pairs
+// and examples (with the special tokens), the UNK rate, the share of
+// examples truncated at every limit, the most frequent tokens and the
+// share of time spent in every stage.
+//
+// The files are cut into chunks at line boundaries; the threads take the
+// chunks one by one and keep their own counters, which are merged at the
+// end. The stage times are measured on a sample of the texts, so the
+// profile runs at close to the tokenization throughput.
+//
+// Usage: corpus_profiler <vocab_file> <corpus_file>... [--threads=N]
+//          [--limits=128,256,512] [--pairs] [--cased] [--top=100]
+//          [--sample=64] [--output=profile.json]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "paddlenlp/tokenizer.h"
+#include "paddlenlp/utf8.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::string;
+using std::string_view;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+using std::wstring;
+
+
+const size_t kChunkBytes = 16 << 20;
+const size_t kReadBytes = 1 << 20;
+// Lengths from kMaxHistogramLength on share the last bin.
+const size_t kMaxHistogramLength = 8192;
+
+struct Options {
+  string vocab_file;
+  vector<string> corpus_files;
+  size_t num_threads{0};
+  vector<size_t> limits{64, 128, 256, 384, 512};
+  bool pairs{false};
+  bool do_lower_case{true};
+  size_t top{100};
+  // One text in every sample_every gets its stages timed.
+  size_t sample_every{64};
+  string output;
+};
+
+// The bytes [begin, end) of a file; both are line starts.
+struct Chunk {
+  size_t file;
+  uint64_t begin;
+  uint64_t end;
+};
+
+enum Stage {
+  kRead = 0,
+  kPreTokenize,
+  kWordPiece,
+  kStats,
+  kNumStages
+};
+const char* kStageNames[kNumStages] = {
+  "read", "pre_tokenize", "wordpiece_and_ids", "stats"};
+
+class Histogram {
+ public:
+  Histogram() : counts_(kMaxHistogramLength + 1, 0) {}
+
+  void Add(size_t length) {
+    counts_[std::min(length, kMaxHistogramLength)]++;
+    num_++;
+    sum_ += length;
+    max_ = std::max(max_, length);
+  }
+
+  void Merge(const Histogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+    num_ += other.num_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t Num() const { return num_; }
+
+  // The share of the lengths greater than limit.
+  double ShareAbove(size_t limit) const {
+    if (num_ == 0) return 0;
+    uint64_t above = 0;
+    for (size_t i = limit + 1; i < counts_.size(); ++i) above += counts_[i];
+    return static_cast<double>(above) / num_;
+  }
+
+  size_t Percentile(double p) const {
+    const uint64_t rank = static_cast<uint64_t>(p * num_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen > rank) return i;
+    }
+    return max_;
+  }
+
+  // Bins of bin_width lengths up to the longest one.
+  void WriteJson(std::ostream* out, size_t bin_width) const {
+    *out << "{\"count\": " << num_ << ", \"mean\": "
+         << (num_ ? static_cast<double>(sum_) / num_ : 0.0)
+         << ", \"max\": " << max_;
+    for (double p : {0.5, 0.9, 0.95, 0.99, 0.999}) {
+      *out << ", \"p" << p * 100 << "\": " << Percentile(p);
+    }
+    *out << ", \"bin_width\": " << bin_width << ", \"bins\": [";
+    const size_t last = std::min(max_, kMaxHistogramLength);
+    for (size_t begin = 0; begin <= last; begin += bin_width) {
+      uint64_t count = 0;
+      for (size_t i = begin; i < begin + bin_width && i <= last; ++i) {
+        count += counts_[i];
+      }
+      *out << (begin ? ", " : "") << count;
+    }
+    *out << "]}";
+  }
+
+ private:
+  vector<uint64_t> counts_;
+  uint64_t num_{0};
+  uint64_t sum_{0};
+  size_t max_{0};
+};
+
+// The counters of one thread.
+struct Profile {
+  Histogram text_lengths;
+  Histogram pair_lengths;
+  Histogram example_lengths;
+  vector<uint64_t> token_counts;
+  uint64_t num_tokens{0};
+  uint64_t num_unk_tokens{0};
+  uint64_t num_texts_with_unk{0};
+  uint64_t num_bytes{0};
+  double stage_seconds[kNumStages] = {0};
+  // The tokenization time of the sampled texts and of all texts.
+  double sampled_seconds{0};
+  double tokenize_seconds{0};
+
+  void Merge(const Profile& other) {
+    text_lengths.Merge(other.text_lengths);
+    pair_lengths.Merge(other.pair_lengths);
+    example_lengths.Merge(other.example_lengths);
+    if (token_counts.size() < other.token_counts.size()) {
+      token_counts.resize(other.token_counts.size(), 0);
+    }
+    for (size_t i = 0; i < other.token_counts.size(); ++i) {
+      token_counts[i] += other.token_counts[i];
+    }
+    num_tokens += other.num_tokens;
+    num_unk_tokens += other.num_unk_tokens;
+    num_texts_with_unk += other.num_texts_with_unk;
+    num_bytes += other.num_bytes;
+    for (int i = 0; i < kNumStages; ++i) {
+      stage_seconds[i] += other.stage_seconds[i];
+    }
+    sampled_seconds += other.sampled_seconds;
+    tokenize_seconds += other.tokenize_seconds;
+  }
+};
+
+// Counts the words only; times the pre-tokenization alone.
+class WordCounter : public WordVisitor {
+ public:
+  bool OnWord(const wstring& /*word*/,
+              size_t /*begin*/,
+              size_t /*end*/) override {
+    num_words_++;
+    return true;
+  }
+  bool OnChar(wchar_t /*ch*/, size_t /*begin*/, size_t /*end*/) override {
+    num_words_++;
+    return true;
+  }
+  size_t NumWords() const { return num_words_; }
+
+ private:
+  size_t num_words_{0};
+};
+
+double Seconds(std::chrono::steady_clock::time_point begin,
+               std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+class Profiler {
+ public:
+  Profiler(const Options& options, const BertTokenizer* tokenizer) :
+    options_(options), tokenizer_(tokenizer),
+    basic_tokenizer_(options.do_lower_case),
+    unk_id_(tokenizer->ConvertTokensToIds({L"[UNK]"})[0]) {}
+
+  void ProfileChunk(const Chunk& chunk, Profile* profile) {
+    std::ifstream file(options_.corpus_files[chunk.file], std::ios::binary);
+    file.seekg(chunk.begin);
+    string buffer;
+    string line;
+    uint64_t pos = chunk.begin;
+    while (pos < chunk.end) {
+      auto begin = std::chrono::steady_clock::now();
+      buffer.resize(std::min<uint64_t>(kReadBytes, chunk.end - pos));
+      file.read(&buffer[0], buffer.size());
+      buffer.resize(file.gcount());
+      profile->stage_seconds[kRead] +=
+        Seconds(begin, std::chrono::steady_clock::now());
+      if (buffer.empty()) break;
+      pos += buffer.size();
+      profile->num_bytes += buffer.size();
+
+      size_t line_begin = 0;
+      while (true) {
+        const size_t line_end = buffer.find('\n', line_begin);
+        if (line_end == string::npos) {
+          line.append(buffer, line_begin, string::npos);
+          break;
+        }
+        if (line.empty()) {
+          ProfileLine(string_view(buffer).substr(line_begin,
+                                                 line_end - line_begin),
+                      profile);
+        } else {
+          line.append(buffer, line_begin, line_end - line_begin);
+          ProfileLine(line, profile);
+          line.clear();
+        }
+        line_begin = line_end + 1;
+      }
+    }
+    if (!line.empty()) ProfileLine(line, profile);
+  }
+
+ private:
+  void ProfileLine(string_view line, Profile* profile) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    if (line.empty()) return;
+    string_view text = line;
+    string_view pair;
+    if (options_.pairs) {
+      const size_t tab = line.find('\t');
+      if (tab != string_view::npos) {
+        text = line.substr(0, tab);
+        pair = line.substr(tab + 1);
+      }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    tokenizer_->TokenizeToIds(text).swap(text_ids_);
+    pair_ids_.clear();
+    if (!pair.empty()) tokenizer_->TokenizeToIds(pair).swap(pair_ids_);
+    auto end = std::chrono::steady_clock::now();
+    const double tokenize_seconds = Seconds(begin, end);
+    profile->tokenize_seconds += tokenize_seconds;
+    if (num_lines_++ % options_.sample_every == 0) {
+      // The pre-tokenization runs again on its own; the rest of the
+      // tokenization is WordPiece and the id lookups.
+      WordCounter counter;
+      auto pre_begin = std::chrono::steady_clock::now();
+      basic_tokenizer_.Tokenize(text, &counter);
+      if (!pair.empty()) basic_tokenizer_.Tokenize(pair, &counter);
+      const double pre_seconds =
+        Seconds(pre_begin, std::chrono::steady_clock::now());
+      profile->sampled_seconds += tokenize_seconds;
+      profile->stage_seconds[kPreTokenize] +=
+        std::min(pre_seconds, tokenize_seconds);
+      profile->stage_seconds[kWordPiece] +=
+        tokenize_seconds - std::min(pre_seconds, tokenize_seconds);
+    }
+
+    auto stats_begin = std::chrono::steady_clock::now();
+    bool has_unk = false;
+    for (auto ids : {&text_ids_, &pair_ids_}) {
+      for (auto& id : *ids) {
+        if (id >= profile->token_counts.size()) {
+          profile->token_counts.resize(id + 1, 0);
+        }
+        profile->token_counts[id]++;
+        if (id == unk_id_) {
+          profile->num_unk_tokens++;
+          has_unk = true;
+        }
+      }
+    }
+    profile->num_tokens += text_ids_.size() + pair_ids_.size();
+    profile->num_texts_with_unk += has_unk;
+    profile->text_lengths.Add(text_ids_.size());
+    if (!pair.empty()) profile->pair_lengths.Add(pair_ids_.size());
+    profile->example_lengths.Add(
+      text_ids_.size() + pair_ids_.size() +
+      tokenizer_->GetNumSpecialTokensToAdd(!pair.empty()));
+    profile->stage_seconds[kStats] +=
+      Seconds(stats_begin, std::chrono::steady_clock::now());
+  }
+
+  const Options& options_;
+  const BertTokenizer* tokenizer_;
+  BasicTokenizer basic_tokenizer_;
+  size_t unk_id_;
+  uint64_t num_lines_{0};
+  vector<size_t> text_ids_;
+  vector<size_t> pair_ids_;
+};
+
+// Cuts the files into chunks of about kChunkBytes at line starts.
+vector<Chunk> MakeChunks(const vector<string>& files) {
+  vector<Chunk> chunks;
+  for (size_t f = 0; f < files.size(); ++f) {
+    std::ifstream file(files[f], std::ios::binary | std::ios::ate);
+    if (!file) throw std::runtime_error("Can not open " + files[f]);
+    const uint64_t size = file.tellg();
+    uint64_t begin = 0;
+    while (begin < size) {
+      uint64_t end = begin + kChunkBytes;
+      if (end >= size) {
+        end = size;
+      } else {
+        file.seekg(end);
+        string rest;
+        std::getline(file, rest);
+        end = file ? static_cast<uint64_t>(file.tellg()) : size;
+        file.clear();
+      }
+      chunks.push_back({f, begin, end});
+      begin = end;
+    }
+  }
+  return chunks;
+}
+
+void WriteJsonString(std::ostream* out, const string& text) {
+  *out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      *out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      *out << escaped;
+    } else {
+      *out << c;
+    }
+  }
+  *out << '"';
+}
+
+void WriteReport(const Options& options,
+                 const BertTokenizer& tokenizer,
+                 const Profile& profile,
+                 double wall_seconds,
+                 size_t num_threads,
+                 std::ostream* out) {
+  *out << "{\n  \"texts\": " << profile.text_lengths.Num()
+       << ",\n  \"bytes\": " << profile.num_bytes
+       << ",\n  \"tokens\": " << profile.num_tokens
+       << ",\n  \"threads\": " << num_threads
+       << ",\n  \"seconds\": " << wall_seconds
+       << ",\n  \"texts_per_second\": "
+       << profile.text_lengths.Num() / wall_seconds
+       << ",\n  \"megabytes_per_second\": "
+       << profile.num_bytes / wall_seconds / 1e6
+       << ",\n  \"text_lengths\": ";
+  profile.text_lengths.WriteJson(out, 16);
+  if (options.pairs) {
+    *out << ",\n  \"pair_lengths\": ";
+    profile.pair_lengths.WriteJson(out, 16);
+  }
+  *out << ",\n  \"example_lengths\": ";
+  profile.example_lengths.WriteJson(out, 16);
+
+  *out << ",\n  \"truncated_share\": {";
+  for (size_t i = 0; i < options.limits.size(); ++i) {
+    *out << (i ? ", " : "") << "\"" << options.limits[i] << "\": "
+         << profile.example_lengths.ShareAbove(options.limits[i]);
+  }
+  *out << "},\n  \"unk_rate\": "
+       << (profile.num_tokens ?
+           static_cast<double>(profile.num_unk_tokens) / profile.num_tokens :
+           0.0)
+       << ",\n  \"texts_with_unk\": "
+       << (profile.text_lengths.Num() ?
+           static_cast<double>(profile.num_texts_with_unk) /
+             profile.text_lengths.Num() :
+           0.0)
+       << ",\n  \"malformed_utf8_sequences\": "
+       << tokenizer.GetDiagnostics().malformed_utf8_sequences;
+
+  vector<size_t> order;
+  for (size_t id = 0; id < profile.token_counts.size(); ++id) {
+    if (profile.token_counts[id] > 0) order.push_back(id);
+  }
+  *out << ",\n  \"distinct_tokens\": " << order.size();
+  const size_t top = std::min(options.top, order.size());
+  std::partial_sort(order.begin(), order.begin() + top, order.end(),
+                    [&profile](size_t a, size_t b) {
+                      return profile.token_counts[a] > profile.token_counts[b];
+                    });
+  order.resize(top);
+  const vector<wstring>& tokens = tokenizer.ConvertIdsToTokens(order);
+  *out << ",\n  \"top_tokens\": [";
+  for (size_t i = 0; i < top; ++i) {
+    *out << (i ? ",\n    " : "\n    ") << "{\"id\": " << order[i]
+         << ", \"token\": ";
+    string token;
+    for (auto& ch : tokens[i]) AppendUtf8(static_cast<uint32_t>(ch), &token);
+    WriteJsonString(out, token);
+    *out << ", \"count\": " << profile.token_counts[order[i]] << "}";
+  }
+  *out << "]";
+
+  // The sampled shares of pre_tokenize and wordpiece_and_ids are scaled to
+  // the whole tokenization time.
+  double seconds[kNumStages];
+  const double scale = profile.sampled_seconds > 0 ?
+    profile.tokenize_seconds / profile.sampled_seconds : 0;
+  seconds[kRead] = profile.stage_seconds[kRead];
+  seconds[kPreTokenize] = profile.stage_seconds[kPreTokenize] * scale;
+  seconds[kWordPiece] = profile.stage_seconds[kWordPiece] * scale;
+  seconds[kStats] = profile.stage_seconds[kStats];
+  double total = 0;
+  for (int i = 0; i < kNumStages; ++i) total += seconds[i];
+  *out << ",\n  \"stage_share\": {";
+  for (int i = 0; i < kNumStages; ++i) {
+    *out << (i ? ", " : "") << "\"" << kStageNames[i] << "\": "
+         << (total > 0 ? seconds[i] / total : 0.0);
+  }
+  *out << "}\n}\n";
+}
+
+vector<size_t> ParseLimits(const string& text) {
+  vector<size_t> limits;
+  std::stringstream in(text);
+  string limit;
+  while (std::getline(in, limit, ',')) {
+    if (!limit.empty()) limits.push_back(std::stoul(limit));
+  }
+  return limits;
+}
+
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  vector<string> positional;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    auto value = [&arg](const string& flag) {
+      return arg.compare(0, flag.size(), flag) == 0 ?
+        arg.substr(flag.size()) : string();
+    };
+    if (arg == "--pairs") {
+      options->pairs = true;
+    } else if (arg == "--cased") {
+      options->do_lower_case = false;
+    } else if (!value("--threads=").empty()) {
+      options->num_threads = std::stoul(value("--threads="));
+    } else if (!value("--limits=").empty()) {
+      options->limits = ParseLimits(value("--limits="));
+    } else if (!value("--top=").empty()) {
+      options->top = std::stoul(value("--top="));
+    } else if (!value("--sample=").empty()) {
+      options->sample_every = std::max(1ul, std::stoul(value("--sample=")));
+    } else if (!value("--output=").empty()) {
+      options->output = value("--output=");
+    } else if (arg.compare(0, 2, "--") == 0) {
+      return false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() < 2) return false;
+  options->vocab_file = positional[0];
+  options->corpus_files.assign(positional.begin() + 1, positional.end());
+  if (options->num_threads == 0) {
+    options->num_threads = std::max(1u, thread::hardware_concurrency());
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  try {
+    if (!ParseOptions(argc, argv, &options)) {
+      cerr << "Usage: " << argv[0] << " <vocab_file> <corpus_file>..."
+           << " [--threads=N] [--limits=128,256,512] [--pairs] [--cased]"
+           << " [--top=100] [--sample=64] [--output=profile.json]" << endl;
+      return -1;
+    }
+  }
+  catch (exception& e) {
+    cerr << "Bad option: " << e.what() << endl;
+    return -1;
+  }
+
+  unique_ptr<BertTokenizer> tokenizer;
+  vector<Chunk> chunks;
+  try {
+    tokenizer.reset(new BertTokenizer(options.vocab_file,
+                                      options.do_lower_case));
+    chunks = MakeChunks(options.corpus_files);
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  const size_t num_threads = std::max<size_t>(
+    1, std::min(options.num_threads, chunks.size()));
+  vector<Profile> profiles(num_threads);
+  std::atomic<size_t> next_chunk{0};
+  vector<thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      Profiler profiler(options, tokenizer.get());
+      for (size_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+        profiler.ProfileChunk(chunks[i], &profiles[t]);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  Profile profile;
+  for (auto& p : profiles) profile.Merge(p);
+  const double wall_seconds =
+    Seconds(begin, std::chrono::steady_clock::now());
+
+  if (options.output.empty()) {
+    WriteReport(options, *tokenizer, profile, wall_seconds, num_threads,
+                &std::cout);
+  } else {
+    std::ofstream out(options.output);
+    WriteReport(options, *tokenizer, profile, wall_seconds, num_threads,
+                &out);
+    if (!out) {
+      cerr << "Can not write " << options.output << endl;
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,272 @@
+// Copyright (c) 2021 PaddlePaddle Authors & liustung. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compiles a vocab file into a C++ header of constexpr tables, which
+// defines the StaticVocab <name> (see paddlenlp/static_vocab.h). The file
+// is parsed by LoadVocab, so the compiled vocab has the same tokens and
+// ids as the one a tokenizer would load.
+//
+// The perfect hash is built with hash and displace: the tokens are put in
+// buckets of about kBucketSize tokens by their hash, and the buckets,
+// largest first, get the first seed that sends all their tokens to free
+// slots.
+//
+// Usage: vocab_codegen <vocab_file> <name> <output_header>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "paddlenlp/static_vocab.h"
+#include "paddlenlp/tokenizer.h"
+#include "paddlenlp/utf8.h"
+
+
+using std::cerr;
+using std::endl;
+using std::exception;
+using std::runtime_error;
+using std::string;
+using std::vector;
+using std::wstring;
+
+
+const size_t kBucketSize = 4;
+const uint32_t kMaxSeed = 1 << 24;
+// Characters per line of the token bytes literal.
+const size_t kLineChars = 96;
+
+struct Token {
+  wstring text;
+  size_t id;
+  uint64_t hash;
+};
+
+struct CompiledVocab {
+  string token_bytes;
+  vector<StaticVocabEntry> entries;
+  vector<uint32_t> bucket_seeds;
+  vector<uint32_t> id_slots;
+  size_t max_token_chars{0};
+  vector<uint32_t> ascii_ids;
+  vector<uint32_t> cjk_ids;
+};
+
+// Finds the seeds of the buckets and fills the slots of the entries.
+void BuildPerfectHash(const vector<Token>& tokens,
+                      const vector<StaticVocabEntry>& token_entries,
+                      CompiledVocab* vocab) {
+  const size_t n = tokens.size();
+  const size_t num_buckets = std::max<size_t>(1, n / kBucketSize);
+  vector<vector<size_t>> buckets(num_buckets);
+  for (size_t i = 0; i < n; ++i) {
+    buckets[StaticVocab::Bucket(tokens[i].hash, num_buckets)].push_back(i);
+  }
+  vector<size_t> order(num_buckets);
+  for (size_t b = 0; b < num_buckets; ++b) order[b] = b;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  vector<bool> used(n, false);
+  vector<size_t> slots;
+  vocab->bucket_seeds.assign(num_buckets, 0);
+  vocab->entries.assign(n, StaticVocabEntry{0, 0, 0, 0});
+  for (size_t b : order) {
+    if (buckets[b].empty()) break;
+    uint32_t seed = 0;
+    for (; seed < kMaxSeed; ++seed) {
+      slots.clear();
+      bool ok = true;
+      for (size_t i : buckets[b]) {
+        const size_t slot = StaticVocab::Slot(tokens[i].hash, seed, n);
+        if (used[slot] ||
+            std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          ok = false;
+          break;
+        }
+        slots.push_back(slot);
+      }
+      if (ok) break;
+    }
+    if (seed == kMaxSeed) {
+      throw runtime_error("No perfect hash seed found; the vocab has tokens "
+                          "with the same hash.");
+    }
+    vocab->bucket_seeds[b] = seed;
+    for (size_t k = 0; k < slots.size(); ++k) {
+      used[slots[k]] = true;
+      vocab->entries[slots[k]] = token_entries[buckets[b][k]];
+    }
+  }
+}
+
+CompiledVocab Compile(const Vocab& parsed) {
+  vector<Token> tokens;
+  for (auto& v : parsed) {
+    if (v.second >= StaticVocab::kNoSlot) {
+      throw runtime_error("The vocab ids must fit in 32 bits.");
+    }
+    tokens.push_back({v.first, v.second, StaticVocab::Hash(v.first)});
+  }
+  if (tokens.empty()) throw runtime_error("The vocab is empty.");
+  // The ids order the token bytes, so the output does not depend on the
+  // order of the map.
+  std::sort(tokens.begin(), tokens.end(), [](const Token& a, const Token& b) {
+    return a.id < b.id;
+  });
+
+  CompiledVocab vocab;
+  vocab.ascii_ids.assign(CharIdTable::kAsciiSize, CharIdTable::kNotFound);
+  vocab.cjk_ids.assign(CharIdTable::kCjkSize, CharIdTable::kNotFound);
+  vector<StaticVocabEntry> token_entries;
+  for (auto& token : tokens) {
+    const size_t offset = vocab.token_bytes.size();
+    for (wchar_t ch : token.text) {
+      AppendUtf8(static_cast<uint32_t>(ch), &vocab.token_bytes);
+    }
+    if (vocab.token_bytes.size() >= StaticVocab::kNoSlot) {
+      throw runtime_error("The vocab tokens must fit in 4GB.");
+    }
+    token_entries.push_back({static_cast<uint32_t>(token.id),
+                             StaticVocab::Fingerprint(token.hash),
+                             static_cast<uint32_t>(offset),
+                             static_cast<uint32_t>(
+                               vocab.token_bytes.size() - offset)});
+    vocab.max_token_chars = std::max(vocab.max_token_chars, token.text.size());
+    if (token.text.size() == 1) {
+      const uint32_t c = static_cast<uint32_t>(token.text[0]);
+      if (c < CharIdTable::kAsciiSize) {
+        vocab.ascii_ids[c] = static_cast<uint32_t>(token.id);
+      } else if (c - CharIdTable::kCjkBegin < CharIdTable::kCjkSize) {
+        vocab.cjk_ids[c - CharIdTable::kCjkBegin] =
+          static_cast<uint32_t>(token.id);
+      }
+    }
+  }
+  BuildPerfectHash(tokens, token_entries, &vocab);
+  vocab.id_slots.assign(tokens.back().id + 1, StaticVocab::kNoSlot);
+  for (size_t slot = 0; slot < vocab.entries.size(); ++slot) {
+    vocab.id_slots[vocab.entries[slot].id] = static_cast<uint32_t>(slot);
+  }
+  return vocab;
+}
+
+void WriteArray(const string& type,
+                const string& name,
+                const vector<uint32_t>& values,
+                std::ostream* out) {
+  *out << "inline constexpr " << type << " " << name << "[] = {";
+  for (size_t i = 0; i < values.size(); ++i) {
+    *out << (i % 8 == 0 ? "\n  " : " ") << values[i] << "u,";
+  }
+  *out << "\n};\n\n";
+}
+
+// Writes the bytes as string literals, with every byte outside printable
+// ASCII as a three digit octal escape.
+void WriteBytes(const string& name, const string& bytes, std::ostream* out) {
+  *out << "inline constexpr char " << name << "[] =";
+  string line;
+  for (size_t i = 0; i <= bytes.size(); ++i) {
+    if (i == bytes.size() || line.size() >= kLineChars) {
+      *out << "\n  \"" << line << "\"";
+      line.clear();
+    }
+    if (i == bytes.size()) break;
+    const unsigned char c = static_cast<unsigned char>(bytes[i]);
+    if (c >= 0x20 && c < 0x7F && c != '\\' && c != '"' && c != '?') {
+      line.push_back(static_cast<char>(c));
+    } else {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\%03o", c);
+      line += escape;
+    }
+  }
+  *out << ";\n\n";
+}
+
+void WriteHeader(const CompiledVocab& vocab,
+                 const string& vocab_file,
+                 const string& name,
+                 std::ostream* out) {
+  string guard = "PADDLENLP_STATIC_VOCAB_" + name + "_H_";
+  for (auto& c : guard) c = std::toupper(static_cast<unsigned char>(c));
+  *out << "// Generated by vocab_codegen from " << vocab_file
+       << ". Do not edit.\n\n"
+       << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+       << "#include \"paddlenlp/static_vocab.h\"\n\n\n";
+  WriteBytes(name + "TokenBytes", vocab.token_bytes, out);
+  *out << "inline constexpr StaticVocabEntry " << name << "Entries[] = {";
+  for (auto& e : vocab.entries) {
+    *out << "\n  {" << e.id << "u, " << e.fingerprint << "u, " << e.offset
+         << "u, " << e.size << "u},";
+  }
+  *out << "\n};\n\n";
+  WriteArray("uint32_t", name + "BucketSeeds", vocab.bucket_seeds, out);
+  WriteArray("uint32_t", name + "IdSlots", vocab.id_slots, out);
+  WriteArray("uint32_t", name + "AsciiIds", vocab.ascii_ids, out);
+  WriteArray("uint32_t", name + "CjkIds", vocab.cjk_ids, out);
+  *out << "inline constexpr StaticVocabData " << name << "Data = {\n"
+       << "  " << name << "TokenBytes,\n"
+       << "  " << name << "Entries,\n"
+       << "  " << vocab.entries.size() << ",\n"
+       << "  " << name << "BucketSeeds,\n"
+       << "  " << vocab.bucket_seeds.size() << ",\n"
+       << "  " << name << "IdSlots,\n"
+       << "  " << vocab.id_slots.size() << ",\n"
+       << "  " << vocab.max_token_chars << ",\n"
+       << "  " << name << "AsciiIds,\n"
+       << "  " << name << "CjkIds,\n"
+       << "};\n\n"
+       << "inline constexpr StaticVocab " << name << "(" << name << "Data);\n\n"
+       << "#endif  // " << guard << "\n";
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    cerr << "Usage: " << argv[0] << " <vocab_file> <name> <output_header>"
+         << endl;
+    return -1;
+  }
+  const string name = argv[2];
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])) ||
+      name.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                             "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") !=
+      string::npos) {
+    cerr << "The name must be a C++ identifier: " << name << endl;
+    return -1;
+  }
+  try {
+    const CompiledVocab vocab = Compile(*LoadVocab(argv[1]));
+    std::ofstream out(argv[3], std::ios::binary);
+    WriteHeader(vocab, argv[1], name, &out);
+    out.close();
+    if (!out) throw runtime_error("Can not write " + string(argv[3]));
+    printf("%zu tokens, %zu buckets, %zu bytes of tokens\n",
+           vocab.entries.size(), vocab.bucket_seeds.size(),
+           vocab.token_bytes.size());
+  }
+  catch (exception& e) {
+    cerr << e.what() << endl;
+    std::remove(argv[3]);
+    return -1;
+  }
+  return 0;
+}